@@ -0,0 +1,111 @@
+/*
+ * Bitmap AND/OR microbenchmark.
+ *
+ * Two low-cardinality columns over `rows` ids: "region" (4 values) and
+ * "status" (3 values). Times COUNT(*) WHERE region = 1 AND status = 2
+ * (and the OR) three ways: a row-at-a-time check of both columns, the
+ * roaring AND/OR of the two value bitmaps, and the same on sparse ids
+ * (every 50th row), where containers are sorted arrays.
+ *
+ *   make bench && ./build/bench/bitmap_bench [rows]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include "index/roaring.h"
+
+#define DEFAULT_ROWS 4000000
+#define REPEATS 20
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void time_combine(const char* name, const RoaringBitmap* a, const RoaringBitmap* b,
+                         uint32_t rows) {
+    uint64_t and_count = 0;
+    uint64_t or_count = 0;
+    double start = now_seconds();
+    for (int r = 0; r < REPEATS; r++) {
+        RoaringBitmap* both = roaring_and(a, b);
+        and_count = roaring_cardinality(both);
+        roaring_free(both);
+    }
+    double and_seconds = (now_seconds() - start) / REPEATS;
+    
+    start = now_seconds();
+    for (int r = 0; r < REPEATS; r++) {
+        RoaringBitmap* either = roaring_or(a, b);
+        or_count = roaring_cardinality(either);
+        roaring_free(either);
+    }
+    double or_seconds = (now_seconds() - start) / REPEATS;
+    
+    printf("%-18s AND %8.3f ms (%llu)  OR %8.3f ms (%llu)  %.2f ns/row\n", name,
+           and_seconds * 1e3, (unsigned long long)and_count, or_seconds * 1e3,
+           (unsigned long long)or_count, and_seconds * 1e9 / rows);
+}
+
+int main(int argc, char* argv[]) {
+    uint32_t rows = argc > 1 ? (uint32_t)atoi(argv[1]) : DEFAULT_ROWS;
+    if (rows == 0) {
+        rows = DEFAULT_ROWS;
+    }
+    
+    uint8_t* region = malloc(rows);
+    uint8_t* status = malloc(rows);
+    RoaringBitmap* region1 = roaring_create();
+    RoaringBitmap* status2 = roaring_create();
+    RoaringBitmap* sparse_region1 = roaring_create();
+    RoaringBitmap* sparse_status2 = roaring_create();
+    for (uint32_t id = 0; id < rows; id++) {
+        region[id] = id % 4;
+        status[id] = id % 3;
+        if (region[id] == 1) {
+            roaring_add(region1, id);
+        }
+        if (status[id] == 2) {
+            roaring_add(status2, id);
+        }
+        if (id % 50 == 0 && region[id / 50] == 1) {
+            roaring_add(sparse_region1, id);
+        }
+        if (id % 50 == 0 && status[id / 50] == 2) {
+            roaring_add(sparse_status2, id);
+        }
+    }
+    
+    printf("%u rows, %zu + %zu bytes of bitmaps\n\n", rows,
+           roaring_size_in_bytes(region1), roaring_size_in_bytes(status2));
+    
+    // Baseline: evaluate both predicates on every row
+    uint64_t and_count = 0;
+    uint64_t or_count = 0;
+    double start = now_seconds();
+    for (int r = 0; r < REPEATS; r++) {
+        and_count = 0;
+        or_count = 0;
+        for (uint32_t id = 0; id < rows; id++) {
+            and_count += region[id] == 1 && status[id] == 2;
+            or_count += region[id] == 1 || status[id] == 2;
+        }
+    }
+    double scan_seconds = (now_seconds() - start) / REPEATS;
+    printf("%-18s AND+OR %5.3f ms (%llu, %llu)  %.2f ns/row\n", "row scan",
+           scan_seconds * 1e3, (unsigned long long)and_count, (unsigned long long)or_count,
+           scan_seconds * 1e9 / rows);
+    
+    time_combine("bitmap (dense)", region1, status2, rows);
+    time_combine("bitmap (sparse)", sparse_region1, sparse_status2, rows);
+    
+    roaring_free(region1);
+    roaring_free(status2);
+    roaring_free(sparse_region1);
+    roaring_free(sparse_status2);
+    free(region);
+    free(status);
+    return 0;
+}
@@ -0,0 +1,111 @@
+/*
+ * WAL commit latency microbenchmark.
+ *
+ * Times wal_sync for single-page commits with and without preallocated,
+ * recycled log segments. Without preallocation every commit extends the
+ * file, so fdatasync also has to persist the new inode size; with it the
+ * commit only flushes data. A checkpoint every CHECKPOINT_INTERVAL
+ * commits exercises truncation versus segment recycling.
+ *
+ *   make bench && ./build/bench/wal_commit_bench [commits] [directory]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "storage/pager.h"
+#include "transaction/wal.h"
+
+#define DEFAULT_COMMITS 2000
+#define CHECKPOINT_INTERVAL 200
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// wal_checkpoint reports progress on stdout; keep it out of the results
+static void checkpoint_quietly(WAL* wal) {
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDOUT_FILENO);
+    wal_checkpoint(wal);
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(null_fd);
+    close(saved);
+}
+
+static void run(const char* name, const char* directory, uint32_t segment_size,
+                uint32_t commits, void* page) {
+    char db_path[512];
+    char wal_path[520];
+    snprintf(db_path, sizeof(db_path), "%s/wal_commit_bench.db", directory);
+    snprintf(wal_path, sizeof(wal_path), "%s-wal", db_path);
+    unlink(db_path);
+    unlink(wal_path);
+    
+    Pager* pager = pager_open(db_path);
+    WAL* wal = wal_open_with_segment_size(db_path, segment_size);
+    uint32_t table_id = wal_register_table(wal, "bench", pager);
+    double* latencies = malloc(sizeof(double) * commits);
+    
+    double total = 0;
+    for (uint32_t i = 0; i < commits; i++) {
+        if (i > 0 && i % CHECKPOINT_INTERVAL == 0) {
+            checkpoint_quietly(wal);
+        }
+        
+        ((uint32_t*)page)[0] = i;
+        wal_write_frame(wal, table_id, i % 64, page, 64);
+        
+        double start = now_seconds();
+        wal_sync(wal);
+        latencies[i] = now_seconds() - start;
+        total += latencies[i];
+    }
+    
+    qsort(latencies, commits, sizeof(double), compare_doubles);
+    printf("%-22s mean %8.1f us  p50 %8.1f us  p99 %8.1f us  max %8.1f us\n",
+           name, total / commits * 1e6, latencies[commits / 2] * 1e6,
+           latencies[(size_t)commits * 99 / 100] * 1e6, latencies[commits - 1] * 1e6);
+    
+    free(latencies);
+    wal_close(wal);
+    close(pager->file_descriptor);
+    free(pager->dirty_pages);
+    free(pager);
+    unlink(db_path);
+    unlink(wal_path);
+}
+
+int main(int argc, char* argv[]) {
+    uint32_t commits = argc > 1 ? (uint32_t)atoi(argv[1]) : DEFAULT_COMMITS;
+    const char* directory = argc > 2 ? argv[2] : ".";
+    if (commits == 0) {
+        commits = DEFAULT_COMMITS;
+    }
+    
+    void* page = malloc(PAGE_SIZE);
+    memset(page, 0xAB, PAGE_SIZE);
+    
+    printf("%u single-page commits in %s, checkpoint every %d\n\n",
+           commits, directory, CHECKPOINT_INTERVAL);
+    
+    run("append + truncate", directory, 0, commits, page);
+    run("preallocate + recycle", directory, WAL_SEGMENT_SIZE, commits, page);
+    
+    free(page);
+    return 0;
+}
@@ -0,0 +1,224 @@
+#include "bitmap_index.h"
+#include "../transaction/checksum.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#define BITMAP_FILE_MAGIC 0x504d5442  // "BTMP"
+
+static void bitmap_make_key(char* key, const char* value) {
+    memset(key, 0, INDEX_KEY_SIZE);
+    strncpy(key, value, INDEX_KEY_SIZE - 1);
+}
+
+// The slot holding a key, or the empty slot it would take
+static BitmapIndexValue* bitmap_slot(BitmapIndex* bitmaps, const char* key) {
+    uint32_t mask = bitmaps->num_slots - 1;
+    uint32_t slot = crc32c(0, key, strnlen(key, INDEX_KEY_SIZE - 1)) & mask;
+    while (bitmaps->slots[slot].ids && strncmp(bitmaps->slots[slot].key, key, INDEX_KEY_SIZE) != 0) {
+        slot = (slot + 1) & mask;
+    }
+    return &bitmaps->slots[slot];
+}
+
+static void bitmap_allocate_slots(BitmapIndex* bitmaps, uint32_t num_slots) {
+    bitmaps->slots = calloc(num_slots, sizeof(BitmapIndexValue));
+    bitmaps->num_slots = num_slots;
+}
+
+// Double the table; the bitmaps move over without being copied
+static void bitmap_grow(BitmapIndex* bitmaps) {
+    BitmapIndexValue* old = bitmaps->slots;
+    uint32_t old_slots = bitmaps->num_slots;
+    bitmap_allocate_slots(bitmaps, old_slots * 2);
+    for (uint32_t i = 0; i < old_slots; i++) {
+        if (old[i].ids) {
+            *bitmap_slot(bitmaps, old[i].key) = old[i];
+        }
+    }
+    free(old);
+}
+
+BitmapIndex* bitmap_index_create(void) {
+    BitmapIndex* bitmaps = malloc(sizeof(BitmapIndex));
+    memset(bitmaps, 0, sizeof(BitmapIndex));
+    bitmap_allocate_slots(bitmaps, BITMAP_INDEX_INITIAL_SLOTS);
+    return bitmaps;
+}
+
+void bitmap_index_free(BitmapIndex* bitmaps) {
+    if (!bitmaps) return;
+    for (uint32_t i = 0; i < bitmaps->num_slots; i++) {
+        roaring_free(bitmaps->slots[i].ids);
+    }
+    free(bitmaps->slots);
+    free(bitmaps);
+}
+
+/*
+ * Written to a temporary file and renamed over the index file, so a
+ * crash during the write leaves no file rather than a partial one
+ */
+bool bitmap_index_save(SecondaryIndex* index, const char* filename) {
+    BitmapIndex* bitmaps = index->bitmaps;
+    char temp[600];
+    snprintf(temp, sizeof(temp), "%s.tmp", filename);
+    FILE* file = fopen(temp, "wb");
+    if (!file) {
+        return false;
+    }
+    
+    uint32_t header[2] = { BITMAP_FILE_MAGIC, bitmaps->num_values };
+    bool ok = fwrite(header, sizeof(header), 1, file) == 1;
+    for (uint32_t i = 0; ok && i < bitmaps->num_slots; i++) {
+        BitmapIndexValue* value = &bitmaps->slots[i];
+        if (value->ids) {
+            ok = fwrite(value->key, INDEX_KEY_SIZE, 1, file) == 1 && roaring_write(value->ids, file);
+        }
+    }
+    ok = fclose(file) == 0 && ok;
+    
+    if (!ok || rename(temp, filename) != 0) {
+        remove(temp);
+        return false;
+    }
+    return true;
+}
+
+// NULL if the file is missing, truncated or malformed
+BitmapIndex* bitmap_index_load(const char* filename) {
+    FILE* file = fopen(filename, "rb");
+    if (!file) {
+        return NULL;
+    }
+    
+    uint32_t header[2];
+    if (fread(header, sizeof(header), 1, file) != 1 || header[0] != BITMAP_FILE_MAGIC) {
+        fclose(file);
+        return NULL;
+    }
+    
+    BitmapIndex* bitmaps = bitmap_index_create();
+    for (uint32_t i = 0; i < header[1]; i++) {
+        char key[INDEX_KEY_SIZE];
+        RoaringBitmap* ids = NULL;
+        if (fread(key, INDEX_KEY_SIZE, 1, file) != 1 || (ids = roaring_read(file)) == NULL) {
+            bitmap_index_free(bitmaps);
+            fclose(file);
+            return NULL;
+        }
+        key[INDEX_KEY_SIZE - 1] = '\0';
+        
+        if ((bitmaps->num_values + 1) * 2 > bitmaps->num_slots) {
+            bitmap_grow(bitmaps);
+        }
+        BitmapIndexValue* value = bitmap_slot(bitmaps, key);
+        roaring_free(value->ids);
+        bitmaps->num_values += value->ids == NULL;
+        memcpy(value->key, key, INDEX_KEY_SIZE);
+        value->ids = ids;
+    }
+    fclose(file);
+    return bitmaps;
+}
+
+void bitmap_index_insert(SecondaryIndex* index, const char* key, uint32_t primary_key) {
+    BitmapIndex* bitmaps = index->bitmaps;
+    char stored[INDEX_KEY_SIZE];
+    bitmap_make_key(stored, key);
+    
+    BitmapIndexValue* value = bitmap_slot(bitmaps, stored);
+    if (!value->ids) {
+        if ((bitmaps->num_values + 1) * 2 > bitmaps->num_slots) {
+            bitmap_grow(bitmaps);
+            value = bitmap_slot(bitmaps, stored);
+        }
+        memcpy(value->key, stored, INDEX_KEY_SIZE);
+        value->ids = roaring_create();
+        bitmaps->num_values++;
+    }
+    roaring_add(value->ids, primary_key);
+}
+
+// A value whose last id goes keeps its (empty) bitmap, so probes never need tombstones
+void bitmap_index_delete(SecondaryIndex* index, const char* key, uint32_t primary_key) {
+    char stored[INDEX_KEY_SIZE];
+    bitmap_make_key(stored, key);
+    BitmapIndexValue* value = bitmap_slot(index->bitmaps, stored);
+    if (value->ids) {
+        roaring_remove(value->ids, primary_key);
+    }
+}
+
+// The ids of rows whose (truncated) value is key, or NULL if there are none
+const RoaringBitmap* bitmap_index_get(SecondaryIndex* index, const char* key) {
+    char stored[INDEX_KEY_SIZE];
+    bitmap_make_key(stored, key);
+    BitmapIndexValue* value = bitmap_slot(index->bitmaps, stored);
+    return value->ids && value->ids->num_containers > 0 ? value->ids : NULL;
+}
+
+void bitmap_index_lookup(SecondaryIndex* index, const char* key, IndexMatches* matches) {
+    const RoaringBitmap* ids = bitmap_index_get(index, key);
+    if (!ids) {
+        return;
+    }
+    
+    uint32_t count = 0;
+    uint32_t* values = roaring_to_array(ids, &count);
+    for (uint32_t i = 0; i < count; i++) {
+        index_matches_add(matches, index, key, values[i], NULL);
+    }
+    free(values);
+}
+
+// Every entry, grouped by value with ids ascending
+void bitmap_index_for_each(SecondaryIndex* index, IndexEntryVisitor visit, void* context) {
+    BitmapIndex* bitmaps = index->bitmaps;
+    for (uint32_t i = 0; i < bitmaps->num_slots; i++) {
+        BitmapIndexValue* value = &bitmaps->slots[i];
+        if (!value->ids) {
+            continue;
+        }
+        
+        IndexEntry entry;
+        memcpy(entry.key, value->key, INDEX_KEY_SIZE);
+        uint32_t count = 0;
+        uint32_t* ids = roaring_to_array(value->ids, &count);
+        for (uint32_t j = 0; j < count; j++) {
+            entry.primary_key = ids[j];
+            visit(&entry, context);
+        }
+        free(ids);
+    }
+}
+
+void bitmap_index_print(SecondaryIndex* index) {
+    BitmapIndex* bitmaps = index->bitmaps;
+    uint64_t num_entries = 0;
+    size_t bytes = 0;
+    for (uint32_t i = 0; i < bitmaps->num_slots; i++) {
+        if (bitmaps->slots[i].ids) {
+            num_entries += roaring_cardinality(bitmaps->slots[i].ids);
+            bytes += roaring_size_in_bytes(bitmaps->slots[i].ids);
+        }
+    }
+    
+    printf("\nBitmap index on %s.%s (%llu entries, %u values, %zu bytes):\n",
+           index->table_name, index->column_name, (unsigned long long)num_entries,
+           bitmaps->num_values, bytes);
+    for (uint32_t i = 0; i < bitmaps->num_slots; i++) {
+        BitmapIndexValue* value = &bitmaps->slots[i];
+        if (!value->ids) {
+            continue;
+        }
+        uint32_t containers = value->ids->num_containers;
+        uint32_t dense = 0;
+        for (uint32_t c = 0; c < containers; c++) {
+            dense += value->ids->containers[c].is_bitmap;
+        }
+        printf("  '%s' -> %llu ids (%u containers, %u bitmap)\n", value->key,
+               (unsigned long long)roaring_cardinality(value->ids), containers, dense);
+    }
+    printf("\n");
+}
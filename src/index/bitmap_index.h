@@ -0,0 +1,49 @@
+#ifndef BITMAP_INDEX_H
+#define BITMAP_INDEX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "secondary_index.h"
+#include "roaring.h"
+
+/*
+ * Bitmap Index (CREATE INDEX ... USING BITMAP)
+ *
+ * One compressed bitmap of primary keys per distinct column value, for
+ * columns with few distinct values. The values sit in an open-addressed
+ * hash table, so a lookup is one probe and the matching ids come out of
+ * the bitmap in increasing order. Conditions on several bitmap-indexed
+ * columns combine by AND/OR of their bitmaps without reading rows, and
+ * a count is the combined bitmap's cardinality.
+ *
+ * The index lives in memory. A clean close writes it to
+ * "<db>.<table>.<column>.bitmap", and opening it reads that file and
+ * deletes it, so the file is never older than the table: after a crash
+ * it is missing and the index is rebuilt from the recovered table.
+ */
+typedef struct {
+    char key[INDEX_KEY_SIZE];  // Stored truncated, like B+tree and hash keys
+    RoaringBitmap* ids;        // NULL for an empty slot
+} BitmapIndexValue;
+
+struct BitmapIndex {
+    BitmapIndexValue* slots;
+    uint32_t num_slots;        // Power of two, at most half full
+    uint32_t num_values;
+};
+
+#define BITMAP_INDEX_INITIAL_SLOTS 16
+
+// Function declarations
+BitmapIndex* bitmap_index_create(void);
+void bitmap_index_free(BitmapIndex* bitmaps);
+bool bitmap_index_save(SecondaryIndex* index, const char* filename);
+BitmapIndex* bitmap_index_load(const char* filename);
+void bitmap_index_insert(SecondaryIndex* index, const char* key, uint32_t primary_key);
+void bitmap_index_delete(SecondaryIndex* index, const char* key, uint32_t primary_key);
+const RoaringBitmap* bitmap_index_get(SecondaryIndex* index, const char* key);
+void bitmap_index_lookup(SecondaryIndex* index, const char* key, IndexMatches* matches);
+void bitmap_index_for_each(SecondaryIndex* index, IndexEntryVisitor visit, void* context);
+void bitmap_index_print(SecondaryIndex* index);
+
+#endif // BITMAP_INDEX_H
@@ -0,0 +1,128 @@
+#include "bloom.h"
+#include "../transaction/checksum.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#define BLOOM_FILE_MAGIC 0x4d4f4c42  // "BLOM"
+
+// Odd multipliers that pick one bit per word (from the Parquet SBBF spec)
+static const uint32_t bloom_salt[BLOOM_BLOCK_WORDS] = {
+    0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+    0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U
+};
+
+typedef struct {
+    uint32_t magic;
+    uint32_t num_blocks;
+    uint32_t num_keys;
+    uint32_t capacity;
+    uint32_t checksum;  // CRC32C of the blocks
+} BloomFileHeader;
+
+static BloomFilter* bloom_allocate(uint32_t num_blocks, uint32_t capacity) {
+    BloomFilter* filter = malloc(sizeof(BloomFilter));
+    void* blocks = NULL;
+    if (posix_memalign(&blocks, sizeof(BloomBlock), (size_t)num_blocks * sizeof(BloomBlock)) != 0) {
+        free(filter);
+        return NULL;
+    }
+    memset(blocks, 0, (size_t)num_blocks * sizeof(BloomBlock));
+    filter->blocks = blocks;
+    filter->num_blocks = num_blocks;
+    filter->num_keys = 0;
+    filter->capacity = capacity;
+    return filter;
+}
+
+BloomFilter* bloom_create(uint32_t capacity) {
+    if (capacity < BLOOM_MIN_CAPACITY) {
+        capacity = BLOOM_MIN_CAPACITY;
+    }
+    uint64_t bits = (uint64_t)capacity * BLOOM_BITS_PER_KEY;
+    uint64_t block_bits = sizeof(BloomBlock) * 8;
+    return bloom_allocate((uint32_t)((bits + block_bits - 1) / block_bits), capacity);
+}
+
+void bloom_free(BloomFilter* filter) {
+    if (!filter) return;
+    free(filter->blocks);
+    free(filter);
+}
+
+// Two CRC32C passes with different seeds make the 64 bits a filter needs
+uint64_t bloom_hash(const void* data, size_t length) {
+    uint64_t high = crc32c(0x9e3779b9U, data, length);
+    uint64_t low = crc32c(0, data, length);
+    return (high << 32) | low;
+}
+
+// The high half picks the block (multiply-shift, no modulo); the low half the bits
+static BloomBlock* bloom_block(const BloomFilter* filter, uint64_t hash) {
+    return &filter->blocks[((hash >> 32) * filter->num_blocks) >> 32];
+}
+
+void bloom_add(BloomFilter* filter, uint64_t hash) {
+    BloomBlock* block = bloom_block(filter, hash);
+    uint32_t key = (uint32_t)hash;
+    for (int i = 0; i < BLOOM_BLOCK_WORDS; i++) {
+        block->words[i] |= 1U << ((key * bloom_salt[i]) >> 27);
+    }
+    filter->num_keys++;
+}
+
+bool bloom_may_contain(const BloomFilter* filter, uint64_t hash) {
+    const BloomBlock* block = bloom_block(filter, hash);
+    uint32_t key = (uint32_t)hash;
+    uint32_t missing = 0;
+    for (int i = 0; i < BLOOM_BLOCK_WORDS; i++) {
+        missing |= ~block->words[i] & (1U << ((key * bloom_salt[i]) >> 27));
+    }
+    return missing == 0;
+}
+
+bool bloom_save(const BloomFilter* filter, const char* filename) {
+    FILE* file = fopen(filename, "wb");
+    if (!file) {
+        return false;
+    }
+    
+    size_t size = (size_t)filter->num_blocks * sizeof(BloomBlock);
+    BloomFileHeader header = {
+        .magic = BLOOM_FILE_MAGIC,
+        .num_blocks = filter->num_blocks,
+        .num_keys = filter->num_keys,
+        .capacity = filter->capacity,
+        .checksum = crc32c(0, filter->blocks, size)
+    };
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(filter->blocks, size, 1, file) == 1;
+    return fclose(file) == 0 && ok;
+}
+
+// NULL if the file is missing, truncated or corrupt
+BloomFilter* bloom_load(const char* filename) {
+    FILE* file = fopen(filename, "rb");
+    if (!file) {
+        return NULL;
+    }
+    
+    BloomFileHeader header;
+    BloomFilter* filter = NULL;
+    if (fread(&header, sizeof(header), 1, file) == 1 && header.magic == BLOOM_FILE_MAGIC &&
+        header.num_blocks > 0) {
+        filter = bloom_allocate(header.num_blocks, header.capacity);
+    }
+    
+    size_t size = filter ? (size_t)filter->num_blocks * sizeof(BloomBlock) : 0;
+    if (filter && (fread(filter->blocks, size, 1, file) != 1 ||
+                   crc32c(0, filter->blocks, size) != header.checksum)) {
+        bloom_free(filter);
+        filter = NULL;
+    }
+    if (filter) {
+        filter->num_keys = header.num_keys;
+    }
+    fclose(file);
+    return filter;
+}
@@ -0,0 +1,45 @@
+#ifndef BLOOM_H
+#define BLOOM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Split-block Bloom filter
+ *
+ * The filter is an array of 64-byte blocks, one cache line each. A key
+ * hashes to a single block and sets one bit in each of its eight 32-bit
+ * words, so an add or a probe touches exactly one cache line, and the
+ * eight word operations are independent (the compiler vectorizes them).
+ * At BLOOM_BITS_PER_KEY the false positive rate is about 0.5%.
+ *
+ * capacity is the number of keys the filter was sized for; past it the
+ * false positive rate climbs, and the owner should rebuild it larger.
+ * Keys cannot be removed, so deletes only leave stale positives.
+ */
+#define BLOOM_BLOCK_WORDS 8
+#define BLOOM_BITS_PER_KEY 16
+#define BLOOM_MIN_CAPACITY 1024
+
+typedef struct {
+    uint32_t words[BLOOM_BLOCK_WORDS];
+} BloomBlock;
+
+typedef struct {
+    BloomBlock* blocks;
+    uint32_t num_blocks;
+    uint32_t num_keys;     // Keys added, including since-deleted ones
+    uint32_t capacity;
+} BloomFilter;
+
+// Function declarations
+BloomFilter* bloom_create(uint32_t capacity);
+void bloom_free(BloomFilter* filter);
+uint64_t bloom_hash(const void* data, size_t length);
+void bloom_add(BloomFilter* filter, uint64_t hash);
+bool bloom_may_contain(const BloomFilter* filter, uint64_t hash);
+bool bloom_save(const BloomFilter* filter, const char* filename);
+BloomFilter* bloom_load(const char* filename);
+
+#endif // BLOOM_H
@@ -91,7 +91,7 @@ uint32_t* internal_node_child(void* node, uint32_t child_num) {
 }
 
 uint32_t* internal_node_key(void* node, uint32_t key_num) {
-    return (uint32_t*)(internal_node_cell(node, key_num) + INTERNAL_NODE_CHILD_SIZE);
+    return (uint32_t*)((void*)internal_node_cell(node, key_num) + INTERNAL_NODE_CHILD_SIZE);
 }
 
 void initialize_internal_node(void* node) {
@@ -190,7 +190,16 @@ Cursor* leaf_node_find(Table* table, uint32_t page_num, uint32_t key) {
  * Insert into leaf node
  */
 void leaf_node_insert(Cursor* cursor, uint32_t key, Row* value) {
-    void* node = pager_get_page(cursor->table->pager, cursor->page_num);
+    void* node = pager_get_page_for_write(cursor->table->pager, cursor->page_num);
+    TableHeader* header = cursor->table->header;
+    if (header->row_count == 0 || key < header->id_min) {
+        header->id_min = key;
+    }
+    if (header->row_count == 0 || key > header->id_max) {
+        header->id_max = key;
+    }
+    header->id_sum += key;
+    header->row_count++;
     
     uint32_t num_cells = *leaf_node_num_cells(node);
     if (num_cells >= LEAF_NODE_MAX_CELLS) {
@@ -199,27 +208,40 @@ void leaf_node_insert(Cursor* cursor, uint32_t key, Row* value) {
         return;
     }
     
-    if (cursor->cell_num < num_cells) {
+    char serialized[LEAF_NODE_VALUE_SIZE];
+    serialize_row(value, serialized);
+    leaf_node_insert_cell(node, cursor->cell_num, key, serialized);
+}
+
+/*
+ * Insert an already-serialized cell at cell_num, shifting later cells
+ * right. The caller guarantees the leaf has room. Shared by
+ * leaf_node_insert and WAL redo of logical insert records.
+ */
+void leaf_node_insert_cell(void* node, uint32_t cell_num, uint32_t key, const void* value) {
+    uint32_t num_cells = *leaf_node_num_cells(node);
+    
+    if (cell_num < num_cells) {
         // Make room for new cell
-        for (uint32_t i = num_cells; i > cursor->cell_num; i--) {
-            memcpy(leaf_node_cell(node, i), leaf_node_cell(node, i - 1), LEAF_NODE_CELL_SIZE);
-        }
+        memmove(leaf_node_cell(node, cell_num + 1), leaf_node_cell(node, cell_num),
+                (num_cells - cell_num) * LEAF_NODE_CELL_SIZE);
     }
     
     *(leaf_node_num_cells(node)) += 1;
-    *(leaf_node_key(node, cursor->cell_num)) = key;
-    serialize_row(value, leaf_node_value(node, cursor->cell_num));
+    *(leaf_node_key(node, cell_num)) = key;
+    memcpy(leaf_node_value(node, cell_num), value, LEAF_NODE_VALUE_SIZE);
 }
 
 /*
  * Split leaf node and insert
  */
 void leaf_node_split_and_insert(Cursor* cursor, uint32_t key, Row* value) {
-    void* old_node = pager_get_page(cursor->table->pager, cursor->page_num);
-    uint32_t old_max = get_node_max_key(old_node);
+    void* old_node = pager_get_page_for_write(cursor->table->pager, cursor->page_num);
+    uint32_t old_max = get_node_max_key(cursor->table->pager, old_node);
     uint32_t new_page_num = get_unused_page_num(cursor->table->pager);
-    void* new_node = pager_get_page(cursor->table->pager, new_page_num);
+    void* new_node = pager_get_page_for_write(cursor->table->pager, new_page_num);
     initialize_leaf_node(new_node);
+    cursor->table->header->leaf_pages++;
     *node_parent(new_node) = *node_parent(old_node);
     *leaf_node_next_leaf(new_node) = *leaf_node_next_leaf(old_node);
     *leaf_node_next_leaf(old_node) = new_page_num;
@@ -257,8 +279,8 @@ void leaf_node_split_and_insert(Cursor* cursor, uint32_t key, Row* value) {
         return create_new_root(cursor->table, new_page_num);
     } else {
         uint32_t parent_page_num = *node_parent(old_node);
-        uint32_t new_max = get_node_max_key(old_node);
-        void* parent = pager_get_page(cursor->table->pager, parent_page_num);
+        uint32_t new_max = get_node_max_key(cursor->table->pager, old_node);
+        void* parent = pager_get_page_for_write(cursor->table->pager, parent_page_num);
         
         update_internal_node_key(parent, old_max, new_max);
         internal_node_insert(cursor->table, parent_page_num, new_page_num);
@@ -270,10 +292,14 @@ void leaf_node_split_and_insert(Cursor* cursor, uint32_t key, Row* value) {
  * Create a new root node
  */
 void create_new_root(Table* table, uint32_t right_child_page_num) {
-    void* root = pager_get_page(table->pager, table->root_page_num);
-    void* right_child = pager_get_page(table->pager, right_child_page_num);
+    void* root = pager_get_page_for_write(table->pager, table->root_page_num);
+    void* right_child = pager_get_page_for_write(table->pager, right_child_page_num);
     uint32_t left_child_page_num = get_unused_page_num(table->pager);
-    void* left_child = pager_get_page(table->pager, left_child_page_num);
+    void* left_child = pager_get_page_for_write(table->pager, left_child_page_num);
+    
+    /* The tree grows one level and gains an internal page */
+    table->header->internal_pages++;
+    table->header->tree_height++;
     
     /* Left child has data copied from old root */
     memcpy(left_child, root, PAGE_SIZE);
@@ -284,7 +310,7 @@ void create_new_root(Table* table, uint32_t right_child_page_num) {
     set_node_root(root, true);
     *internal_node_num_keys(root) = 1;
     *internal_node_child(root, 0) = left_child_page_num;
-    uint32_t left_child_max_key = get_node_max_key(left_child);
+    uint32_t left_child_max_key = get_node_max_key(table->pager, left_child);
     *internal_node_key(root, 0) = left_child_max_key;
     *internal_node_right_child(root) = right_child_page_num;
     *node_parent(left_child) = table->root_page_num;
@@ -299,10 +325,15 @@ uint32_t get_unused_page_num(Pager* pager) {
     return pager->num_pages;
 }
 
-uint32_t get_node_max_key(void* node) {
+/*
+ * Largest key stored in the subtree rooted at node. For an internal node
+ * this is the max of its right child, not its own last separator key,
+ * which only bounds the children to its left.
+ */
+uint32_t get_node_max_key(Pager* pager, void* node) {
     switch (get_node_type(node)) {
         case NODE_INTERNAL:
-            return *internal_node_key(node, *internal_node_num_keys(node) - 1);
+            return get_node_max_key(pager, pager_get_page(pager, *internal_node_right_child(node)));
         case NODE_LEAF:
             return *leaf_node_key(node, *leaf_node_num_cells(node) - 1);
         default:
@@ -363,9 +394,9 @@ void update_internal_node_key(void* node, uint32_t old_key, uint32_t new_key) {
  * Insert into internal node
  */
 void internal_node_insert(Table* table, uint32_t parent_page_num, uint32_t child_page_num) {
-    void* parent = pager_get_page(table->pager, parent_page_num);
+    void* parent = pager_get_page_for_write(table->pager, parent_page_num);
     void* child = pager_get_page(table->pager, child_page_num);
-    uint32_t child_max_key = get_node_max_key(child);
+    uint32_t child_max_key = get_node_max_key(table->pager, child);
     
     uint32_t original_num_keys = *internal_node_num_keys(parent);
     
@@ -388,10 +419,10 @@ void internal_node_insert(Table* table, uint32_t parent_page_num, uint32_t child
     
     *internal_node_num_keys(parent) = original_num_keys + 1;
     
-    if (child_max_key > get_node_max_key(right_child)) {
+    if (child_max_key > get_node_max_key(table->pager, right_child)) {
         /* Replace right child */
         *internal_node_child(parent, original_num_keys) = right_child_page_num;
-        *internal_node_key(parent, original_num_keys) = get_node_max_key(right_child);
+        *internal_node_key(parent, original_num_keys) = get_node_max_key(table->pager, right_child);
         *internal_node_right_child(parent) = child_page_num;
     } else {
         /* Make room for the new cell */
@@ -413,30 +444,31 @@ void internal_node_insert(Table* table, uint32_t parent_page_num, uint32_t child
  */
 void internal_node_split_and_insert(Table* table, uint32_t parent_page_num, uint32_t child_page_num) {
     uint32_t old_page_num = parent_page_num;
-    void* old_node = pager_get_page(table->pager, parent_page_num);
-    uint32_t old_max = get_node_max_key(old_node);
+    void* old_node = pager_get_page_for_write(table->pager, parent_page_num);
+    uint32_t old_max = get_node_max_key(table->pager, old_node);
 
-    void* child = pager_get_page(table->pager, child_page_num);
-    uint32_t child_max = get_node_max_key(child);
+    void* child = pager_get_page_for_write(table->pager, child_page_num);
+    uint32_t child_max = get_node_max_key(table->pager, child);
 
     uint32_t new_page_num = get_unused_page_num(table->pager);
-    void* new_node = pager_get_page(table->pager, new_page_num);
+    void* new_node = pager_get_page_for_write(table->pager, new_page_num);
     initialize_internal_node(new_node);
+    table->header->internal_pages++;
 
     bool splitting_root = is_node_root(old_node);
     void* parent;
 
     if (splitting_root) {
         create_new_root(table, new_page_num);
-        parent = pager_get_page(table->pager, table->root_page_num);
+        parent = pager_get_page_for_write(table->pager, table->root_page_num);
         /* create_new_root copied old_node's (pre-split) content into a
          * fresh page and made that the new root's left child. Re-point
          * old_page_num/old_node at that page -- it's the real "old_node"
          * from here on. */
         old_page_num = *internal_node_child(parent, 0);
-        old_node = pager_get_page(table->pager, old_page_num);
+        old_node = pager_get_page_for_write(table->pager, old_page_num);
     } else {
-        parent = pager_get_page(table->pager, *node_parent(old_node));
+        parent = pager_get_page_for_write(table->pager, *node_parent(old_node));
         *node_parent(new_node) = *node_parent(old_node);
     }
 
@@ -444,14 +476,14 @@ void internal_node_split_and_insert(Table* table, uint32_t parent_page_num, uint
 
     /* Move the current right child into the new node first. */
     uint32_t cur_page_num = *internal_node_right_child(old_node);
-    void* cur = pager_get_page(table->pager, cur_page_num);
+    void* cur = pager_get_page_for_write(table->pager, cur_page_num);
     internal_node_insert(table, new_page_num, cur_page_num);
     *node_parent(cur) = new_page_num;
 
     /* Move the upper half of the remaining keys/children into the new node. */
     for (int32_t i = (int32_t)INTERNAL_NODE_MAX_CELLS - 1; i > (int32_t)(INTERNAL_NODE_MAX_CELLS / 2); i--) {
         cur_page_num = *internal_node_child(old_node, (uint32_t)i);
-        cur = pager_get_page(table->pager, cur_page_num);
+        cur = pager_get_page_for_write(table->pager, cur_page_num);
 
         internal_node_insert(table, new_page_num, cur_page_num);
         *node_parent(cur) = new_page_num;
@@ -468,38 +500,84 @@ void internal_node_split_and_insert(Table* table, uint32_t parent_page_num, uint
      * moved from parent_page_num to old_page_num), so its remaining
      * children's stored parent pointers would otherwise be stale. */
     for (uint32_t i = 0; i < *old_num_keys; i++) {
-        void* c = pager_get_page(table->pager, *internal_node_child(old_node, i));
+        void* c = pager_get_page_for_write(table->pager, *internal_node_child(old_node, i));
         *node_parent(c) = old_page_num;
     }
-    void* remaining_right_child = pager_get_page(table->pager, *internal_node_right_child(old_node));
+    void* remaining_right_child = pager_get_page_for_write(table->pager, *internal_node_right_child(old_node));
     *node_parent(remaining_right_child) = old_page_num;
 
     /* Insert the originally-pending child into whichever half it belongs in. */
-    uint32_t max_after_split = get_node_max_key(old_node);
+    uint32_t max_after_split = get_node_max_key(table->pager, old_node);
     uint32_t destination_page_num = (child_max < max_after_split) ? old_page_num : new_page_num;
     internal_node_insert(table, destination_page_num, child_page_num);
     *node_parent(child) = destination_page_num;
 
-    update_internal_node_key(parent, old_max, get_node_max_key(old_node));
+    update_internal_node_key(parent, old_max, get_node_max_key(table->pager, old_node));
 
     if (!splitting_root) {
         internal_node_insert(table, *node_parent(old_node), new_page_num);
     }
 }
 
+/*
+ * Smallest (or with last, largest) key under page_num. Deletes never
+ * merge leaves, so empty leaves are stepped over; false if every leaf
+ * under the page is empty.
+ */
+static bool tree_edge_key(Pager* pager, uint32_t page_num, bool last, uint32_t* key) {
+    void* node = pager_get_page(pager, page_num);
+    if (get_node_type(node) == NODE_LEAF) {
+        uint32_t num_cells = *leaf_node_num_cells(node);
+        if (num_cells == 0) {
+            return false;
+        }
+        *key = *leaf_node_key(node, last ? num_cells - 1 : 0);
+        return true;
+    }
+    
+    uint32_t num_keys = *internal_node_num_keys(node);
+    for (uint32_t i = 0; i <= num_keys; i++) {
+        uint32_t child = *internal_node_child(node, last ? num_keys - i : i);
+        if (child != INVALID_PAGE_NUM && tree_edge_key(pager, child, last, key)) {
+            return true;
+        }
+    }
+    return false;
+}
+
 void leaf_node_delete(Cursor* cursor) {
-    void* node = pager_get_page(cursor->table->pager, cursor->page_num);
+    void* node = pager_get_page_for_write(cursor->table->pager, cursor->page_num);
     uint32_t num_cells = *leaf_node_num_cells(node);
     
     if (cursor->cell_num >= num_cells) {
         return; // Nothing to delete
     }
     
+    uint32_t key = *leaf_node_key(node, cursor->cell_num);
+    leaf_node_remove_cell(node, cursor->cell_num);
+    
+    TableHeader* header = cursor->table->header;
+    header->row_count--;
+    header->id_sum -= key;
+    if (header->row_count > 0 && key == header->id_min) {
+        tree_edge_key(cursor->table->pager, header->root_page_num, false, &header->id_min);
+    }
+    if (header->row_count > 0 && key == header->id_max) {
+        tree_edge_key(cursor->table->pager, header->root_page_num, true, &header->id_max);
+    }
+}
+
+/*
+ * Remove cell_num from a leaf, shifting later cells left. Shared by
+ * leaf_node_delete and WAL redo of logical delete records.
+ */
+void leaf_node_remove_cell(void* node, uint32_t cell_num) {
+    uint32_t num_cells = *leaf_node_num_cells(node);
+    
     // Shift all cells after the deleted cell to the left
-    for (uint32_t i = cursor->cell_num; i < num_cells - 1; i++) {
-        void* dest = leaf_node_cell(node, i);
-        void* src = leaf_node_cell(node, i + 1);
-        memcpy(dest, src, LEAF_NODE_CELL_SIZE);
+    if (cell_num + 1 < num_cells) {
+        memmove(leaf_node_cell(node, cell_num), leaf_node_cell(node, cell_num + 1),
+                (num_cells - cell_num - 1) * LEAF_NODE_CELL_SIZE);
     }
     
     // Decrease cell count
@@ -89,6 +89,8 @@ void leaf_node_insert(Cursor* cursor, uint32_t key, Row* value);
 Cursor* leaf_node_find(Table* table, uint32_t page_num, uint32_t key);
 void leaf_node_split_and_insert(Cursor* cursor, uint32_t key, Row* value);
 void leaf_node_delete(Cursor* cursor);
+void leaf_node_insert_cell(void* node, uint32_t cell_num, uint32_t key, const void* value);
+void leaf_node_remove_cell(void* node, uint32_t cell_num);
 
 // Internal node functions
 uint32_t* internal_node_num_keys(void* node);
@@ -109,7 +111,7 @@ void create_new_root(Table* table, uint32_t right_child_page_num);
 void print_tree(Pager* pager, uint32_t page_num, uint32_t indentation_level);
 
 uint32_t get_unused_page_num(Pager* pager);
-uint32_t get_node_max_key(void* node);
+uint32_t get_node_max_key(Pager* pager, void* node);
 void update_internal_node_key(void* node, uint32_t old_key, uint32_t new_key);
 Cursor* internal_node_find(Table* table, uint32_t page_num, uint32_t key);
 void indent(uint32_t level);
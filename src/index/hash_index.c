@@ -0,0 +1,391 @@
+#include "hash_index.h"
+#include "btree.h"
+#include "../transaction/checksum.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+/*
+ * Hash page accessors
+ */
+static uint8_t* hash_page_type(void* page) {
+    return (uint8_t*)page + INDEX_NODE_TYPE_OFFSET;
+}
+
+static uint32_t* hash_meta_level(void* meta) {
+    return (uint32_t*)((char*)meta + INDEX_HASH_LEVEL_OFFSET);
+}
+
+static uint32_t* hash_meta_split(void* meta) {
+    return (uint32_t*)((char*)meta + INDEX_HASH_SPLIT_OFFSET);
+}
+
+static uint32_t* hash_meta_free_page(void* meta) {
+    return (uint32_t*)((char*)meta + INDEX_HASH_FREE_PAGE_OFFSET);
+}
+
+static uint32_t* hash_meta_directory(void* meta, uint32_t directory_num) {
+    return (uint32_t*)((char*)meta + INDEX_HASH_DIRECTORY_OFFSET) + directory_num;
+}
+
+static uint32_t* hash_directory_bucket(void* directory, uint32_t slot) {
+    return (uint32_t*)((char*)directory + INDEX_NODE_HEADER_SIZE) + slot;
+}
+
+static uint32_t* hash_bucket_num_entries(void* page) {
+    return (uint32_t*)((char*)page + INDEX_NODE_NUM_KEYS_OFFSET);
+}
+
+static uint32_t* hash_bucket_next(void* page) {
+    return (uint32_t*)((char*)page + INDEX_BUCKET_NEXT_OFFSET);
+}
+
+// Bucket entries are IndexHashEntry plus the index's INCLUDE payload
+static uint32_t hash_entry_size(SecondaryIndex* index) {
+    return sizeof(IndexHashEntry) + index->payload_size;
+}
+
+static uint32_t hash_bucket_capacity(SecondaryIndex* index) {
+    return (PAGE_SIZE - INDEX_BUCKET_HEADER_SIZE) / hash_entry_size(index);
+}
+
+static IndexHashEntry* hash_bucket_entry(SecondaryIndex* index, void* page, uint32_t entry_num) {
+    return (IndexHashEntry*)((char*)page + INDEX_BUCKET_HEADER_SIZE +
+                             (size_t)entry_num * hash_entry_size(index));
+}
+
+// An entry with room for the largest payload
+typedef struct {
+    IndexHashEntry entry;
+    char payload[INDEX_MAX_PAYLOAD_SIZE];
+} IndexHashSlot;
+
+// CRC32C of the (possibly truncated) key; hardware-accelerated on most CPUs
+static uint32_t hash_key(const char* key) {
+    return crc32c(0, key, strnlen(key, INDEX_KEY_SIZE - 1));
+}
+
+static void hash_make_entry(IndexHashEntry* entry, const char* key, uint32_t primary_key) {
+    memset(entry, 0, sizeof(IndexHashEntry));
+    strncpy(entry->entry.key, key, INDEX_KEY_SIZE - 1);
+    entry->entry.primary_key = primary_key;
+    entry->hash = hash_key(entry->entry.key);
+}
+
+static uint32_t hash_num_buckets(void* meta) {
+    return (INDEX_HASH_INITIAL_BUCKETS << *hash_meta_level(meta)) + *hash_meta_split(meta);
+}
+
+/*
+ * Linear hashing address: the low bits of the hash pick a bucket, with
+ * one more bit for buckets that have already been split this round.
+ */
+static uint32_t hash_bucket_for(void* meta, uint32_t hash) {
+    uint32_t round_buckets = INDEX_HASH_INITIAL_BUCKETS << *hash_meta_level(meta);
+    uint32_t bucket = hash & (round_buckets - 1);
+    if (bucket < *hash_meta_split(meta)) {
+        bucket = hash & (2 * round_buckets - 1);
+    }
+    return bucket;
+}
+
+// Primary page of a bucket
+static uint32_t hash_bucket_page(SecondaryIndex* index, uint32_t bucket) {
+    void* meta = pager_get_page(index->pager, 0);
+    uint32_t directory_page = *hash_meta_directory(meta, bucket / INDEX_HASH_BUCKETS_PER_DIRECTORY);
+    void* directory = pager_get_page(index->pager, directory_page);
+    return *hash_directory_bucket(directory, bucket % INDEX_HASH_BUCKETS_PER_DIRECTORY);
+}
+
+static void hash_set_bucket_page(SecondaryIndex* index, uint32_t bucket, uint32_t page_num) {
+    void* meta = pager_get_page_for_write(index->pager, 0);
+    uint32_t* directory_page = hash_meta_directory(meta, bucket / INDEX_HASH_BUCKETS_PER_DIRECTORY);
+    if (*directory_page == 0) {
+        *directory_page = get_unused_page_num(index->pager);
+        void* directory = pager_get_page_for_write(index->pager, *directory_page);
+        memset(directory, 0, PAGE_SIZE);
+        *hash_page_type(directory) = INDEX_PAGE_HASH_DIRECTORY;
+    }
+    
+    void* directory = pager_get_page_for_write(index->pager, *directory_page);
+    *hash_directory_bucket(directory, bucket % INDEX_HASH_BUCKETS_PER_DIRECTORY) = page_num;
+}
+
+// An empty bucket page: one released by an earlier split, else a new one
+static uint32_t hash_allocate_page(SecondaryIndex* index) {
+    void* meta = pager_get_page_for_write(index->pager, 0);
+    uint32_t page_num = *hash_meta_free_page(meta);
+    if (page_num != 0) {
+        *hash_meta_free_page(meta) = *hash_bucket_next(pager_get_page(index->pager, page_num));
+    } else {
+        page_num = get_unused_page_num(index->pager);
+    }
+    
+    void* page = pager_get_page_for_write(index->pager, page_num);
+    memset(page, 0, PAGE_SIZE);
+    *hash_page_type(page) = INDEX_PAGE_HASH_BUCKET;
+    return page_num;
+}
+
+// Locate an exact (key, primary key) entry in a bucket chain
+static bool hash_chain_find(SecondaryIndex* index, uint32_t page_num, const IndexHashEntry* target,
+                            uint32_t* found_page, uint32_t* found_slot) {
+    while (page_num != 0) {
+        void* page = pager_get_page(index->pager, page_num);
+        uint32_t num_entries = *hash_bucket_num_entries(page);
+        for (uint32_t i = 0; i < num_entries; i++) {
+            IndexHashEntry* entry = hash_bucket_entry(index, page, i);
+            if (entry->hash == target->hash &&
+                entry->entry.primary_key == target->entry.primary_key &&
+                strncmp(entry->entry.key, target->entry.key, INDEX_KEY_SIZE) == 0) {
+                *found_page = page_num;
+                *found_slot = i;
+                return true;
+            }
+        }
+        page_num = *hash_bucket_next(page);
+    }
+    return false;
+}
+
+/*
+ * Store an entry in the first page of a chain with room, linking a new
+ * overflow page onto the end when every page is full. Returns true if
+ * an overflow page was added.
+ */
+static bool hash_chain_append(SecondaryIndex* index, uint32_t page_num, const IndexHashSlot* entry) {
+    while (true) {
+        void* page = pager_get_page(index->pager, page_num);
+        uint32_t num_entries = *hash_bucket_num_entries(page);
+        if (num_entries < hash_bucket_capacity(index)) {
+            page = pager_get_page_for_write(index->pager, page_num);
+            memcpy(hash_bucket_entry(index, page, num_entries), entry, hash_entry_size(index));
+            *hash_bucket_num_entries(page) = num_entries + 1;
+            return false;
+        }
+        
+        uint32_t next = *hash_bucket_next(page);
+        if (next == 0) {
+            next = hash_allocate_page(index);
+            page = pager_get_page_for_write(index->pager, page_num);
+            *hash_bucket_next(page) = next;
+            
+            void* overflow = pager_get_page_for_write(index->pager, next);
+            memcpy(hash_bucket_entry(index, overflow, 0), entry, hash_entry_size(index));
+            *hash_bucket_num_entries(overflow) = 1;
+            return true;
+        }
+        page_num = next;
+    }
+}
+
+/*
+ * Split the bucket under the split pointer into itself and its image
+ * one round up, using one more bit of each stored hash. Entries that
+ * stay are packed to the front of the old chain, and the pages this
+ * empties go on the free list.
+ */
+static void hash_split_next(SecondaryIndex* index) {
+    void* meta = pager_get_page(index->pager, 0);
+    uint32_t level = *hash_meta_level(meta);
+    uint32_t old_bucket = *hash_meta_split(meta);
+    uint32_t round_buckets = INDEX_HASH_INITIAL_BUCKETS << level;
+    uint32_t new_bucket = old_bucket + round_buckets;
+    uint32_t mask = 2 * round_buckets - 1;
+    
+    if (new_bucket >= INDEX_HASH_MAX_DIRECTORY_PAGES * INDEX_HASH_BUCKETS_PER_DIRECTORY) {
+        return;  // Directory is full; chains just grow longer
+    }
+    
+    uint32_t new_page = hash_allocate_page(index);
+    hash_set_bucket_page(index, new_bucket, new_page);
+    
+    meta = pager_get_page_for_write(index->pager, 0);
+    if (old_bucket + 1 == round_buckets) {
+        *hash_meta_level(meta) = level + 1;
+        *hash_meta_split(meta) = 0;
+    } else {
+        *hash_meta_split(meta) = old_bucket + 1;
+    }
+    
+    // The write position trails the read position along the old chain
+    uint32_t head = hash_bucket_page(index, old_bucket);
+    uint32_t write_page = head;
+    uint32_t write_slot = 0;
+    
+    for (uint32_t read_page = head; read_page != 0; ) {
+        void* page = pager_get_page(index->pager, read_page);
+        uint32_t num_entries = *hash_bucket_num_entries(page);
+        uint32_t next = *hash_bucket_next(page);
+        
+        for (uint32_t i = 0; i < num_entries; i++) {
+            IndexHashSlot entry;
+            memcpy(&entry, hash_bucket_entry(index, page, i), hash_entry_size(index));
+            if ((entry.entry.hash & mask) == new_bucket) {
+                hash_chain_append(index, new_page, &entry);
+                continue;
+            }
+            
+            void* dest = pager_get_page_for_write(index->pager, write_page);
+            if (write_slot == hash_bucket_capacity(index)) {
+                *hash_bucket_num_entries(dest) = write_slot;
+                write_page = *hash_bucket_next(dest);
+                write_slot = 0;
+                dest = pager_get_page_for_write(index->pager, write_page);
+            }
+            memcpy(hash_bucket_entry(index, dest, write_slot++), &entry, hash_entry_size(index));
+        }
+        read_page = next;
+    }
+    
+    void* last = pager_get_page_for_write(index->pager, write_page);
+    *hash_bucket_num_entries(last) = write_slot;
+    uint32_t released = *hash_bucket_next(last);
+    *hash_bucket_next(last) = 0;
+    
+    while (released != 0) {
+        void* page = pager_get_page_for_write(index->pager, released);
+        uint32_t next = *hash_bucket_next(page);
+        *hash_bucket_num_entries(page) = 0;
+        *hash_bucket_next(page) = *hash_meta_free_page(meta);
+        *hash_meta_free_page(meta) = released;
+        released = next;
+    }
+}
+
+void hash_index_initialize(SecondaryIndex* index) {
+    void* meta = pager_get_page_for_write(index->pager, 0);
+    memset(meta, 0, PAGE_SIZE);
+    *hash_page_type(meta) = INDEX_PAGE_HASH_META;
+    
+    for (uint32_t bucket = 0; bucket < INDEX_HASH_INITIAL_BUCKETS; bucket++) {
+        hash_set_bucket_page(index, bucket, hash_allocate_page(index));
+    }
+}
+
+bool hash_index_is_valid(SecondaryIndex* index) {
+    return index->pager->num_pages > 0 &&
+           *hash_page_type(pager_get_page(index->pager, 0)) == INDEX_PAGE_HASH_META;
+}
+
+/*
+ * Insert (key, primary_key), leaving the changed pages dirty. Growth is
+ * driven by overflow: whenever an insert has to chain a new overflow
+ * page, the bucket under the split pointer is split, so the meta page
+ * only changes when the table grows.
+ */
+void hash_index_insert(SecondaryIndex* index, const char* key, uint32_t primary_key,
+                       const void* payload) {
+    IndexHashSlot entry;
+    hash_make_entry(&entry.entry, key, primary_key);
+    memcpy(entry.payload, payload, index->payload_size);
+    
+    void* meta = pager_get_page(index->pager, 0);
+    uint32_t head = hash_bucket_page(index, hash_bucket_for(meta, entry.entry.hash));
+    
+    uint32_t found_page;
+    uint32_t found_slot;
+    if (hash_chain_find(index, head, &entry.entry, &found_page, &found_slot)) {
+        return;  // Already indexed
+    }
+    
+    if (hash_chain_append(index, head, &entry)) {
+        hash_split_next(index);
+    }
+}
+
+void hash_index_lookup(SecondaryIndex* index, const char* key, IndexMatches* matches) {
+    IndexHashEntry probe;
+    hash_make_entry(&probe, key, 0);
+    
+    void* meta = pager_get_page(index->pager, 0);
+    uint32_t page_num = hash_bucket_page(index, hash_bucket_for(meta, probe.hash));
+    
+    while (page_num != 0) {
+        void* page = pager_get_page(index->pager, page_num);
+        uint32_t num_entries = *hash_bucket_num_entries(page);
+        for (uint32_t i = 0; i < num_entries; i++) {
+            IndexHashEntry* entry = hash_bucket_entry(index, page, i);
+            if (entry->hash != probe.hash ||
+                strncmp(entry->entry.key, probe.entry.key, INDEX_KEY_SIZE) != 0) {
+                continue;
+            }
+            index_matches_add(matches, index, key, entry->entry.primary_key,
+                              (char*)entry + sizeof(IndexHashEntry));
+        }
+        page_num = *hash_bucket_next(page);
+    }
+}
+
+/*
+ * Remove (key, primary_key) by moving the last entry of its page into
+ * the hole. Buckets are never merged.
+ */
+void hash_index_delete(SecondaryIndex* index, const char* key, uint32_t primary_key) {
+    IndexHashEntry entry;
+    hash_make_entry(&entry, key, primary_key);
+    
+    void* meta = pager_get_page(index->pager, 0);
+    uint32_t head = hash_bucket_page(index, hash_bucket_for(meta, entry.hash));
+    
+    uint32_t page_num;
+    uint32_t slot;
+    if (!hash_chain_find(index, head, &entry, &page_num, &slot)) {
+        return;
+    }
+    
+    void* page = pager_get_page_for_write(index->pager, page_num);
+    uint32_t num_entries = *hash_bucket_num_entries(page);
+    memmove(hash_bucket_entry(index, page, slot), hash_bucket_entry(index, page, num_entries - 1),
+            hash_entry_size(index));
+    *hash_bucket_num_entries(page) = num_entries - 1;
+}
+
+// Every entry, bucket by bucket
+void hash_index_for_each(SecondaryIndex* index, IndexEntryVisitor visit, void* context) {
+    uint32_t num_buckets = hash_num_buckets(pager_get_page(index->pager, 0));
+    for (uint32_t bucket = 0; bucket < num_buckets; bucket++) {
+        uint32_t page_num = hash_bucket_page(index, bucket);
+        while (page_num != 0) {
+            void* page = pager_get_page(index->pager, page_num);
+            for (uint32_t i = 0; i < *hash_bucket_num_entries(page); i++) {
+                visit(&hash_bucket_entry(index, page, i)->entry, context);
+            }
+            page_num = *hash_bucket_next(page);
+        }
+    }
+}
+
+void hash_index_print(SecondaryIndex* index) {
+    void* meta = pager_get_page(index->pager, 0);
+    uint32_t num_buckets = hash_num_buckets(meta);
+    
+    uint32_t num_entries = 0;
+    uint32_t num_overflow = 0;
+    for (uint32_t bucket = 0; bucket < num_buckets; bucket++) {
+        uint32_t page_num = hash_bucket_page(index, bucket);
+        for (bool first = true; page_num != 0; first = false) {
+            void* page = pager_get_page(index->pager, page_num);
+            num_entries += *hash_bucket_num_entries(page);
+            num_overflow += first ? 0 : 1;
+            page_num = *hash_bucket_next(page);
+        }
+    }
+    
+    printf("\nHash index on %s.%s (%u entries, %u buckets, %u overflow pages):\n",
+           index->table_name, index->column_name, num_entries, num_buckets, num_overflow);
+    
+    for (uint32_t bucket = 0; bucket < num_buckets; bucket++) {
+        uint32_t page_num = hash_bucket_page(index, bucket);
+        while (page_num != 0) {
+            void* page = pager_get_page(index->pager, page_num);
+            for (uint32_t i = 0; i < *hash_bucket_num_entries(page); i++) {
+                printf("  '%s' -> id=%u\n",
+                       hash_bucket_entry(index, page, i)->entry.key,
+                       hash_bucket_entry(index, page, i)->entry.primary_key);
+            }
+            page_num = *hash_bucket_next(page);
+        }
+    }
+    printf("\n");
+}
@@ -0,0 +1,64 @@
+#ifndef HASH_INDEX_H
+#define HASH_INDEX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "secondary_index.h"
+
+/*
+ * Hash Index Layout (CREATE INDEX ... USING HASH)
+ *
+ * A linear hash table in its own file "<db>.<table>.<column>.hash".
+ * Page 0 is the meta page, which lists the directory pages; each
+ * directory page maps a run of bucket numbers to their primary pages,
+ * and a full bucket grows a chain of overflow pages. An equality lookup
+ * reads one bucket page (plus its overflow chain, if any).
+ *
+ * Entries store the hash of their key, so a probe compares four bytes
+ * before touching the key and a bucket split never rehashes.
+ */
+typedef struct {
+    uint32_t hash;
+    IndexEntry entry;
+} IndexHashEntry;
+
+// Page types, distinct from the B+tree's NODE_INTERNAL/NODE_LEAF
+#define INDEX_PAGE_HASH_META 2
+#define INDEX_PAGE_HASH_DIRECTORY 3
+#define INDEX_PAGE_HASH_BUCKET 4
+
+/*
+ * Meta page: the table has INDEX_HASH_INITIAL_BUCKETS << level buckets
+ * plus `split` more; bucket `split` is the next one to be split.
+ * free_page heads a list of overflow pages released by splits.
+ */
+#define INDEX_HASH_INITIAL_BUCKETS 4
+#define INDEX_HASH_LEVEL_OFFSET 4
+#define INDEX_HASH_SPLIT_OFFSET 8
+#define INDEX_HASH_FREE_PAGE_OFFSET 12
+#define INDEX_HASH_DIRECTORY_OFFSET 16
+#define INDEX_HASH_MAX_DIRECTORY_PAGES ((PAGE_SIZE - INDEX_HASH_DIRECTORY_OFFSET) / sizeof(uint32_t))
+
+// Directory page: bucket page numbers after the common node header
+#define INDEX_HASH_BUCKETS_PER_DIRECTORY ((PAGE_SIZE - INDEX_NODE_HEADER_SIZE) / sizeof(uint32_t))
+
+/*
+ * Bucket page: next overflow page (0 for the end of the chain), then
+ * the entries in no particular order. As in B+tree leaves, INCLUDE
+ * values follow each entry and reduce the bucket capacity.
+ */
+#define INDEX_BUCKET_NEXT_OFFSET INDEX_NODE_HEADER_SIZE
+#define INDEX_BUCKET_HEADER_SIZE (INDEX_NODE_HEADER_SIZE + sizeof(uint32_t))
+#define INDEX_BUCKET_MAX_ENTRIES ((PAGE_SIZE - INDEX_BUCKET_HEADER_SIZE) / sizeof(IndexHashEntry))
+
+// Function declarations
+void hash_index_initialize(SecondaryIndex* index);
+bool hash_index_is_valid(SecondaryIndex* index);
+void hash_index_insert(SecondaryIndex* index, const char* key, uint32_t primary_key,
+                       const void* payload);
+void hash_index_lookup(SecondaryIndex* index, const char* key, IndexMatches* matches);
+void hash_index_delete(SecondaryIndex* index, const char* key, uint32_t primary_key);
+void hash_index_print(SecondaryIndex* index);
+void hash_index_for_each(SecondaryIndex* index, IndexEntryVisitor visit, void* context);
+
+#endif // HASH_INDEX_H
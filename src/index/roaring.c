@@ -0,0 +1,602 @@
+#include "roaring.h"
+#include <stdlib.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// An array this many times smaller than the other is galloped through, not merged
+#define ROARING_GALLOP_RATIO 32
+
+/*
+ * Container helpers
+ */
+static uint64_t* roaring_words_alloc(void) {
+    void* words = NULL;
+    if (posix_memalign(&words, 64, ROARING_BITMAP_WORDS * sizeof(uint64_t)) != 0) {
+        return NULL;
+    }
+    memset(words, 0, ROARING_BITMAP_WORDS * sizeof(uint64_t));
+    return words;
+}
+
+static void roaring_container_free(RoaringContainer* container) {
+    free(container->array);
+    free(container->words);
+    container->array = NULL;
+    container->words = NULL;
+}
+
+static uint32_t roaring_words_count(const uint64_t* words) {
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < ROARING_BITMAP_WORDS; i++) {
+        count += (uint32_t)__builtin_popcountll(words[i]);
+    }
+    return count;
+}
+
+static void roaring_array_reserve(RoaringContainer* container, uint32_t capacity) {
+    if (capacity > container->capacity) {
+        uint32_t grown = container->capacity ? container->capacity * 2 : 4;
+        container->capacity = grown > capacity ? grown : capacity;
+        if (container->capacity > ROARING_ARRAY_MAX) {
+            container->capacity = ROARING_ARRAY_MAX;
+        }
+        container->array = realloc(container->array, container->capacity * sizeof(uint16_t));
+    }
+}
+
+static void roaring_to_bitmap_container(RoaringContainer* container) {
+    uint64_t* words = roaring_words_alloc();
+    for (uint32_t i = 0; i < container->cardinality; i++) {
+        uint16_t low = container->array[i];
+        words[low >> 6] |= 1ULL << (low & 63);
+    }
+    free(container->array);
+    container->array = NULL;
+    container->capacity = 0;
+    container->words = words;
+    container->is_bitmap = true;
+}
+
+static void roaring_to_array_container(RoaringContainer* container) {
+    uint16_t* array = malloc((container->cardinality ? container->cardinality : 1) * sizeof(uint16_t));
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < ROARING_BITMAP_WORDS; i++) {
+        for (uint64_t word = container->words[i]; word; word &= word - 1) {
+            array[n++] = (uint16_t)(i * 64 + __builtin_ctzll(word));
+        }
+    }
+    free(container->words);
+    container->words = NULL;
+    container->array = array;
+    container->capacity = container->cardinality ? container->cardinality : 1;
+    container->is_bitmap = false;
+}
+
+// A bitmap container small enough to be an array becomes one
+static void roaring_container_shrink(RoaringContainer* container) {
+    if (container->is_bitmap && container->cardinality <= ROARING_ARRAY_MAX) {
+        roaring_to_array_container(container);
+    }
+}
+
+// First position in a sorted array whose value is >= low
+static uint32_t roaring_array_lower_bound(const uint16_t* array, uint32_t count, uint16_t low) {
+    uint32_t lo = 0;
+    uint32_t hi = count;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (array[mid] < low) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// The container for a key, or NULL with *pos set to where it would go
+static RoaringContainer* roaring_find(const RoaringBitmap* bitmap, uint16_t key, uint32_t* pos) {
+    uint32_t lo = 0;
+    uint32_t hi = bitmap->num_containers;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (bitmap->containers[mid].key < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    *pos = lo;
+    if (lo < bitmap->num_containers && bitmap->containers[lo].key == key) {
+        return &bitmap->containers[lo];
+    }
+    return NULL;
+}
+
+// Append an empty container; keys must be added in increasing order
+static RoaringContainer* roaring_append_container(RoaringBitmap* bitmap, uint16_t key) {
+    if (bitmap->num_containers >= bitmap->capacity) {
+        bitmap->capacity = bitmap->capacity ? bitmap->capacity * 2 : 4;
+        bitmap->containers = realloc(bitmap->containers, bitmap->capacity * sizeof(RoaringContainer));
+    }
+    RoaringContainer* container = &bitmap->containers[bitmap->num_containers++];
+    memset(container, 0, sizeof(RoaringContainer));
+    container->key = key;
+    return container;
+}
+
+static RoaringContainer* roaring_insert_container(RoaringBitmap* bitmap, uint32_t pos, uint16_t key) {
+    roaring_append_container(bitmap, key);
+    RoaringContainer added = bitmap->containers[bitmap->num_containers - 1];
+    memmove(&bitmap->containers[pos + 1], &bitmap->containers[pos],
+            (bitmap->num_containers - 1 - pos) * sizeof(RoaringContainer));
+    bitmap->containers[pos] = added;
+    return &bitmap->containers[pos];
+}
+
+static void roaring_remove_container(RoaringBitmap* bitmap, uint32_t pos) {
+    roaring_container_free(&bitmap->containers[pos]);
+    memmove(&bitmap->containers[pos], &bitmap->containers[pos + 1],
+            (bitmap->num_containers - pos - 1) * sizeof(RoaringContainer));
+    bitmap->num_containers--;
+}
+
+RoaringBitmap* roaring_create(void) {
+    RoaringBitmap* bitmap = malloc(sizeof(RoaringBitmap));
+    memset(bitmap, 0, sizeof(RoaringBitmap));
+    return bitmap;
+}
+
+void roaring_free(RoaringBitmap* bitmap) {
+    if (!bitmap) return;
+    for (uint32_t i = 0; i < bitmap->num_containers; i++) {
+        roaring_container_free(&bitmap->containers[i]);
+    }
+    free(bitmap->containers);
+    free(bitmap);
+}
+
+RoaringBitmap* roaring_copy(const RoaringBitmap* bitmap) {
+    RoaringBitmap* copy = roaring_create();
+    for (uint32_t i = 0; i < bitmap->num_containers; i++) {
+        const RoaringContainer* from = &bitmap->containers[i];
+        RoaringContainer* to = roaring_append_container(copy, from->key);
+        to->cardinality = from->cardinality;
+        to->is_bitmap = from->is_bitmap;
+        if (from->is_bitmap) {
+            to->words = roaring_words_alloc();
+            memcpy(to->words, from->words, ROARING_BITMAP_WORDS * sizeof(uint64_t));
+        } else {
+            roaring_array_reserve(to, from->cardinality);
+            memcpy(to->array, from->array, from->cardinality * sizeof(uint16_t));
+        }
+    }
+    return copy;
+}
+
+void roaring_add(RoaringBitmap* bitmap, uint32_t value) {
+    uint16_t key = (uint16_t)(value >> 16);
+    uint16_t low = (uint16_t)value;
+    uint32_t pos;
+    RoaringContainer* container = roaring_find(bitmap, key, &pos);
+    if (!container) {
+        container = roaring_insert_container(bitmap, pos, key);
+    }
+    
+    if (!container->is_bitmap) {
+        // Values usually arrive in increasing order, which appends
+        uint32_t n = container->cardinality;
+        uint32_t i = (n == 0 || container->array[n - 1] < low) ? n :
+                     roaring_array_lower_bound(container->array, n, low);
+        if (i < n && container->array[i] == low) {
+            return;
+        }
+        if (n < ROARING_ARRAY_MAX) {
+            roaring_array_reserve(container, n + 1);
+            memmove(&container->array[i + 1], &container->array[i], (n - i) * sizeof(uint16_t));
+            container->array[i] = low;
+            container->cardinality++;
+            return;
+        }
+        roaring_to_bitmap_container(container);
+    }
+    
+    uint64_t bit = 1ULL << (low & 63);
+    if (!(container->words[low >> 6] & bit)) {
+        container->words[low >> 6] |= bit;
+        container->cardinality++;
+    }
+}
+
+void roaring_remove(RoaringBitmap* bitmap, uint32_t value) {
+    uint16_t low = (uint16_t)value;
+    uint32_t pos;
+    RoaringContainer* container = roaring_find(bitmap, (uint16_t)(value >> 16), &pos);
+    if (!container) {
+        return;
+    }
+    
+    if (container->is_bitmap) {
+        uint64_t bit = 1ULL << (low & 63);
+        if (!(container->words[low >> 6] & bit)) {
+            return;
+        }
+        container->words[low >> 6] &= ~bit;
+        container->cardinality--;
+        roaring_container_shrink(container);
+    } else {
+        uint32_t n = container->cardinality;
+        uint32_t i = roaring_array_lower_bound(container->array, n, low);
+        if (i >= n || container->array[i] != low) {
+            return;
+        }
+        memmove(&container->array[i], &container->array[i + 1], (n - i - 1) * sizeof(uint16_t));
+        container->cardinality--;
+    }
+    
+    if (container->cardinality == 0) {
+        roaring_remove_container(bitmap, pos);
+    }
+}
+
+bool roaring_contains(const RoaringBitmap* bitmap, uint32_t value) {
+    uint16_t low = (uint16_t)value;
+    uint32_t pos;
+    const RoaringContainer* container = roaring_find(bitmap, (uint16_t)(value >> 16), &pos);
+    if (!container) {
+        return false;
+    }
+    if (container->is_bitmap) {
+        return (container->words[low >> 6] >> (low & 63)) & 1;
+    }
+    uint32_t i = roaring_array_lower_bound(container->array, container->cardinality, low);
+    return i < container->cardinality && container->array[i] == low;
+}
+
+uint64_t roaring_cardinality(const RoaringBitmap* bitmap) {
+    uint64_t count = 0;
+    for (uint32_t i = 0; i < bitmap->num_containers; i++) {
+        count += bitmap->containers[i].cardinality;
+    }
+    return count;
+}
+
+/*
+ * Bitmap container operations: 128 bits per instruction with SSE2,
+ * otherwise a word at a time. The result's cardinality is recounted.
+ */
+static uint32_t roaring_words_and(uint64_t* out, const uint64_t* a, const uint64_t* b) {
+#if defined(__SSE2__)
+    for (uint32_t i = 0; i < ROARING_BITMAP_WORDS; i += 2) {
+        __m128i x = _mm_load_si128((const __m128i*)(a + i));
+        __m128i y = _mm_load_si128((const __m128i*)(b + i));
+        _mm_store_si128((__m128i*)(out + i), _mm_and_si128(x, y));
+    }
+#else
+    for (uint32_t i = 0; i < ROARING_BITMAP_WORDS; i++) {
+        out[i] = a[i] & b[i];
+    }
+#endif
+    return roaring_words_count(out);
+}
+
+static uint32_t roaring_words_or(uint64_t* out, const uint64_t* a, const uint64_t* b) {
+#if defined(__SSE2__)
+    for (uint32_t i = 0; i < ROARING_BITMAP_WORDS; i += 2) {
+        __m128i x = _mm_load_si128((const __m128i*)(a + i));
+        __m128i y = _mm_load_si128((const __m128i*)(b + i));
+        _mm_store_si128((__m128i*)(out + i), _mm_or_si128(x, y));
+    }
+#else
+    for (uint32_t i = 0; i < ROARING_BITMAP_WORDS; i++) {
+        out[i] = a[i] | b[i];
+    }
+#endif
+    return roaring_words_count(out);
+}
+
+// First position at or after `from` whose value is >= low, by doubling steps
+static uint32_t roaring_gallop(const uint16_t* array, uint32_t count, uint32_t from, uint16_t low) {
+    uint32_t step = 1;
+    uint32_t hi = from;
+    while (hi < count && array[hi] < low) {
+        from = hi + 1;
+        hi += step;
+        step *= 2;
+    }
+    if (hi > count) {
+        hi = count;
+    }
+    return from + roaring_array_lower_bound(array + from, hi - from, low);
+}
+
+// Sorted intersection of two arrays into out; returns its size
+static uint32_t roaring_array_and(const uint16_t* a, uint32_t na, const uint16_t* b, uint32_t nb,
+                                  uint16_t* out) {
+    if (na > nb) {
+        const uint16_t* t = a; a = b; b = t;
+        uint32_t tn = na; na = nb; nb = tn;
+    }
+    
+    uint32_t n = 0;
+    if (na * ROARING_GALLOP_RATIO < nb) {
+        uint32_t j = 0;
+        for (uint32_t i = 0; i < na && j < nb; i++) {
+            j = roaring_gallop(b, nb, j, a[i]);
+            if (j < nb && b[j] == a[i]) {
+                out[n++] = a[i];
+            }
+        }
+        return n;
+    }
+    
+    uint32_t i = 0;
+    uint32_t j = 0;
+    while (i < na && j < nb) {
+        if (a[i] < b[j]) {
+            i++;
+        } else if (a[i] > b[j]) {
+            j++;
+        } else {
+            out[n++] = a[i];
+            i++;
+            j++;
+        }
+    }
+    return n;
+}
+
+// Sorted union of two arrays into out; returns its size
+static uint32_t roaring_array_or(const uint16_t* a, uint32_t na, const uint16_t* b, uint32_t nb,
+                                 uint16_t* out) {
+    uint32_t i = 0;
+    uint32_t j = 0;
+    uint32_t n = 0;
+    while (i < na && j < nb) {
+        if (a[i] < b[j]) {
+            out[n++] = a[i++];
+        } else if (a[i] > b[j]) {
+            out[n++] = b[j++];
+        } else {
+            out[n++] = a[i++];
+            j++;
+        }
+    }
+    while (i < na) {
+        out[n++] = a[i++];
+    }
+    while (j < nb) {
+        out[n++] = b[j++];
+    }
+    return n;
+}
+
+// Intersect two containers with the same key into `out` (left empty if disjoint)
+static void roaring_container_and(const RoaringContainer* a, const RoaringContainer* b,
+                                  RoaringContainer* out) {
+    if (a->is_bitmap && b->is_bitmap) {
+        out->words = roaring_words_alloc();
+        out->is_bitmap = true;
+        out->cardinality = roaring_words_and(out->words, a->words, b->words);
+        roaring_container_shrink(out);
+        return;
+    }
+    
+    if (a->is_bitmap) {
+        const RoaringContainer* t = a; a = b; b = t;
+    }
+    roaring_array_reserve(out, a->cardinality);
+    if (b->is_bitmap) {
+        uint32_t n = 0;
+        for (uint32_t i = 0; i < a->cardinality; i++) {
+            uint16_t low = a->array[i];
+            out->array[n] = low;
+            n += (b->words[low >> 6] >> (low & 63)) & 1;
+        }
+        out->cardinality = n;
+    } else {
+        out->cardinality = roaring_array_and(a->array, a->cardinality, b->array, b->cardinality,
+                                             out->array);
+    }
+}
+
+// Union of two containers with the same key into `out`
+static void roaring_container_or(const RoaringContainer* a, const RoaringContainer* b,
+                                 RoaringContainer* out) {
+    if (a->is_bitmap && b->is_bitmap) {
+        out->words = roaring_words_alloc();
+        out->is_bitmap = true;
+        out->cardinality = roaring_words_or(out->words, a->words, b->words);
+        return;
+    }
+    
+    if (a->is_bitmap || b->is_bitmap) {
+        if (b->is_bitmap) {
+            const RoaringContainer* t = a; a = b; b = t;
+        }
+        out->words = roaring_words_alloc();
+        out->is_bitmap = true;
+        memcpy(out->words, a->words, ROARING_BITMAP_WORDS * sizeof(uint64_t));
+        out->cardinality = a->cardinality;
+        for (uint32_t i = 0; i < b->cardinality; i++) {
+            uint16_t low = b->array[i];
+            uint64_t bit = 1ULL << (low & 63);
+            out->cardinality += !(out->words[low >> 6] & bit);
+            out->words[low >> 6] |= bit;
+        }
+        return;
+    }
+    
+    if (a->cardinality + b->cardinality <= ROARING_ARRAY_MAX) {
+        roaring_array_reserve(out, a->cardinality + b->cardinality);
+        out->cardinality = roaring_array_or(a->array, a->cardinality, b->array, b->cardinality,
+                                            out->array);
+        return;
+    }
+    
+    out->words = roaring_words_alloc();
+    out->is_bitmap = true;
+    for (uint32_t i = 0; i < a->cardinality; i++) {
+        out->words[a->array[i] >> 6] |= 1ULL << (a->array[i] & 63);
+    }
+    for (uint32_t i = 0; i < b->cardinality; i++) {
+        out->words[b->array[i] >> 6] |= 1ULL << (b->array[i] & 63);
+    }
+    out->cardinality = roaring_words_count(out->words);
+    roaring_container_shrink(out);
+}
+
+// Copy of one container, appended to `to`
+static void roaring_append_copy(RoaringBitmap* to, const RoaringContainer* from) {
+    RoaringContainer* copy = roaring_append_container(to, from->key);
+    copy->cardinality = from->cardinality;
+    copy->is_bitmap = from->is_bitmap;
+    if (from->is_bitmap) {
+        copy->words = roaring_words_alloc();
+        memcpy(copy->words, from->words, ROARING_BITMAP_WORDS * sizeof(uint64_t));
+    } else {
+        roaring_array_reserve(copy, from->cardinality);
+        memcpy(copy->array, from->array, from->cardinality * sizeof(uint16_t));
+    }
+}
+
+// Values in both bitmaps; only containers whose keys match are visited
+RoaringBitmap* roaring_and(const RoaringBitmap* a, const RoaringBitmap* b) {
+    RoaringBitmap* result = roaring_create();
+    uint32_t i = 0;
+    uint32_t j = 0;
+    while (i < a->num_containers && j < b->num_containers) {
+        uint16_t ka = a->containers[i].key;
+        uint16_t kb = b->containers[j].key;
+        if (ka < kb) {
+            i++;
+        } else if (ka > kb) {
+            j++;
+        } else {
+            RoaringContainer* out = roaring_append_container(result, ka);
+            roaring_container_and(&a->containers[i], &b->containers[j], out);
+            if (out->cardinality == 0) {
+                roaring_container_free(out);
+                result->num_containers--;
+            }
+            i++;
+            j++;
+        }
+    }
+    return result;
+}
+
+RoaringBitmap* roaring_or(const RoaringBitmap* a, const RoaringBitmap* b) {
+    RoaringBitmap* result = roaring_create();
+    uint32_t i = 0;
+    uint32_t j = 0;
+    while (i < a->num_containers || j < b->num_containers) {
+        if (j >= b->num_containers ||
+            (i < a->num_containers && a->containers[i].key < b->containers[j].key)) {
+            roaring_append_copy(result, &a->containers[i++]);
+        } else if (i >= a->num_containers || b->containers[j].key < a->containers[i].key) {
+            roaring_append_copy(result, &b->containers[j++]);
+        } else {
+            RoaringContainer* out = roaring_append_container(result, a->containers[i].key);
+            roaring_container_or(&a->containers[i], &b->containers[j], out);
+            i++;
+            j++;
+        }
+    }
+    return result;
+}
+
+// Every value in increasing order; the caller frees the array
+uint32_t* roaring_to_array(const RoaringBitmap* bitmap, uint32_t* count) {
+    uint64_t total = roaring_cardinality(bitmap);
+    uint32_t* values = malloc((total ? total : 1) * sizeof(uint32_t));
+    uint32_t n = 0;
+    for (uint32_t c = 0; c < bitmap->num_containers; c++) {
+        const RoaringContainer* container = &bitmap->containers[c];
+        uint32_t high = (uint32_t)container->key << 16;
+        if (container->is_bitmap) {
+            for (uint32_t i = 0; i < ROARING_BITMAP_WORDS; i++) {
+                for (uint64_t word = container->words[i]; word; word &= word - 1) {
+                    values[n++] = high | (i * 64 + __builtin_ctzll(word));
+                }
+            }
+        } else {
+            for (uint32_t i = 0; i < container->cardinality; i++) {
+                values[n++] = high | container->array[i];
+            }
+        }
+    }
+    *count = n;
+    return values;
+}
+
+size_t roaring_size_in_bytes(const RoaringBitmap* bitmap) {
+    size_t size = sizeof(RoaringBitmap) + bitmap->capacity * sizeof(RoaringContainer);
+    for (uint32_t i = 0; i < bitmap->num_containers; i++) {
+        const RoaringContainer* container = &bitmap->containers[i];
+        size += container->is_bitmap ? ROARING_BITMAP_WORDS * sizeof(uint64_t) :
+                                       container->capacity * sizeof(uint16_t);
+    }
+    return size;
+}
+
+/*
+ * On disk: the container count, then per container its key, kind and
+ * cardinality followed by the sorted array or the 1024 bitmap words
+ */
+bool roaring_write(const RoaringBitmap* bitmap, FILE* file) {
+    if (fwrite(&bitmap->num_containers, sizeof(uint32_t), 1, file) != 1) {
+        return false;
+    }
+    for (uint32_t i = 0; i < bitmap->num_containers; i++) {
+        const RoaringContainer* container = &bitmap->containers[i];
+        uint32_t header[3] = { container->key, container->is_bitmap, container->cardinality };
+        bool ok = fwrite(header, sizeof(header), 1, file) == 1 &&
+                  (container->is_bitmap ?
+                   fwrite(container->words, sizeof(uint64_t), ROARING_BITMAP_WORDS, file) == ROARING_BITMAP_WORDS :
+                   fwrite(container->array, sizeof(uint16_t), container->cardinality, file) == container->cardinality);
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// NULL if the data is truncated or malformed
+RoaringBitmap* roaring_read(FILE* file) {
+    uint32_t num_containers;
+    if (fread(&num_containers, sizeof(uint32_t), 1, file) != 1 || num_containers > 65536) {
+        return NULL;
+    }
+    
+    RoaringBitmap* bitmap = roaring_create();
+    for (uint32_t i = 0; i < num_containers; i++) {
+        uint32_t header[3];
+        if (fread(header, sizeof(header), 1, file) != 1 || header[0] > UINT16_MAX ||
+            header[2] == 0 || (!header[1] && header[2] > ROARING_ARRAY_MAX) ||
+            (i > 0 && header[0] <= bitmap->containers[i - 1].key)) {
+            roaring_free(bitmap);
+            return NULL;
+        }
+        
+        RoaringContainer* container = roaring_append_container(bitmap, (uint16_t)header[0]);
+        container->cardinality = header[2];
+        bool ok;
+        if (header[1]) {
+            container->is_bitmap = true;
+            container->words = roaring_words_alloc();
+            ok = fread(container->words, sizeof(uint64_t), ROARING_BITMAP_WORDS, file) == ROARING_BITMAP_WORDS &&
+                 roaring_words_count(container->words) == container->cardinality;
+        } else {
+            roaring_array_reserve(container, header[2]);
+            ok = fread(container->array, sizeof(uint16_t), header[2], file) == header[2];
+        }
+        if (!ok) {
+            roaring_free(bitmap);
+            return NULL;
+        }
+    }
+    return bitmap;
+}
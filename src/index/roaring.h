@@ -0,0 +1,51 @@
+#ifndef ROARING_H
+#define ROARING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+/*
+ * Compressed bitmap of 32-bit values (roaring layout)
+ *
+ * Values are split by their high 16 bits into containers, kept sorted
+ * by that key. A container holding up to ROARING_ARRAY_MAX values is a
+ * sorted array of their low 16 bits; a denser one is a 65536-bit bitmap
+ * (8 KB), so no container is ever larger than the plain bitmap. Bitmap
+ * containers are combined 128 bits at a time with SSE2 where available,
+ * and carry their cardinality so counts never rescan the bits.
+ */
+#define ROARING_ARRAY_MAX 4096
+#define ROARING_BITMAP_WORDS 1024   // 64-bit words in a bitmap container
+
+typedef struct {
+    uint16_t key;          // High 16 bits of every value in the container
+    bool is_bitmap;
+    uint32_t cardinality;
+    uint32_t capacity;     // Array slots allocated; unused for a bitmap
+    uint16_t* array;       // Sorted low 16 bits, when !is_bitmap
+    uint64_t* words;       // ROARING_BITMAP_WORDS words, when is_bitmap
+} RoaringContainer;
+
+typedef struct {
+    RoaringContainer* containers;  // Sorted by key
+    uint32_t num_containers;
+    uint32_t capacity;
+} RoaringBitmap;
+
+// Function declarations
+RoaringBitmap* roaring_create(void);
+void roaring_free(RoaringBitmap* bitmap);
+RoaringBitmap* roaring_copy(const RoaringBitmap* bitmap);
+void roaring_add(RoaringBitmap* bitmap, uint32_t value);
+void roaring_remove(RoaringBitmap* bitmap, uint32_t value);
+bool roaring_contains(const RoaringBitmap* bitmap, uint32_t value);
+uint64_t roaring_cardinality(const RoaringBitmap* bitmap);
+RoaringBitmap* roaring_and(const RoaringBitmap* a, const RoaringBitmap* b);
+RoaringBitmap* roaring_or(const RoaringBitmap* a, const RoaringBitmap* b);
+uint32_t* roaring_to_array(const RoaringBitmap* bitmap, uint32_t* count);
+size_t roaring_size_in_bytes(const RoaringBitmap* bitmap);
+bool roaring_write(const RoaringBitmap* bitmap, FILE* file);
+RoaringBitmap* roaring_read(FILE* file);
+
+#endif // ROARING_H
@@ -4,38 +4,169 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "../storage/table.h"
+#include "../storage/schema.h"
+#include "bloom.h"
 
-#define MAX_INDEXES 4
 #define INDEX_KEY_SIZE 64
 
+// One index entry, and the key the index B+tree is ordered by
 typedef struct {
     char key[INDEX_KEY_SIZE];  // The indexed value (e.g., username)
     uint32_t primary_key;       // Points to the primary key (id)
 } IndexEntry;
 
+/*
+ * Index B+Tree Node Layout
+ *
+ * Each index is a B+tree in its own file "<db>.<table>.<column>.idx",
+ * ordered by (value, primary key) so every entry is unique and all
+ * entries for one value are adjacent. Page 0 is always the root.
+ */
+#define INDEX_NODE_TYPE_OFFSET 0
+#define INDEX_NODE_IS_ROOT_OFFSET 1
+#define INDEX_NODE_NUM_KEYS_OFFSET 4
+#define INDEX_NODE_HEADER_SIZE 8
+
+/*
+ * Leaf: next leaf page (0 for the rightmost leaf), then the entries. An
+ * index with INCLUDE columns stores their values right after each entry
+ * (username, then email, at their row sizes), so its leaves hold fewer
+ * entries than INDEX_LEAF_MAX_ENTRIES.
+ */
+#define INDEX_LEAF_NEXT_LEAF_OFFSET INDEX_NODE_HEADER_SIZE
+#define INDEX_LEAF_HEADER_SIZE (INDEX_NODE_HEADER_SIZE + sizeof(uint32_t))
+#define INDEX_LEAF_MAX_ENTRIES ((PAGE_SIZE - INDEX_LEAF_HEADER_SIZE) / sizeof(IndexEntry))
+#define INDEX_MAX_PAYLOAD_SIZE (COLUMN_USERNAME_SIZE + COLUMN_EMAIL_SIZE)
+
+/*
+ * Internal: children[num_keys + 1], then keys[num_keys]. Child i holds
+ * the entries below keys[i]; child num_keys holds the rest.
+ */
+#define INDEX_INTERNAL_MAX_KEYS \
+    ((PAGE_SIZE - INDEX_NODE_HEADER_SIZE - sizeof(uint32_t)) / (sizeof(IndexEntry) + sizeof(uint32_t)))
+#define INDEX_INTERNAL_CHILDREN_OFFSET INDEX_NODE_HEADER_SIZE
+#define INDEX_INTERNAL_KEYS_OFFSET \
+    (INDEX_INTERNAL_CHILDREN_OFFSET + (INDEX_INTERNAL_MAX_KEYS + 1) * sizeof(uint32_t))
+#define INDEX_MAX_DEPTH 16
+
+typedef struct BitmapIndex BitmapIndex;
+
 typedef struct {
     char column_name[32];
     char table_name[64];
-    IndexEntry* entries;
-    uint32_t num_entries;
-    uint32_t capacity;
+    RowColumn column_id;
+    IndexType type;
+    uint32_t include_columns;   // INDEX_COLUMN_* values stored with each entry
+    uint32_t flags;             // INDEX_FLAG_* options from the definition
+    uint32_t payload_size;      // Bytes of INCLUDE values per entry
+    uint32_t leaf_entry_size;   // B+tree leaf entry: IndexEntry + payload
+    uint32_t leaf_max_entries;
+    Pager* pager;               // B+tree or hash pages; NULL for a bitmap index
+    BitmapIndex* bitmaps;       // Value bitmaps of a bitmap index, which lives in memory
+    WAL* wal;
+    uint32_t wal_table_id;
+    BloomFilter* bloom;         // Keys in the index, NULL without WITH BLOOM
+    char* bloom_path;
+    char* bitmap_path;
 } SecondaryIndex;
 
+typedef void (*IndexEntryVisitor)(const IndexEntry* entry, void* context);
+
+// Results of a lookup: primary keys, and rows rebuilt from the index when wanted
+typedef struct {
+    uint32_t* ids;
+    Row* rows;
+    uint32_t count;
+    uint32_t capacity;
+    bool want_rows;
+} IndexMatches;
+
+/*
+ * Key range for an ordered scan of a B+tree index. Bounds are inclusive
+ * and compared on stored (truncated) keys, so a scan may return entries
+ * just outside a strict or long bound; callers recheck their predicate.
+ */
+typedef struct {
+    char lower[INDEX_KEY_SIZE];
+    bool has_lower;
+    char upper[INDEX_KEY_SIZE];
+    bool has_upper;
+    char prefix[INDEX_KEY_SIZE];  // Keys must start with this, when not empty
+} IndexRange;
+
+// Streaming position in a B+tree index, in (key, primary key) order
+typedef struct {
+    SecondaryIndex* index;
+    IndexRange range;
+    uint32_t page_num;
+    uint32_t cell_num;
+    bool end_of_index;
+} IndexCursor;
+
+/*
+ * The indexes on one table. Each table the catalog sees gets a dense id,
+ * and by_column maps (column id, type) to the index, so resolving an
+ * index is two array reads once the table is known.
+ */
+typedef struct {
+    char name[64];
+    uint32_t id;
+    SecondaryIndex** indexes;   // Every index on the table, for row maintenance
+    uint32_t num_indexes;
+    uint32_t capacity;
+    SecondaryIndex* by_column[INDEX_NUM_COLUMNS][INDEX_NUM_TYPES];
+} IndexTable;
+
+/*
+ * Index catalog. Indexes and IndexTables are allocated one by one, so
+ * handles stay valid as the catalog grows. Table names map to table ids
+ * through an open-addressed hash table.
+ */
 typedef struct {
-    SecondaryIndex indexes[MAX_INDEXES];
+    IndexTable** tables;        // By table id
+    uint32_t num_tables;
+    uint32_t tables_capacity;
+    uint32_t* table_slots;      // Table id + 1 per slot, 0 for an empty slot
+    uint32_t num_slots;         // Power of two, at most half full
+    SecondaryIndex** indexes;   // In creation order
     uint32_t num_indexes;
+    uint32_t indexes_capacity;
+    char base_path[256];
+    WAL* wal;
 } IndexManager;
 
 // Function declarations
-IndexManager* index_manager_create();
+IndexManager* index_manager_create(const char* base_path, WAL* wal);
 void index_manager_free(IndexManager* manager);
-bool index_manager_create_index(IndexManager* manager, const char* table_name, const char* column_name);
-SecondaryIndex* index_manager_get(IndexManager* manager, const char* table_name, const char* column_name);
-bool secondary_index_insert(SecondaryIndex* index, const char* key, uint32_t primary_key);
+bool index_manager_create_index(IndexManager* manager, const IndexDef* def);
+bool index_manager_open_index(IndexManager* manager, const IndexDef* def);
+void index_manager_drop_index(IndexManager* manager, const IndexDef* def);
+SecondaryIndex* index_manager_get(IndexManager* manager, const char* table_name,
+                                  const char* column_name, IndexType type);
+SecondaryIndex* index_manager_get_for_equality(IndexManager* manager, const char* table_name,
+                                               const char* column_name);
+IndexTable* index_manager_table(IndexManager* manager, const char* table_name);
+SecondaryIndex* index_table_get(IndexTable* table, const char* column_name, IndexType type);
+int index_column_id(const char* column_name);
+bool secondary_index_insert(SecondaryIndex* index, const Row* row);
 uint32_t* secondary_index_lookup(SecondaryIndex* index, const char* key, uint32_t* count);
+Row* secondary_index_lookup_rows(SecondaryIndex* index, const char* key, uint32_t* count);
+uint32_t secondary_index_columns(SecondaryIndex* index);
+uint32_t index_column_bit(const char* column_name);
+void index_payload_store(SecondaryIndex* index, const Row* row, void* payload);
+void index_matches_add(IndexMatches* matches, SecondaryIndex* index, const char* key,
+                       uint32_t primary_key, const void* payload);
+IndexCursor* secondary_index_seek(SecondaryIndex* index, const IndexRange* range);
+void index_cursor_advance(IndexCursor* cursor);
+IndexEntry* index_cursor_entry(IndexCursor* cursor);
+void index_cursor_row(IndexCursor* cursor, Row* row);
+bool index_key_is_truncated(const IndexEntry* entry);
 void secondary_index_delete(SecondaryIndex* index, const char* key, uint32_t primary_key);
 void secondary_index_print(SecondaryIndex* index);
-bool index_manager_build_from_table(IndexManager* manager, const char* table_name, 
-                                     const char* column_name, Table* table);
+void secondary_index_for_each(SecondaryIndex* index, IndexEntryVisitor visit, void* context);
+bool index_manager_build_from_table(IndexManager* manager, const IndexDef* def, Table* table);
+void index_table_insert_row(IndexTable* table, Row* row);
+void index_table_delete_row(IndexTable* table, Row* row);
+void index_table_update_row(IndexTable* table, Row* old_row, Row* new_row);
 
 #endif // SECONDARY_INDEX_H
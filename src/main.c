@@ -2,11 +2,16 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <time.h>
 #include "storage/table.h"
 #include "index/btree.h"
 #include "index/secondary_index.h" 
+#include "index/bitmap_index.h"
 #include "parser/parser.h"
 #include "optimizer/optimizer.h"
+#include "optimizer/analyze.h"
+#include "optimizer/plan_cache.h"
+#include "optimizer/query_stats.h"
 #include "storage/schema.h"
 #include "storage/table_manager.h"
 
@@ -15,6 +20,7 @@ static QueryStats* global_stats = NULL;
 static Schema* global_schema = NULL;
 static TableManager* table_manager = NULL;
 static IndexManager* index_manager = NULL;
+static PlanCache* plan_cache = NULL;
 static char current_table_name[64] = "";
 static char current_db_filename[256] = "";
 
@@ -59,7 +65,8 @@ typedef enum {
     EXECUTE_SUCCESS,
     EXECUTE_DUPLICATE_KEY,
     EXECUTE_TABLE_FULL,
-    EXECUTE_NOT_FOUND
+    EXECUTE_NOT_FOUND,
+    EXECUTE_FAILED          // The statement failed and has already printed why
 } ExecuteResult;
 
 InputBuffer* new_input_buffer() {
@@ -102,6 +109,9 @@ MetaCommandResult do_meta_command(InputBuffer* input_buffer, Table* table) {
         if (global_schema) {
             schema_free(global_schema);
         }
+        if (plan_cache) {
+            plan_cache_free(plan_cache);
+        }
         if (index_manager) {
             index_manager_free(index_manager);
         }
@@ -116,7 +126,7 @@ MetaCommandResult do_meta_command(InputBuffer* input_buffer, Table* table) {
         if (index_manager) {
             printf("\n=== Secondary Indexes ===\n");
             for (uint32_t i = 0; i < index_manager->num_indexes; i++) {
-                secondary_index_print(&index_manager->indexes[i]);
+                secondary_index_print(index_manager->indexes[i]);
             }
         }
         return META_COMMAND_SUCCESS;
@@ -125,10 +135,21 @@ MetaCommandResult do_meta_command(InputBuffer* input_buffer, Table* table) {
             schema_print(global_schema);
         }
         return META_COMMAND_SUCCESS;
+    } else if (strcmp(input_buffer->buffer, ".stats json") == 0) {
+        if (global_stats) {
+            stats_print_json(global_stats, plan_cache);
+        }
+        return META_COMMAND_SUCCESS;
     } else if (strcmp(input_buffer->buffer, ".stats") == 0) {  // <-- ADD THIS
         if (global_stats) {
             stats_print(global_stats);
         }
+        if (plan_cache) {
+            plan_cache_print(plan_cache);
+        }
+        if (table) {
+            table_stats_print(table);
+        }
         return META_COMMAND_SUCCESS;
     } else if (strcmp(input_buffer->buffer, ".btree") == 0) {
         if (!table) {
@@ -136,11 +157,11 @@ MetaCommandResult do_meta_command(InputBuffer* input_buffer, Table* table) {
             return META_COMMAND_SUCCESS;
         }
         printf("Tree:\n");
-        print_tree(table->pager, 0, 0);
+        print_tree(table->pager, table->root_page_num, 0);
         return META_COMMAND_SUCCESS;
     } else if (strcmp(input_buffer->buffer, ".checkpoint") == 0) {
         if (table && table->wal) {
-            wal_checkpoint(table->wal, table->pager);
+            wal_checkpoint(table->wal);
         }
         return META_COMMAND_SUCCESS;
     } else if (strcmp(input_buffer->buffer, ".begin") == 0) {
@@ -192,7 +213,7 @@ MetaCommandResult do_meta_command(InputBuffer* input_buffer, Table* table) {
 
 ExecuteResult execute_create_index(ParsedStatement* stmt, Table* table) {
     if (!index_manager) {
-        index_manager = index_manager_create();
+        index_manager = index_manager_create(current_db_filename, table_manager->wal);
     }
     
     // Build the index against the table it was actually declared on,
@@ -204,23 +225,90 @@ ExecuteResult execute_create_index(ParsedStatement* stmt, Table* table) {
     }
     (void)table; // kept for signature symmetry with other execute_* functions
     
-    if (index_manager_create_index(index_manager, stmt->index_table, stmt->index_column)) {
-        // Build the index from existing table data
-        index_manager_build_from_table(index_manager, stmt->index_table, stmt->index_column, target_table);
-        return EXECUTE_SUCCESS;
+    IndexDef def;
+    memset(&def, 0, sizeof(IndexDef));
+    strncpy(def.table_name, stmt->index_table, MAX_TABLE_NAME - 1);
+    strncpy(def.column_name, stmt->index_column, MAX_COLUMN_NAME - 1);
+    def.type = stmt->index_type;
+    def.flags = stmt->index_flags;
+    
+    // INCLUDE columns other than the id and the key, which every entry has
+    for (uint32_t i = 0; i < stmt->num_index_include; i++) {
+        uint32_t bit = index_column_bit(stmt->index_include[i]);
+        if (!bit) {
+            printf("Error: Cannot INCLUDE column '%s'\n", stmt->index_include[i]);
+            return EXECUTE_NOT_FOUND;
+        }
+        def.include_columns |= bit;
+    }
+    def.include_columns &= ~(INDEX_COLUMN_ID | index_column_bit(def.column_name));
+    
+    // Already printed: an unknown column, or an index of this type on it
+    if (!index_manager_create_index(index_manager, &def)) {
+        return EXECUTE_FAILED;
+    }
+    
+    // Build the index from existing table data. A build that fails
+    // leaves it incomplete, so it is dropped rather than trusted.
+    if (!index_manager_build_from_table(index_manager, &def, target_table)) {
+        index_manager_drop_index(index_manager, &def);
+        return EXECUTE_FAILED;
     }
     
-    return EXECUTE_TABLE_FULL;
+    // Record the index in the catalog only once its contents are
+    // durable, so a crash mid-build never leaves a half-built index
+    // that later sessions would trust.
+    if (!global_schema) {
+        global_schema = schema_create();
+    }
+    schema_add_index(global_schema, &def);
+    schema_save(global_schema, current_db_filename);
+    return EXECUTE_SUCCESS;
 }
 
-ExecuteResult execute_insert(ParsedStatement* stmt, Table* table) {
-    void* node = pager_get_page(table->pager, table->root_page_num);
-    uint32_t num_cells = (*leaf_node_num_cells(node));
+// Sample one table's pages and replace its statistics in the catalog
+static void analyze_one_table(Table* table) {
+    ColumnStats stats[INDEX_NUM_COLUMNS];
+    uint32_t num_columns = analyze_table(table, schema_get_table(global_schema, table->name), stats);
+    schema_set_column_stats(global_schema, table->name, stats, num_columns);
+    printf("Analyzed %s: %u rows, %u sampled, %u columns\n", table->name,
+           table->header->row_count, num_columns ? stats[0].sampled_rows : 0, num_columns);
+}
+
+ExecuteResult execute_analyze(ParsedStatement* stmt) {
+    if (!global_schema) {
+        global_schema = schema_create();
+    }
     
+    if (stmt->table_name[0] != '\0') {
+        Table* target_table = table_manager_get(table_manager, stmt->table_name);
+        if (!target_table && schema_get_table(global_schema, stmt->table_name)) {
+            target_table = resolve_table(stmt->table_name);
+        }
+        if (!target_table) {
+            printf("Error: Unknown table '%s'\n", stmt->table_name);
+            return EXECUTE_NOT_FOUND;
+        }
+        analyze_one_table(target_table);
+    } else {
+        for (uint32_t i = 0; i < table_manager->num_tables; i++) {
+            analyze_one_table(table_manager->tables[i]);
+        }
+    }
+    
+    schema_save(global_schema, current_db_filename);
+    return EXECUTE_SUCCESS;
+}
+
+ExecuteResult execute_insert(ParsedStatement* stmt, Table* table, QueryPlan* plan) {
     Row* row_to_insert = &(stmt->row_to_insert);
     uint32_t key_to_insert = row_to_insert->id;
     Cursor* cursor = table_find(table, key_to_insert);
     
+    // Duplicate check against the leaf the key would land in
+    void* node = pager_get_page(table->pager, cursor->page_num);
+    uint32_t num_cells = (*leaf_node_num_cells(node));
+    
     if (cursor->cell_num < num_cells) {
         uint32_t key_at_index = *leaf_node_key(node, cursor->cell_num);
         if (key_at_index == key_to_insert) {
@@ -232,169 +320,1201 @@ ExecuteResult execute_insert(ParsedStatement* stmt, Table* table) {
     leaf_node_insert(cursor, row_to_insert->id, row_to_insert);
     
     // Update secondary indexes
-    if (index_manager && current_table_name[0] != '\0') {
-        SecondaryIndex* username_idx = index_manager_get(index_manager, current_table_name, "username");
-        if (username_idx) {
-            secondary_index_insert(username_idx, row_to_insert->username, row_to_insert->id);
+    index_table_insert_row(plan->table_indexes, row_to_insert);
+    
+    // Log to WAL: a logical record when only this leaf changed,
+    // full page images if the insert split it
+    WALLogicalRecord record = {
+        .op = WAL_OP_INSERT,
+        .page_number = cursor->page_num,
+        .cell_num = cursor->cell_num,
+        .key = key_to_insert,
+        .row = leaf_node_value(node, cursor->cell_num)
+    };
+    wal_log_changes(table->wal, table->wal_table_id, table->pager, &record);
+    
+    free(cursor);
+    return EXECUTE_SUCCESS;
+}
+
+ExecuteResult execute_create_table(ParsedStatement* stmt) {
+    if (!global_schema) {
+        global_schema = schema_create();
+    }
+    
+    if (schema_add_table(global_schema, stmt->table_name, 
+                         stmt->columns, stmt->num_columns)) {
+        // Open (and thereby create) the physical backing file for this
+        // table, and make it the active table for subsequent statements
+        // that don't specify a FROM/table target.
+        Table* t = table_manager_open(table_manager, stmt->table_name);
+        if (!t) {
+            return EXECUTE_TABLE_FULL;
         }
+        strncpy(current_table_name, stmt->table_name, sizeof(current_table_name) - 1);
+        current_table_name[sizeof(current_table_name) - 1] = '\0';
+        
+        // Persist the schema so table structure survives a restart.
+        schema_save(global_schema, current_db_filename);
         
-        SecondaryIndex* email_idx = index_manager_get(index_manager, current_table_name, "email");
-        if (email_idx) {
-            secondary_index_insert(email_idx, row_to_insert->email, row_to_insert->id);
+        printf("Table '%s' created successfully.\n", stmt->table_name);
+        return EXECUTE_SUCCESS;
+    } else {
+        return EXECUTE_TABLE_FULL;
+    }
+}
+
+/*
+ * Physical storage always has exactly 3 slots per row: id (uint32),
+ * and two string slots (historically called "username"/"email").
+ * A table's declared schema maps logical column names onto these slots
+ * by position (column 0 -> id, column 1 -> slot 1, column 2 -> slot 2).
+ * This looks up a column's value for a given row as a string, so join
+ * and where-clause comparisons work regardless of what the column is
+ * actually called in the schema (e.g. "user_id" instead of "username").
+ */
+static int column_slot(const char* table_name, const char* column_name) {
+    if (!global_schema) {
+        return -1;
+    }
+    TableSchema* schema = schema_get_table(global_schema, table_name);
+    if (!schema) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < schema->num_columns && i < 3; i++) {
+        if (strcmp(schema->columns[i].name, column_name) == 0) {
+            return (int)i;
+        }
+    }
+    return -1; // only 3 physical columns are supported
+}
+
+static void slot_value_as_string(int slot, Row* row, char* out, size_t out_size) {
+    switch (slot) {
+        case 0:
+            snprintf(out, out_size, "%u", row->id);
+            break;
+        case 1:
+            strncpy(out, row->username, out_size - 1);
+            out[out_size - 1] = '\0';
+            break;
+        default:
+            strncpy(out, row->email, out_size - 1);
+            out[out_size - 1] = '\0';
+            break;
+    }
+}
+
+static bool get_column_value_as_string(const char* table_name, const char* column_name,
+                                        Row* row, char* out, size_t out_size) {
+    int slot = column_slot(table_name, column_name);
+    if (slot < 0) {
+        return false;
+    }
+    slot_value_as_string(slot, row, out, out_size);
+    return true;
+}
+
+// A row's value for a column, as a string; false for an unknown column
+static bool row_column_value(const char* table_name, const char* column, Row* row,
+                             char* out, size_t out_size) {
+    if (strcmp(column, "id") == 0) {
+        snprintf(out, out_size, "%u", row->id);
+    } else if (strcmp(column, "username") == 0) {
+        snprintf(out, out_size, "%s", row->username);
+    } else if (strcmp(column, "email") == 0) {
+        snprintf(out, out_size, "%s", row->email);
+    } else {
+        return get_column_value_as_string(table_name, column, row, out, out_size);
+    }
+    return true;
+}
+
+// Whether a row satisfies one condition. Unknown columns do not filter.
+static bool row_matches_condition(const Condition* condition, const char* table_name, Row* row) {
+    char value[COLUMN_EMAIL_SIZE];
+    if (!row_column_value(table_name, condition->column, row, value, sizeof(value))) {
+        return true;
+    }
+    return condition_matches(condition, value, strcmp(condition->column, "id") == 0);
+}
+
+static bool where_node_matches_row(const WhereNode* node, const char* table_name, Row* row) {
+    switch (node->type) {
+        case WHERE_CONDITION:
+            return row_matches_condition(node->condition, table_name, row);
+        case WHERE_AND:
+            return where_node_matches_row(node->left, table_name, row) &&
+                   where_node_matches_row(node->right, table_name, row);
+        case WHERE_OR:
+            return where_node_matches_row(node->left, table_name, row) ||
+                   where_node_matches_row(node->right, table_name, row);
+    }
+    return false;
+}
+
+// Whether a row satisfies the WHERE clause
+static bool row_matches_where(ParsedStatement* stmt, const char* table_name, Row* row) {
+    return !stmt->has_where || where_node_matches_row(stmt->where_tree, table_name, row);
+}
+
+/*
+ * A WHERE condition resolved against the cell layout once per statement,
+ * so a leaf scan can test it on the serialized row and deserialize only
+ * the rows that pass. Behaves exactly like row_matches_condition.
+ */
+typedef struct {
+    const Condition* condition;
+    int slot;                 // Storage slot of the column; -1 if unknown, which never filters
+    bool numeric;             // Compared as a number, as the id column is
+    long long lower;          // The numeric value
+    long long upper;          // ...and BETWEEN's upper bound
+} CellPredicate;
+
+typedef struct {
+    const WhereNode* tree;
+    CellPredicate* predicates;  // By Condition.position
+} CellFilter;
+
+// Compare a fixed-size string field, NUL-padded or full, with a C string
+static int field_compare(const char* field, size_t size, const char* value) {
+    for (size_t i = 0; i < size; i++) {
+        unsigned char a = field[i];
+        unsigned char b = value[i];
+        if (a != b) {
+            return a < b ? -1 : 1;
+        }
+        if (a == '\0') {
+            return 0;
+        }
+    }
+    return value[size] ? -1 : 0;
+}
+
+static bool cell_predicate_matches(const CellPredicate* predicate, const uint8_t* cell) {
+    const Condition* condition = predicate->condition;
+    if (predicate->slot < 0) {
+        return true;
+    }
+    
+    char value[COLUMN_EMAIL_SIZE + 1];
+    if (predicate->slot == 0) {
+        uint32_t id;
+        memcpy(&id, cell + ID_OFFSET, ID_SIZE);
+        if (predicate->numeric && condition->op != OP_LIKE) {
+            long long v = id;
+            return condition_compare(condition, (v > predicate->lower) - (v < predicate->lower),
+                                     (v > predicate->upper) - (v < predicate->upper));
+        }
+        snprintf(value, sizeof(value), "%u", id);
+        return condition_matches(condition, value, predicate->numeric);
+    }
+    
+    const char* field = (const char*)cell + (predicate->slot == 1 ? USERNAME_OFFSET : EMAIL_OFFSET);
+    size_t size = predicate->slot == 1 ? USERNAME_SIZE : EMAIL_SIZE;
+    if (condition->op == OP_LIKE) {
+        memcpy(value, field, size);
+        value[size] = '\0';
+        return like_match(condition->value, value);
+    }
+    return condition_compare(condition, field_compare(field, size, condition->value),
+                             condition->value2 ? field_compare(field, size, condition->value2) : 0);
+}
+
+static bool where_node_matches_cell(const WhereNode* node, const CellFilter* filter,
+                                    const uint8_t* cell) {
+    switch (node->type) {
+        case WHERE_CONDITION:
+            return cell_predicate_matches(&filter->predicates[node->condition->position], cell);
+        case WHERE_AND:
+            return where_node_matches_cell(node->left, filter, cell) &&
+                   where_node_matches_cell(node->right, filter, cell);
+        case WHERE_OR:
+            return where_node_matches_cell(node->left, filter, cell) ||
+                   where_node_matches_cell(node->right, filter, cell);
+    }
+    return false;
+}
+
+// The statement's WHERE clause compiled for leaf cells of table_name; NULL without WHERE
+static CellFilter* cell_filter_create(ParsedStatement* stmt, const char* table_name) {
+    if (!stmt->has_where) {
+        return NULL;
+    }
+    
+    uint32_t count = 0;
+    for (Condition* condition = stmt->where_clause; condition; condition = condition->next) {
+        count++;
+    }
+    CellFilter* filter = malloc(sizeof(CellFilter));
+    filter->tree = stmt->where_tree;
+    filter->predicates = calloc(count, sizeof(CellPredicate));
+    for (Condition* condition = stmt->where_clause; condition; condition = condition->next) {
+        CellPredicate* predicate = &filter->predicates[condition->position];
+        predicate->condition = condition;
+        if (strcmp(condition->column, "id") == 0) {
+            predicate->slot = 0;
+        } else if (strcmp(condition->column, "username") == 0) {
+            predicate->slot = 1;
+        } else if (strcmp(condition->column, "email") == 0) {
+            predicate->slot = 2;
+        } else {
+            predicate->slot = column_slot(table_name, condition->column);
+        }
+        predicate->numeric = strcmp(condition->column, "id") == 0;
+        predicate->lower = strtoll(condition->value, NULL, 10);
+        predicate->upper = condition->value2 ? strtoll(condition->value2, NULL, 10) : 0;
+    }
+    return filter;
+}
+
+static bool cell_filter_matches(const CellFilter* filter, const void* cell) {
+    return !filter || where_node_matches_cell(filter->tree, filter, cell);
+}
+
+static void cell_filter_free(CellFilter* filter) {
+    if (filter) {
+        free(filter->predicates);
+        free(filter);
+    }
+}
+
+// Print a result row: every column for SELECT *, otherwise the listed ones
+static void print_selected_row(ParsedStatement* stmt, const char* table_name, Row* row) {
+    if (stmt->num_select_columns == 0) {
+        printf("(%d, %s, %s)\n", row->id, row->username, row->email);
+        return;
+    }
+    
+    printf("(");
+    for (uint32_t i = 0; i < stmt->num_select_columns; i++) {
+        char value[COLUMN_EMAIL_SIZE];
+        if (!row_column_value(table_name, stmt->select_columns[i], row, value, sizeof(value))) {
+            strcpy(value, "NULL");
+        }
+        printf("%s%s", i > 0 ? ", " : "", value);
+    }
+    printf(")\n");
+}
+
+// Called for each row a SELECT produces; returning false stops the scan
+typedef bool (*SelectRowVisitor)(ParsedStatement* stmt, const char* table_name, Row* row,
+                                 void* context);
+
+/*
+ * Pass a row the access path produced to the visitor if it satisfies the
+ * WHERE clause (recheck is false when the path already decided it),
+ * counting both for EXPLAIN ANALYZE. False stops the scan.
+ */
+static bool emit_row(ParsedStatement* stmt, Table* table, QueryPlan* plan, Row* row,
+                     bool recheck, SelectRowVisitor visit, void* context) {
+    plan->rows_examined++;
+    if (recheck && !row_matches_where(stmt, table->name, row)) {
+        return true;
+    }
+    plan->rows_matched++;
+    return visit(stmt, table->name, row, context);
+}
+
+// Fetch a row by primary key; false if it is not in the table
+static bool fetch_row(Table* table, uint32_t key, Row* row) {
+    Cursor* cursor = table_find(table, key);
+    bool found = false;
+    if (!cursor->end_of_table) {
+        void* node = pager_get_page(table->pager, cursor->page_num);
+        if (cursor->cell_num < *leaf_node_num_cells(node) &&
+            *leaf_node_key(node, cursor->cell_num) == key) {
+            deserialize_row(cursor_value(cursor), row);
+            found = true;
+        }
+    }
+    free(cursor);
+    return found;
+}
+
+/*
+ * JOIN execution. Join values compare as strings, as each table's
+ * schema maps the join column onto a storage slot; the slots are
+ * resolved once per statement, not per row.
+ */
+typedef struct {
+    Row row;
+    uint32_t hash;
+    char value[COLUMN_EMAIL_SIZE];
+} JoinRow;
+
+typedef struct {
+    Table* table;
+    int slot;
+    JoinRow* rows;                // Loaded by hash and merge joins
+    uint32_t count;
+} JoinInput;
+
+static uint32_t join_value_hash(const char* value) {
+    uint32_t hash = 2166136261u;
+    for (; *value; value++) {
+        hash = (hash ^ (uint8_t)*value) * 16777619u;
+    }
+    return hash;
+}
+
+static void join_load(JoinInput* input) {
+    uint32_t capacity = input->table->header->row_count + 1;
+    input->rows = malloc(sizeof(JoinRow) * capacity);
+    input->count = 0;
+    
+    Cursor* cursor = table_start(input->table);
+    while (!cursor->end_of_table) {
+        if (input->count == capacity) {
+            capacity *= 2;
+            input->rows = realloc(input->rows, sizeof(JoinRow) * capacity);
+        }
+        JoinRow* join_row = &input->rows[input->count++];
+        deserialize_row(cursor_value(cursor), &join_row->row);
+        slot_value_as_string(input->slot, &join_row->row, join_row->value, sizeof(join_row->value));
+        join_row->hash = join_value_hash(join_row->value);
+        cursor_advance(cursor);
+    }
+    free(cursor);
+}
+
+// Print a joined pair, left table first; EXPLAIN ANALYZE only counts it
+static void emit_join_pair(ParsedStatement* stmt, QueryPlan* plan, Row* left_row, Row* right_row) {
+    plan->rows_matched++;
+    if (!plan->analyze) {
+        printf("%s: (%d, %s, %s) | %s: (%d, %s, %s)\n",
+               stmt->join_clause->left_table,
+               left_row->id, left_row->username, left_row->email,
+               stmt->join_clause->right_table,
+               right_row->id, right_row->username, right_row->email);
+    }
+}
+
+// An outer row and an inner candidate for it; the inner side is the left when join_left_inner
+static void join_check(ParsedStatement* stmt, QueryPlan* plan, const char* value, Row* outer_row,
+                       const char* inner_value, Row* inner_row) {
+    plan->rows_examined++;
+    if (strcmp(value, inner_value) != 0) {
+        return;
+    }
+    if (plan->join_left_inner) {
+        emit_join_pair(stmt, plan, inner_row, outer_row);
+    } else {
+        emit_join_pair(stmt, plan, outer_row, inner_row);
+    }
+}
+
+// Every left row against every right row, rescanning the right table
+static void join_nested_loop(ParsedStatement* stmt, QueryPlan* plan, JoinInput* left,
+                             JoinInput* right) {
+    OperatorProfile* join = profile_begin_scan(plan);
+    Cursor* left_cursor = table_start(left->table);
+    while (!left_cursor->end_of_table) {
+        Row left_row;
+        char left_value[COLUMN_EMAIL_SIZE];
+        deserialize_row(cursor_value(left_cursor), &left_row);
+        slot_value_as_string(left->slot, &left_row, left_value, sizeof(left_value));
+        
+        Cursor* right_cursor = table_start(right->table);
+        while (!right_cursor->end_of_table) {
+            Row right_row;
+            char right_value[COLUMN_EMAIL_SIZE];
+            deserialize_row(cursor_value(right_cursor), &right_row);
+            slot_value_as_string(right->slot, &right_row, right_value, sizeof(right_value));
+            join_check(stmt, plan, left_value, &left_row, right_value, &right_row);
+            cursor_advance(right_cursor);
+        }
+        free(right_cursor);
+        
+        cursor_advance(left_cursor);
+    }
+    free(left_cursor);
+    profile_end(join, plan->rows_matched, plan->rows_examined - plan->rows_matched);
+}
+
+/*
+ * Each outer row probes the inner table: its secondary index on the join
+ * column when the plan has one, otherwise its primary key. Index keys
+ * are truncated, so every row found is compared in full.
+ */
+static void join_index_nested_loop(ParsedStatement* stmt, QueryPlan* plan, JoinInput* outer,
+                                   JoinInput* inner) {
+    OperatorProfile* join = profile_begin_scan(plan);
+    Cursor* cursor = table_start(outer->table);
+    while (!cursor->end_of_table) {
+        Row outer_row;
+        Row inner_row;
+        char value[COLUMN_EMAIL_SIZE];
+        char inner_value[COLUMN_EMAIL_SIZE];
+        deserialize_row(cursor_value(cursor), &outer_row);
+        slot_value_as_string(outer->slot, &outer_row, value, sizeof(value));
+        
+        if (plan->secondary_index) {
+            uint32_t count = 0;
+            uint32_t* ids = secondary_index_lookup(plan->secondary_index, value, &count);
+            for (uint32_t i = 0; i < count; i++) {
+                if (fetch_row(inner->table, ids[i], &inner_row)) {
+                    slot_value_as_string(inner->slot, &inner_row, inner_value, sizeof(inner_value));
+                    join_check(stmt, plan, value, &outer_row, inner_value, &inner_row);
+                }
+            }
+            free(ids);
+        } else {
+            // Only digit strings can equal a formatted id
+            char* end;
+            unsigned long key = strtoul(value, &end, 10);
+            if (value[0] >= '0' && value[0] <= '9' && *end == '\0' && key <= UINT32_MAX &&
+                fetch_row(inner->table, (uint32_t)key, &inner_row)) {
+                slot_value_as_string(inner->slot, &inner_row, inner_value, sizeof(inner_value));
+                join_check(stmt, plan, value, &outer_row, inner_value, &inner_row);
+            }
+        }
+        cursor_advance(cursor);
+    }
+    free(cursor);
+    profile_end(join, plan->rows_matched, plan->rows_examined - plan->rows_matched);
+}
+
+// Hash the build table's rows by join value, then look up each row of the probe table
+static void join_hash(ParsedStatement* stmt, QueryPlan* plan, JoinInput* build, JoinInput* probe) {
+    char name[64];
+    snprintf(name, sizeof(name), "HASH on %.48s", build->table->name);
+    OperatorProfile* hash = profile_begin(plan, name, build->table->header->row_count);
+    join_load(build);
+    uint32_t num_buckets = 1;
+    while (num_buckets < build->count * 2) {
+        num_buckets <<= 1;
+    }
+    uint32_t* buckets = malloc(sizeof(uint32_t) * num_buckets);
+    uint32_t* next = malloc(sizeof(uint32_t) * (build->count + 1));
+    memset(buckets, 0xFF, sizeof(uint32_t) * num_buckets);
+    for (uint32_t i = build->count; i-- > 0;) {
+        // Pushed in reverse, so each chain lists rows in table order
+        uint32_t bucket = build->rows[i].hash & (num_buckets - 1);
+        next[i] = buckets[bucket];
+        buckets[bucket] = i;
+    }
+    profile_end(hash, build->count, 0);
+    
+    OperatorProfile* join = profile_begin_scan(plan);
+    Cursor* cursor = table_start(probe->table);
+    while (!cursor->end_of_table) {
+        Row row;
+        char value[COLUMN_EMAIL_SIZE];
+        deserialize_row(cursor_value(cursor), &row);
+        slot_value_as_string(probe->slot, &row, value, sizeof(value));
+        uint32_t value_hash = join_value_hash(value);
+        for (uint32_t i = buckets[value_hash & (num_buckets - 1)]; i != UINT32_MAX; i = next[i]) {
+            if (build->rows[i].hash == value_hash) {
+                join_check(stmt, plan, value, &row, build->rows[i].value, &build->rows[i].row);
+            }
+        }
+        cursor_advance(cursor);
+    }
+    free(cursor);
+    profile_end(join, plan->rows_matched, plan->rows_examined - plan->rows_matched);
+    free(buckets);
+    free(next);
+}
+
+static bool join_keys_numeric;  // Merge order of the join in progress: by id, or by value
+
+static int compare_join_rows(const void* a, const void* b) {
+    const JoinRow* left = a;
+    const JoinRow* right = b;
+    if (join_keys_numeric) {
+        return (left->row.id > right->row.id) - (left->row.id < right->row.id);
+    }
+    return strcmp(left->value, right->value);
+}
+
+/*
+ * Both tables in join value order, merged; each run of equal values on
+ * one side pairs with the run on the other. Tables joined on their
+ * primary keys are read in id order and need no sort.
+ */
+static void join_merge(ParsedStatement* stmt, QueryPlan* plan, JoinInput* left, JoinInput* right) {
+    join_keys_numeric = left->slot == 0 && right->slot == 0;
+    char name[64];
+    snprintf(name, sizeof(name), "%s on %.24s, %.24s", join_keys_numeric ? "SCAN" : "SORT",
+             left->table->name, right->table->name);
+    OperatorProfile* sort = profile_begin(plan, name, PROFILE_NO_ESTIMATE);
+    join_load(left);
+    join_load(right);
+    if (!join_keys_numeric) {
+        qsort(left->rows, left->count, sizeof(JoinRow), compare_join_rows);
+        qsort(right->rows, right->count, sizeof(JoinRow), compare_join_rows);
+    }
+    profile_end(sort, left->count + right->count, 0);
+    
+    OperatorProfile* join = profile_begin_scan(plan);
+    uint32_t i = 0;
+    uint32_t j = 0;
+    while (i < left->count && j < right->count) {
+        int cmp = compare_join_rows(&left->rows[i], &right->rows[j]);
+        if (cmp < 0) {
+            i++;
+        } else if (cmp > 0) {
+            j++;
+        } else {
+            uint32_t left_end = i + 1;
+            while (left_end < left->count && compare_join_rows(&left->rows[left_end], &left->rows[i]) == 0) {
+                left_end++;
+            }
+            uint32_t right_end = j + 1;
+            while (right_end < right->count &&
+                   compare_join_rows(&right->rows[right_end], &right->rows[j]) == 0) {
+                right_end++;
+            }
+            for (uint32_t l = i; l < left_end; l++) {
+                for (uint32_t r = j; r < right_end; r++) {
+                    plan->rows_examined++;
+                    emit_join_pair(stmt, plan, &left->rows[l].row, &right->rows[r].row);
+                }
+            }
+            i = left_end;
+            j = right_end;
+        }
+    }
+    profile_end(join, plan->rows_matched, plan->rows_examined - plan->rows_matched);
+}
+
+// Open every table of a multi-way JOIN, by position; false after printing why one is unusable
+static bool resolve_join_tables(ParsedStatement* stmt, Table** tables) {
+    for (uint32_t i = 0; i < stmt->num_join_tables; i++) {
+        tables[i] = resolve_table(stmt->join_tables[i]);
+        if (!tables[i]) {
+            printf("Error: Unknown table '%s'\n", stmt->join_tables[i]);
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < stmt->num_join_clauses; i++) {
+        JoinClause* clause = &stmt->join_clause[i];
+        if (clause->left_position < 0 || clause->right_position < 0) {
+            printf("Error: JOIN condition names table '%s', which the query does not join\n",
+                   clause->left_position < 0 ? clause->left_table : clause->right_table);
+            return false;
+        }
+        if (clause->left_position == clause->right_position) {
+            printf("Error: JOIN condition must compare two different tables\n");
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Multi-way joins follow the plan's left-deep tree. The rows joined so
+ * far are tuples of one Row per join table, by position, held in memory;
+ * each step joins them with one more table, checking every ON equality
+ * between that table and those already joined.
+ */
+typedef struct {
+    Row* rows;                    // count tuples of width rows each
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t width;
+} JoinRelation;
+
+// An ON equality between the table a step adds and one already joined
+typedef struct {
+    uint32_t outer_position;
+    int outer_slot;
+    int inner_slot;
+} JoinLink;
+
+// A tuple extended with the row of the table at `position`
+static void join_relation_add(JoinRelation* relation, const Row* tuple, uint32_t position,
+                              const Row* row) {
+    if (relation->count == relation->capacity) {
+        relation->capacity = relation->capacity ? relation->capacity * 2 : 64;
+        relation->rows = realloc(relation->rows,
+                                 sizeof(Row) * relation->width * relation->capacity);
+    }
+    Row* added = &relation->rows[(size_t)relation->count++ * relation->width];
+    if (tuple) {
+        memcpy(added, tuple, sizeof(Row) * relation->width);
+    }
+    added[position] = *row;
+}
+
+// Add ON clause i as a link if it compares the step's table with one in `joined`
+static bool join_step_link(ParsedStatement* stmt, const JoinStep* step, uint32_t joined, int i,
+                           JoinLink* links, uint32_t* num_links) {
+    JoinClause* clause = &stmt->join_clause[i];
+    bool inner_left = clause->left_position == (int)step->table &&
+                      (joined & (1u << clause->right_position));
+    bool inner_right = clause->right_position == (int)step->table &&
+                       (joined & (1u << clause->left_position));
+    if (!inner_left && !inner_right) {
+        return true;
+    }
+    JoinLink* link = &links[(*num_links)++];
+    link->outer_position = inner_left ? clause->right_position : clause->left_position;
+    link->outer_slot = column_slot(stmt->join_tables[link->outer_position],
+                                   inner_left ? clause->right_column : clause->left_column);
+    link->inner_slot = column_slot(stmt->join_tables[step->table],
+                                   inner_left ? clause->left_column : clause->right_column);
+    return link->outer_slot >= 0 && link->inner_slot >= 0;
+}
+
+/*
+ * The equalities linking the step's table to the tables in `joined`, the
+ * one that drives the step first. False if a column is not in its
+ * table's schema, as such an equality matches nothing.
+ */
+static bool join_step_links(ParsedStatement* stmt, const JoinStep* step, uint32_t joined,
+                            JoinLink* links, uint32_t* num_links) {
+    *num_links = 0;
+    if (step->clause >= 0 && !join_step_link(stmt, step, joined, step->clause, links, num_links)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < stmt->num_join_clauses; i++) {
+        if ((int)i != step->clause &&
+            !join_step_link(stmt, step, joined, (int)i, links, num_links)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool join_links_match(const JoinLink* links, uint32_t num_links, const Row* tuple,
+                             Row* row) {
+    for (uint32_t i = 0; i < num_links; i++) {
+        char outer_value[COLUMN_EMAIL_SIZE];
+        char inner_value[COLUMN_EMAIL_SIZE];
+        slot_value_as_string(links[i].outer_slot, (Row*)&tuple[links[i].outer_position],
+                             outer_value, sizeof(outer_value));
+        slot_value_as_string(links[i].inner_slot, row, inner_value, sizeof(inner_value));
+        if (strcmp(outer_value, inner_value) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Chain `count` hashes into power-of-two buckets; returns the bucket mask
+static uint32_t join_buckets(const uint32_t* hashes, uint32_t count, uint32_t** buckets,
+                             uint32_t** next) {
+    uint32_t num_buckets = 1;
+    while (num_buckets < count * 2) {
+        num_buckets <<= 1;
+    }
+    *buckets = malloc(sizeof(uint32_t) * num_buckets);
+    *next = malloc(sizeof(uint32_t) * (count + 1));
+    memset(*buckets, 0xFF, sizeof(uint32_t) * num_buckets);
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t bucket = hashes[i] & (num_buckets - 1);
+        (*next)[i] = (*buckets)[bucket];
+        (*buckets)[bucket] = i;
+    }
+    return num_buckets - 1;
+}
+
+static void join_tree_step(ParsedStatement* stmt, QueryPlan* plan, const JoinStep* step,
+                           Table* table, uint32_t joined, JoinRelation* outer,
+                           JoinRelation* result) {
+    JoinLink* links = malloc(sizeof(JoinLink) * stmt->num_join_clauses);
+    uint32_t num_links;
+    if (!join_step_links(stmt, step, joined, links, &num_links)) {
+        free(links);
+        return;
+    }
+    uint32_t width = outer->width;
+    Row row;
+    char value[COLUMN_EMAIL_SIZE];
+    
+    if (step->method == SCAN_INDEX_NESTED_LOOP) {
+        // Probe by the driving equality's value; index keys are truncated, so recheck all
+        for (uint32_t t = 0; t < outer->count; t++) {
+            Row* tuple = &outer->rows[(size_t)t * width];
+            slot_value_as_string(links[0].outer_slot, &tuple[links[0].outer_position], value,
+                                 sizeof(value));
+            if (step->index) {
+                uint32_t count = 0;
+                uint32_t* ids = secondary_index_lookup(step->index, value, &count);
+                for (uint32_t i = 0; i < count; i++) {
+                    if (fetch_row(table, ids[i], &row)) {
+                        plan->rows_examined++;
+                        if (join_links_match(links, num_links, tuple, &row)) {
+                            join_relation_add(result, tuple, step->table, &row);
+                        }
+                    }
+                }
+                free(ids);
+                continue;
+            }
+            char* end;
+            unsigned long key = strtoul(value, &end, 10);
+            if (value[0] >= '0' && value[0] <= '9' && *end == '\0' && key <= UINT32_MAX &&
+                fetch_row(table, (uint32_t)key, &row)) {
+                plan->rows_examined++;
+                if (join_links_match(links, num_links, tuple, &row)) {
+                    join_relation_add(result, tuple, step->table, &row);
+                }
+            }
+        }
+    } else if (step->method == SCAN_HASH_JOIN && !step->build_outer) {
+        JoinInput build = {table, links[0].inner_slot, NULL, 0};
+        join_load(&build);
+        uint32_t* hashes = malloc(sizeof(uint32_t) * (build.count + 1));
+        for (uint32_t i = 0; i < build.count; i++) {
+            hashes[i] = build.rows[i].hash;
+        }
+        uint32_t* buckets;
+        uint32_t* next;
+        uint32_t mask = join_buckets(hashes, build.count, &buckets, &next);
+        for (uint32_t t = 0; t < outer->count; t++) {
+            Row* tuple = &outer->rows[(size_t)t * width];
+            slot_value_as_string(links[0].outer_slot, &tuple[links[0].outer_position], value,
+                                 sizeof(value));
+            uint32_t value_hash = join_value_hash(value);
+            for (uint32_t i = buckets[value_hash & mask]; i != UINT32_MAX; i = next[i]) {
+                if (hashes[i] == value_hash) {
+                    plan->rows_examined++;
+                    if (join_links_match(links, num_links, tuple, &build.rows[i].row)) {
+                        join_relation_add(result, tuple, step->table, &build.rows[i].row);
+                    }
+                }
+            }
+        }
+        free(hashes);
+        free(buckets);
+        free(next);
+        free(build.rows);
+    } else if (step->method == SCAN_HASH_JOIN) {
+        // The rows so far are hashed and the table streams past them
+        uint32_t* hashes = malloc(sizeof(uint32_t) * (outer->count + 1));
+        for (uint32_t t = 0; t < outer->count; t++) {
+            Row* tuple = &outer->rows[(size_t)t * width];
+            slot_value_as_string(links[0].outer_slot, &tuple[links[0].outer_position], value,
+                                 sizeof(value));
+            hashes[t] = join_value_hash(value);
+        }
+        uint32_t* buckets;
+        uint32_t* next;
+        uint32_t mask = join_buckets(hashes, outer->count, &buckets, &next);
+        Cursor* cursor = table_start(table);
+        while (!cursor->end_of_table) {
+            deserialize_row(cursor_value(cursor), &row);
+            slot_value_as_string(links[0].inner_slot, &row, value, sizeof(value));
+            uint32_t value_hash = join_value_hash(value);
+            for (uint32_t t = buckets[value_hash & mask]; t != UINT32_MAX; t = next[t]) {
+                Row* tuple = &outer->rows[(size_t)t * width];
+                if (hashes[t] == value_hash) {
+                    plan->rows_examined++;
+                    if (join_links_match(links, num_links, tuple, &row)) {
+                        join_relation_add(result, tuple, step->table, &row);
+                    }
+                }
+            }
+            cursor_advance(cursor);
+        }
+        free(cursor);
+        free(hashes);
+        free(buckets);
+        free(next);
+    } else {
+        for (uint32_t t = 0; t < outer->count; t++) {
+            Row* tuple = &outer->rows[(size_t)t * width];
+            Cursor* cursor = table_start(table);
+            while (!cursor->end_of_table) {
+                deserialize_row(cursor_value(cursor), &row);
+                plan->rows_examined++;
+                if (join_links_match(links, num_links, tuple, &row)) {
+                    join_relation_add(result, tuple, step->table, &row);
+                }
+                cursor_advance(cursor);
+            }
+            free(cursor);
+        }
+    }
+    free(links);
+}
+
+// Print a joined tuple in FROM / JOIN order; EXPLAIN ANALYZE only counts it
+static void emit_join_tuple(ParsedStatement* stmt, QueryPlan* plan, const Row* tuple) {
+    plan->rows_matched++;
+    if (plan->analyze) {
+        return;
+    }
+    for (uint32_t i = 0; i < stmt->num_join_tables; i++) {
+        printf("%s%s: (%d, %s, %s)", i ? " | " : "", stmt->join_tables[i], tuple[i].id,
+               tuple[i].username, tuple[i].email);
+    }
+    printf("\n");
+}
+
+static ExecuteResult execute_join_tree(ParsedStatement* stmt, QueryPlan* plan,
+                                       uint32_t* rows_returned_out) {
+    Table* tables[MAX_JOIN_TABLES];
+    if (!resolve_join_tables(stmt, tables)) {
+        return EXECUTE_NOT_FOUND;
+    }
+    
+    printf("Performing INNER JOIN of");
+    for (uint32_t i = 0; i < plan->num_join_steps; i++) {
+        printf("%s %s", i ? "," : "", stmt->join_tables[plan->join_steps[i].table]);
+    }
+    printf("\n");
+    
+    JoinRelation current = {NULL, 0, 0, stmt->num_join_tables};
+    uint32_t joined = 0;
+    for (uint32_t k = 0; k < plan->num_join_steps; k++) {
+        const JoinStep* step = &plan->join_steps[k];
+        Table* table = tables[step->table];
+        char name[64];
+        snprintf(name, sizeof(name), "%s %.32s",
+                 step->method == SCAN_HASH_JOIN ? "HASH JOIN" :
+                 step->method == SCAN_INDEX_NESTED_LOOP ? "INDEX NESTED LOOP JOIN" :
+                 step->method == SCAN_NESTED_LOOP ? "NESTED LOOP JOIN" : "SCAN", table->name);
+        OperatorProfile* op = profile_begin(plan, name, step->estimated_rows);
+        uint64_t examined = plan->rows_examined;
+        JoinRelation next = {NULL, 0, 0, stmt->num_join_tables};
+        
+        if (k == 0) {
+            Row row;
+            Cursor* cursor = table_start(table);
+            while (!cursor->end_of_table) {
+                deserialize_row(cursor_value(cursor), &row);
+                plan->rows_examined++;
+                join_relation_add(&next, NULL, step->table, &row);
+                cursor_advance(cursor);
+            }
+            free(cursor);
+        } else {
+            join_tree_step(stmt, plan, step, table, joined, &current, &next);
+        }
+        
+        profile_end(op, next.count, plan->rows_examined - examined - next.count);
+        free(current.rows);
+        current = next;
+        joined |= 1u << step->table;
+    }
+    
+    for (uint32_t t = 0; t < current.count; t++) {
+        emit_join_tuple(stmt, plan, &current.rows[(size_t)t * current.width]);
+    }
+    free(current.rows);
+    
+    if (rows_returned_out) {
+        *rows_returned_out = plan->rows_matched;
+    }
+    return EXECUTE_SUCCESS;
+}
+
+ExecuteResult execute_join(ParsedStatement* stmt, QueryPlan* plan, uint32_t* rows_returned_out) {
+    if (!stmt->has_join) {
+        return EXECUTE_SUCCESS;
+    }
+    if (!join_is_pairwise(stmt)) {
+        return execute_join_tree(stmt, plan, rows_returned_out);
+    }
+    
+    // Open both tables
+    JoinInput left = {resolve_table(stmt->join_clause->left_table),
+                      column_slot(stmt->join_clause->left_table, stmt->join_clause->left_column),
+                      NULL, 0};
+    JoinInput right = {resolve_table(stmt->join_clause->right_table),
+                       column_slot(stmt->join_clause->right_table, stmt->join_clause->right_column),
+                       NULL, 0};
+    
+    if (!left.table || !right.table) {
+        printf("Error: Could not open tables for JOIN\n");
+        return EXECUTE_NOT_FOUND;
+    }
+    
+    printf("Performing INNER JOIN on %s.%s = %s.%s\n",
+           stmt->join_clause->left_table, stmt->join_clause->left_column,
+           stmt->join_clause->right_table, stmt->join_clause->right_column);
+    
+    // A join column the schema does not name matches nothing
+    if (left.slot >= 0 && right.slot >= 0) {
+        switch (plan->scan_type) {
+            case SCAN_INDEX_NESTED_LOOP:
+                if (plan->join_left_inner) {
+                    join_index_nested_loop(stmt, plan, &right, &left);
+                } else {
+                    join_index_nested_loop(stmt, plan, &left, &right);
+                }
+                break;
+            case SCAN_HASH_JOIN:
+                if (plan->join_left_inner) {
+                    join_hash(stmt, plan, &left, &right);
+                } else {
+                    join_hash(stmt, plan, &right, &left);
+                }
+                break;
+            case SCAN_MERGE_JOIN:
+                join_merge(stmt, plan, &left, &right);
+                break;
+            default:
+                join_nested_loop(stmt, plan, &left, &right);
+                break;
         }
     }
+    free(left.rows);
+    free(right.rows);
     
-    // Log to WAL
-    if (table->wal) {
-        void* page = pager_get_page(table->pager, cursor->page_num);
-        wal_write_frame(table->wal, cursor->page_num, page, table->pager->num_pages);
+    if (rows_returned_out) {
+        *rows_returned_out = plan->rows_matched;
     }
     
-    free(cursor);
     return EXECUTE_SUCCESS;
 }
 
-ExecuteResult execute_create_table(ParsedStatement* stmt) {
-    if (!global_schema) {
-        global_schema = schema_create();
-    }
+/*
+ * Stream a secondary index range. Covered rows come from the index
+ * itself unless the stored key was truncated; the rest are fetched by
+ * id. The index range is inclusive and compares stored keys, so every
+ * row is rechecked against the WHERE clause.
+ */
+static void select_index_range(ParsedStatement* stmt, Table* table, QueryPlan* plan,
+                               SelectRowVisitor visit, void* context) {
+    IndexRange range;
+    condition_index_range(plan->condition, &range);
     
-    if (schema_add_table(global_schema, stmt->table_name, 
-                         stmt->columns, stmt->num_columns)) {
-        // Open (and thereby create) the physical backing file for this
-        // table, and make it the active table for subsequent statements
-        // that don't specify a FROM/table target.
-        Table* t = table_manager_open(table_manager, stmt->table_name);
-        if (!t) {
-            return EXECUTE_TABLE_FULL;
+    IndexCursor* cursor = secondary_index_seek(plan->secondary_index, &range);
+    while (!cursor->end_of_index) {
+        IndexEntry* entry = index_cursor_entry(cursor);
+        Row row;
+        bool have_row = true;
+        if (plan->scan_type == SCAN_INDEX_ONLY && !index_key_is_truncated(entry)) {
+            index_cursor_row(cursor, &row);
+        } else {
+            have_row = fetch_row(table, entry->primary_key, &row);
         }
-        strncpy(current_table_name, stmt->table_name, sizeof(current_table_name) - 1);
-        current_table_name[sizeof(current_table_name) - 1] = '\0';
-        
-        // Persist the schema so table structure survives a restart.
-        schema_save(global_schema, current_db_filename);
         
-        printf("Table '%s' created successfully.\n", stmt->table_name);
-        return EXECUTE_SUCCESS;
-    } else {
-        return EXECUTE_TABLE_FULL;
+        if (have_row && !emit_row(stmt, table, plan, &row, true, visit, context)) {
+            break;
+        }
+        index_cursor_advance(cursor);
     }
+    free(cursor);
 }
 
 /*
- * Physical storage always has exactly 3 slots per row: id (uint32),
- * and two string slots (historically called "username"/"email").
- * A table's declared schema maps logical column names onto these slots
- * by position (column 0 -> id, column 1 -> slot 1, column 2 -> slot 2).
- * This looks up a column's value for a given row as a string, so join
- * and where-clause comparisons work regardless of what the column is
- * actually called in the schema (e.g. "user_id" instead of "username").
+ * The ids the plan's bitmap conditions allow: the AND or OR of one
+ * bitmap per condition, computed container by container without
+ * reading a row. A value with no rows makes an AND empty.
  */
-static bool get_column_value_as_string(const char* table_name, const char* column_name,
-                                        Row* row, char* out, size_t out_size) {
-    if (!global_schema) {
-        return false;
-    }
-    TableSchema* schema = schema_get_table(global_schema, table_name);
-    if (!schema) {
-        return false;
-    }
-    for (uint32_t i = 0; i < schema->num_columns; i++) {
-        if (strcmp(schema->columns[i].name, column_name) == 0) {
-            switch (i) {
-                case 0:
-                    snprintf(out, out_size, "%u", row->id);
-                    return true;
-                case 1:
-                    strncpy(out, row->username, out_size - 1);
-                    out[out_size - 1] = '\0';
-                    return true;
-                case 2:
-                    strncpy(out, row->email, out_size - 1);
-                    out[out_size - 1] = '\0';
-                    return true;
-                default:
-                    return false; // only 3 physical columns are supported
+static RoaringBitmap* select_bitmap_ids(ParsedStatement* stmt, QueryPlan* plan) {
+    RoaringBitmap* result = NULL;
+    uint32_t i = 0;
+    for (Condition* condition = stmt->where_clause; condition; condition = condition->next, i++) {
+        if (!plan->condition_bitmaps[i]) {
+            continue;
+        }
+        
+        const RoaringBitmap* ids = bitmap_index_get(plan->condition_bitmaps[i], condition->value);
+        RoaringBitmap* combined;
+        if (!ids) {
+            if (stmt->where_is_or) {
+                continue;
             }
+            combined = roaring_create();
+        } else if (!result) {
+            combined = roaring_copy(ids);
+        } else {
+            combined = stmt->where_is_or ? roaring_or(result, ids) : roaring_and(result, ids);
         }
+        roaring_free(result);
+        result = combined;
     }
-    return false;
+    return result ? result : roaring_create();
 }
 
-ExecuteResult execute_join(ParsedStatement* stmt, uint32_t* rows_returned_out) {
-    if (!stmt->has_join) {
-        return EXECUTE_SUCCESS;
-    }
-    
-    // Open both tables
-    Table* left_table = table_manager_get(table_manager, stmt->join_clause->left_table);
-    Table* right_table = table_manager_get(table_manager, stmt->join_clause->right_table);
-    
-    if (!left_table) {
-        left_table = table_manager_open(table_manager, stmt->join_clause->left_table);
-    }
-    if (!right_table) {
-        right_table = table_manager_open(table_manager, stmt->join_clause->right_table);
-    }
+/*
+ * Walk the table's leaves from the lower id bound of the plan's range
+ * condition, stopping past the upper one; rows arrive in id order and
+ * the WHERE clause is checked on each leaf cell
+ */
+static void select_primary_range(ParsedStatement* stmt, Table* table, QueryPlan* plan,
+                                 SelectRowVisitor visit, void* context) {
+    uint32_t lower, upper;
+    condition_id_range(plan->condition, &lower, &upper);
     
-    if (!left_table || !right_table) {
-        printf("Error: Could not open tables for JOIN\n");
-        return EXECUTE_NOT_FOUND;
+    CellFilter* filter = cell_filter_create(stmt, table->name);
+    Cursor* cursor = table_seek(table, lower);
+    while (!cursor->end_of_table) {
+        Row row;
+        void* cell = cursor_value(cursor);
+        uint32_t id;
+        memcpy(&id, cell, ID_SIZE);
+        if (id > upper) {
+            break;
+        }
+        if (!cell_filter_matches(filter, cell)) {
+            plan->rows_examined++;
+        } else {
+            deserialize_row(cell, &row);
+            if (!emit_row(stmt, table, plan, &row, false, visit, context)) {
+                break;
+            }
+        }
+        cursor_advance(cursor);
     }
+    free(cursor);
+    cell_filter_free(filter);
+}
+
+// Produce the rows matching the WHERE clause along the plan's access path
+static void select_rows(ParsedStatement* stmt, Table* table, QueryPlan* plan,
+                        SelectRowVisitor visit, void* context) {
+    Row row;
     
-    printf("Performing INNER JOIN on %s.%s = %s.%s\n", 
-           stmt->join_clause->left_table, stmt->join_clause->left_column,
-           stmt->join_clause->right_table, stmt->join_clause->right_column);
-    
-    uint32_t matches = 0;
-    
-    // Nested loop join (simple implementation)
-    Cursor* left_cursor = table_start(left_table);
-    while (!left_cursor->end_of_table) {
-        Row left_row;
-        deserialize_row(cursor_value(left_cursor), &left_row);
+    if (plan->secondary_index && plan->is_range) {
+        printf("Using %s on %s\n", plan->scan_type == SCAN_INDEX_ONLY ?
+               "index-only range scan" : "secondary index range scan", plan->index_column);
+        select_index_range(stmt, table, plan, visit, context);
+    } else if (plan->is_range) {
+        printf("Using primary key range scan on id\n");
+        select_primary_range(stmt, table, plan, visit, context);
+    } else if (plan->scan_type == SCAN_BITMAP) {
+        printf("Using bitmap index on %s\n", plan->index_column);
         
-        Cursor* right_cursor = table_start(right_table);
-        while (!right_cursor->end_of_table) {
-            Row right_row;
-            deserialize_row(cursor_value(right_cursor), &right_row);
-            
-            // Compare join columns generically using each table's schema
-            char left_val[COLUMN_EMAIL_SIZE];
-            char right_val[COLUMN_EMAIL_SIZE];
-            bool match = false;
-            if (get_column_value_as_string(stmt->join_clause->left_table, stmt->join_clause->left_column, &left_row, left_val, sizeof(left_val)) &&
-                get_column_value_as_string(stmt->join_clause->right_table, stmt->join_clause->right_column, &right_row, right_val, sizeof(right_val))) {
-                match = (strcmp(left_val, right_val) == 0);
+        RoaringBitmap* bitmap = select_bitmap_ids(stmt, plan);
+        uint32_t count = 0;
+        uint32_t* ids = roaring_to_array(bitmap, &count);
+        roaring_free(bitmap);
+        for (uint32_t i = 0; i < count; i++) {
+            if (plan->bitmap_ids_only) {
+                memset(&row, 0, sizeof(Row));
+                row.id = ids[i];
+            } else if (!fetch_row(table, ids[i], &row)) {
+                continue;
             }
-            
-            if (match) {
-                printf("%s: (%d, %s, %s) | %s: (%d, %s, %s)\n",
-                       stmt->join_clause->left_table,
-                       left_row.id, left_row.username, left_row.email,
-                       stmt->join_clause->right_table,
-                       right_row.id, right_row.username, right_row.email);
-                matches++;
+            if (!emit_row(stmt, table, plan, &row, !plan->bitmap_exact, visit, context)) {
+                break;
             }
-            
-            cursor_advance(right_cursor);
         }
-        free(right_cursor);
+        free(ids);
+    } else if (plan->secondary_index && plan->scan_type == SCAN_INDEX_ONLY) {
+        printf("Using index-only scan on %s\n", plan->index_column);
         
-        cursor_advance(left_cursor);
+        // Rows rebuilt from the index; the table is never read. Conditions
+        // after the first are on covered columns and checked here.
+        uint32_t count = 0;
+        Row* rows = secondary_index_lookup_rows(plan->secondary_index, plan->condition->value,
+                                                &count);
+        for (uint32_t i = 0; i < count; i++) {
+            if (!emit_row(stmt, table, plan, &rows[i], true, visit, context)) {
+                break;
+            }
+        }
+        free(rows);
+    } else if (plan->secondary_index) {
+        printf("Using secondary %sindex on %s\n",
+               plan->secondary_index->type == INDEX_TYPE_HASH ? "hash " : "",
+               plan->index_column);
+        
+        uint32_t count = 0;
+        uint32_t* primary_keys = secondary_index_lookup(plan->secondary_index,
+                                                        plan->condition->value, &count);
+        for (uint32_t i = 0; i < count; i++) {
+            // Recheck: stored keys are truncated
+            if (fetch_row(table, primary_keys[i], &row) &&
+                !emit_row(stmt, table, plan, &row, true, visit, context)) {
+                break;
+            }
+        }
+        free(primary_keys);
+    } else if (plan->scan_type == SCAN_INDEX_SEARCH) {
+        // WHERE id = value [AND ...]
+        if (fetch_row(table, atoi(plan->condition->value), &row)) {
+            emit_row(stmt, table, plan, &row, true, visit, context);
+        }
+    } else {
+        // The WHERE clause runs on each leaf cell; only matching rows are copied out
+        CellFilter* filter = cell_filter_create(stmt, table->name);
+        Cursor* cursor = table_start(table);
+        while (!cursor->end_of_table) {
+            void* cell = cursor_value(cursor);
+            if (!cell_filter_matches(filter, cell)) {
+                plan->rows_examined++;
+            } else {
+                deserialize_row(cell, &row);
+                if (!emit_row(stmt, table, plan, &row, false, visit, context)) {
+                    break;
+                }
+            }
+            cursor_advance(cursor);
+        }
+        free(cursor);
+        cell_filter_free(filter);
     }
-    free(left_cursor);
+}
+
+typedef struct {
+    uint32_t count;
+    uint64_t sum;
+    uint32_t max_val;
+    uint32_t min_val;
+} SelectAggregate;
+
+static bool aggregate_row(ParsedStatement* stmt, const char* table_name, Row* row, void* context) {
+    SelectAggregate* agg = context;
+    (void)table_name;
     
-    if (rows_returned_out) {
-        *rows_returned_out = matches;
+    agg->count++;
+    if (strcmp(stmt->agg_column, "id") == 0 || strcmp(stmt->agg_column, "*") == 0) {
+        agg->sum += row->id;
+        if (row->id > agg->max_val) agg->max_val = row->id;
+        if (row->id < agg->min_val) agg->min_val = row->id;
     }
+    return true;
+}
+
+// Rows of a SELECT on their way out: buffered for ORDER BY, else printed
+typedef struct {
+    Row* rows;
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t returned;
+    bool sorted;       // Rows already arrive in ORDER BY order
+    bool discard;      // EXPLAIN ANALYZE: count rows without printing them
+} SelectOutput;
+
+static bool output_row(ParsedStatement* stmt, const char* table_name, Row* row, void* context) {
+    SelectOutput* out = context;
     
-    return EXECUTE_SUCCESS;
+    if (stmt->has_order_by && !out->sorted) {
+        if (out->count >= out->capacity) {
+            out->capacity = out->capacity ? out->capacity * 2 : 64;
+            out->rows = realloc(out->rows, sizeof(Row) * out->capacity);
+        }
+        out->rows[out->count++] = *row;
+        return true;
+    }
+    
+    if (!out->discard) {
+        print_selected_row(stmt, table_name, row);
+    }
+    out->returned++;
+    return !(stmt->has_limit && out->returned >= stmt->limit);
+}
+
+static ParsedStatement* order_by_stmt;  // ORDER BY of the sort in progress
+
+static int compare_order_by(const void* a, const void* b) {
+    const Row* left = a;
+    const Row* right = b;
+    int cmp = 0;
+    
+    if (strcmp(order_by_stmt->order_by_column, "id") == 0) {
+        cmp = (left->id > right->id) - (left->id < right->id);
+    } else if (strcmp(order_by_stmt->order_by_column, "username") == 0) {
+        cmp = strcmp(left->username, right->username);
+    } else if (strcmp(order_by_stmt->order_by_column, "email") == 0) {
+        cmp = strcmp(left->email, right->email);
+    }
+    return order_by_stmt->order_ascending ? cmp : -cmp;
 }
 
-ExecuteResult execute_select(ParsedStatement* stmt, Table* table, uint32_t* rows_returned_out) {
+ExecuteResult execute_select(ParsedStatement* stmt, Table* table, QueryPlan* plan,
+                             uint32_t* rows_returned_out) {
     if (stmt->has_join) {
-        return execute_join(stmt, rows_returned_out);
+        return execute_join(stmt, plan, rows_returned_out);
     }
 
     // If a FROM clause names a specific table (and it's not a join),
@@ -407,72 +1527,75 @@ ExecuteResult execute_select(ParsedStatement* stmt, Table* table, uint32_t* rows
         }
         table = named_table;
     }
-
-    Cursor* cursor = NULL;
-    Row row;
-    uint32_t rows_returned = 0;
+    
+    for (uint32_t i = 0; i < stmt->num_select_columns; i++) {
+        Row probe;
+        char value[COLUMN_EMAIL_SIZE];
+        memset(&probe, 0, sizeof(Row));
+        if (!row_column_value(table->name, stmt->select_columns[i], &probe, value, sizeof(value))) {
+            printf("Error: Unknown column '%s'\n", stmt->select_columns[i]);
+            return EXECUTE_NOT_FOUND;
+        }
+    }
 
     // Handle aggregations
     if (stmt->has_aggregation) {
-        uint32_t count = 0;
-        uint32_t sum = 0;
-        uint32_t max_val = 0;
-        uint32_t min_val = UINT32_MAX;
+        SelectAggregate agg = { 0, 0, 0, UINT32_MAX };
+        OperatorProfile* scan = profile_begin_scan(plan);
+        if (stmt->agg_type == AGG_COUNT && plan->scan_type == SCAN_BITMAP && plan->bitmap_exact) {
+            // Every row has every column, so any COUNT is the bitmap's cardinality
+            printf("Using bitmap index cardinality on %s\n", plan->index_column);
+            RoaringBitmap* bitmap = select_bitmap_ids(stmt, plan);
+            agg.count = (uint32_t)roaring_cardinality(bitmap);
+            plan->rows_examined = plan->rows_matched = agg.count;
+            roaring_free(bitmap);
+        } else if (plan->scan_type == SCAN_AGGREGATE_SUMMARY) {
+            // Kept by every insert and delete; one summary row stands in for the table
+            TableHeader* header = table->header;
+            agg.count = header->row_count;
+            agg.sum = header->id_sum;
+            agg.max_val = header->id_max;
+            agg.min_val = header->id_min;
+            plan->rows_examined = plan->rows_matched = 1;
+        } else {
+            select_rows(stmt, table, plan, aggregate_row, &agg);
+        }
+        profile_end(scan, plan->rows_examined, plan->rows_examined - plan->rows_matched);
         
-        cursor = table_start(table);
-        while (!cursor->end_of_table) {
-            deserialize_row(cursor_value(cursor), &row);
-            
-            bool include = true;
-            if (stmt->has_where) {
-                if (strcmp(stmt->where_clause->column, "id") == 0) {
-                    uint32_t target_id = atoi(stmt->where_clause->value);
-                    include = (row.id == target_id);
-                } else if (strcmp(stmt->where_clause->column, "username") == 0) {
-                    include = (strcmp(row.username, stmt->where_clause->value) == 0);
-                } else if (strcmp(stmt->where_clause->column, "email") == 0) {
-                    include = (strcmp(row.email, stmt->where_clause->value) == 0);
-                }
+        OperatorProfile* aggregate = profile_begin(plan, "AGGREGATE", 1);
+        profile_end(aggregate, 1, 0);
+        if (plan->analyze) {
+            if (rows_returned_out) {
+                *rows_returned_out = 1;
             }
-            
-            if (include) {
-                count++;
-                if (strcmp(stmt->agg_column, "id") == 0 || strcmp(stmt->agg_column, "*") == 0) {
-                    sum += row.id;
-                    if (row.id > max_val) max_val = row.id;
-                    if (row.id < min_val) min_val = row.id;
-                }
-            }
-            
-            cursor_advance(cursor);
+            return EXECUTE_SUCCESS;
         }
-        free(cursor);
         
         // Print result based on aggregation type
         switch (stmt->agg_type) {
             case AGG_COUNT:
-                printf("COUNT: %u\n", count);
+                printf("COUNT: %u\n", agg.count);
                 break;
             case AGG_SUM:
-                printf("SUM: %u\n", sum);
+                printf("SUM: %llu\n", (unsigned long long)agg.sum);
                 break;
             case AGG_AVG:
-                if (count > 0) {
-                    printf("AVG: %.2f\n", (float)sum / count);
+                if (agg.count > 0) {
+                    printf("AVG: %.2f\n", (double)agg.sum / agg.count);
                 } else {
                     printf("AVG: 0\n");
                 }
                 break;
             case AGG_MAX:
-                if (count > 0) {
-                    printf("MAX: %u\n", max_val);
+                if (agg.count > 0) {
+                    printf("MAX: %u\n", agg.max_val);
                 } else {
                     printf("MAX: NULL\n");
                 }
                 break;
             case AGG_MIN:
-                if (count > 0) {
-                    printf("MIN: %u\n", min_val);
+                if (agg.count > 0) {
+                    printf("MIN: %u\n", agg.min_val);
                 } else {
                     printf("MIN: NULL\n");
                 }
@@ -486,146 +1609,43 @@ ExecuteResult execute_select(ParsedStatement* stmt, Table* table, uint32_t* rows
         }
         return EXECUTE_SUCCESS;
     }
-
-    if (stmt->has_where && index_manager) {
-        SecondaryIndex* index = index_manager_get(index_manager, current_table_name, stmt->where_clause->column);
-        
-        if (index) {
-            printf("Using secondary index on %s\n", stmt->where_clause->column);
-            
-            uint32_t count = 0;
-            uint32_t* primary_keys = secondary_index_lookup(index, stmt->where_clause->value, &count);
-            
-            if (primary_keys) {
-                for (uint32_t i = 0; i < count; i++) {
-                    cursor = table_find(table, primary_keys[i]);
-                    if (!cursor->end_of_table) {
-                        deserialize_row(cursor_value(cursor), &row);
-                        printf("(%d, %s, %s)\n", row.id, row.username, row.email);
-                        rows_returned++;
-                    }
-                    free(cursor);
-                }
-                free(primary_keys);
-                
-                if (rows_returned_out) {
-                    *rows_returned_out = rows_returned;
-                }
-                return EXECUTE_SUCCESS;
-            }
-        }
-    }
     
-    // Regular SELECT (non-aggregation)
-    // Collect all rows first if ORDER BY is needed
-    Row* rows_buffer = NULL;
-    uint32_t buffer_size = 0;
-    
-    if (stmt->has_order_by) {
-        rows_buffer = malloc(sizeof(Row) * 1000); // Max 1000 rows for sorting
-    }
+    // A range scan over the ORDER BY column already yields ascending order
+    SelectOutput out;
+    memset(&out, 0, sizeof(SelectOutput));
+    out.sorted = plan->is_range && stmt->order_ascending &&
+                 strcmp(stmt->order_by_column, plan->index_column) == 0;
+    out.discard = plan->analyze;
     
-    if (stmt->has_where && strcmp(stmt->where_clause->column, "id") == 0) {
-        uint32_t key = atoi(stmt->where_clause->value);
-        cursor = table_find(table, key);
-        
-        if (!cursor->end_of_table) {
-            void* node = pager_get_page(table->pager, cursor->page_num);
-            if (cursor->cell_num < *leaf_node_num_cells(node)) {
-                uint32_t key_at_cursor = *leaf_node_key(node, cursor->cell_num);
-                if (key_at_cursor == key) {
-                    deserialize_row(cursor_value(cursor), &row);
-                    
-                    if (stmt->has_order_by) {
-                        rows_buffer[buffer_size++] = row;
-                    } else {
-                        printf("(%d, %s, %s)\n", row.id, row.username, row.email);
-                        rows_returned++;
-                    }
-                }
-            }
-        }
-        free(cursor);
-    } else {
-        cursor = table_start(table);
-        while (!cursor->end_of_table) {
-            deserialize_row(cursor_value(cursor), &row);
-            
-            bool should_include = true;
-            if (stmt->has_where) {
-                if (strcmp(stmt->where_clause->column, "username") == 0) {
-                    should_include = (strcmp(row.username, stmt->where_clause->value) == 0);
-                } else if (strcmp(stmt->where_clause->column, "email") == 0) {
-                    should_include = (strcmp(row.email, stmt->where_clause->value) == 0);
-                }
-            }
-            
-            if (should_include) {
-                if (stmt->has_order_by) {
-                    rows_buffer[buffer_size++] = row;
-                } else {
-                    printf("(%d, %s, %s)\n", row.id, row.username, row.email);
-                    rows_returned++;
-                    
-                    if (stmt->has_limit && rows_returned >= stmt->limit) {
-                        break;
-                    }
-                }
-            }
-            
-            cursor_advance(cursor);
-        }
-        free(cursor);
-    }
+    OperatorProfile* scan = profile_begin_scan(plan);
+    select_rows(stmt, table, plan, output_row, &out);
+    profile_end(scan, plan->rows_examined, plan->rows_examined - plan->rows_matched);
     
     // Sort if ORDER BY is specified
-    if (stmt->has_order_by && buffer_size > 0) {
-        // Simple bubble sort (for demonstration)
-        for (uint32_t i = 0; i < buffer_size - 1; i++) {
-            for (uint32_t j = 0; j < buffer_size - i - 1; j++) {
-                bool should_swap = false;
-                
-                if (strcmp(stmt->order_by_column, "id") == 0) {
-                    if (stmt->order_ascending) {
-                        should_swap = (rows_buffer[j].id > rows_buffer[j + 1].id);
-                    } else {
-                        should_swap = (rows_buffer[j].id < rows_buffer[j + 1].id);
-                    }
-                } else if (strcmp(stmt->order_by_column, "username") == 0) {
-                    int cmp = strcmp(rows_buffer[j].username, rows_buffer[j + 1].username);
-                    if (stmt->order_ascending) {
-                        should_swap = (cmp > 0);
-                    } else {
-                        should_swap = (cmp < 0);
-                    }
-                }
-                
-                if (should_swap) {
-                    Row temp = rows_buffer[j];
-                    rows_buffer[j] = rows_buffer[j + 1];
-                    rows_buffer[j + 1] = temp;
-                }
-            }
-        }
+    if (out.count > 0) {
+        OperatorProfile* sort = profile_begin(plan, "SORT", PROFILE_NO_ESTIMATE);
+        order_by_stmt = stmt;
+        qsort(out.rows, out.count, sizeof(Row), compare_order_by);
+        profile_end(sort, out.count, 0);
         
-        // Print sorted results
-        uint32_t limit = stmt->has_limit ? stmt->limit : buffer_size;
-        for (uint32_t i = 0; i < buffer_size && i < limit; i++) {
-            printf("(%d, %s, %s)\n", rows_buffer[i].id, rows_buffer[i].username, rows_buffer[i].email);
-            rows_returned++;
+        uint32_t limit = stmt->has_limit ? stmt->limit : out.count;
+        for (uint32_t i = 0; i < out.count && i < limit; i++) {
+            if (!out.discard) {
+                print_selected_row(stmt, table->name, &out.rows[i]);
+            }
+            out.returned++;
         }
-        
-        free(rows_buffer);
     }
+    free(out.rows);
     
     if (rows_returned_out) {
-        *rows_returned_out = rows_returned;
+        *rows_returned_out = out.returned;
     }
     
     return EXECUTE_SUCCESS;
 }
 
-ExecuteResult execute_update(ParsedStatement* stmt, Table* table) {
+ExecuteResult execute_update(ParsedStatement* stmt, Table* table, QueryPlan* plan) {
     if (!stmt->has_where) {
         printf("UPDATE requires WHERE clause\n");
         return EXECUTE_SUCCESS;
@@ -635,17 +1655,19 @@ ExecuteResult execute_update(ParsedStatement* stmt, Table* table) {
     Row row;
     bool found = false;
     
-    if (strcmp(stmt->where_clause->column, "id") == 0) {
+    if (plan->scan_type == SCAN_INDEX_SEARCH && plan->condition) {
         // Update by ID
-        uint32_t key = atoi(stmt->where_clause->value);
+        uint32_t key = atoi(plan->condition->value);
         cursor = table_find(table, key);
         
         if (!cursor->end_of_table) {
             void* node = pager_get_page(table->pager, cursor->page_num);
             if (cursor->cell_num < *leaf_node_num_cells(node)) {
                 uint32_t key_at_cursor = *leaf_node_key(node, cursor->cell_num);
-                if (key_at_cursor == key) {
-                    deserialize_row(cursor_value(cursor), &row);
+                deserialize_row(cursor_value(cursor), &row);
+                plan->rows_examined += key_at_cursor == key;
+                if (key_at_cursor == key && row_matches_where(stmt, table->name, &row)) {
+                    Row old_row = row;
                     
                     // Apply update
                     if (strcmp(stmt->assignments[0].column, "username") == 0) {
@@ -655,6 +1677,17 @@ ExecuteResult execute_update(ParsedStatement* stmt, Table* table) {
                     }
                     
                     serialize_row(&row, cursor_value(cursor));
+                    pager_mark_dirty(table->pager, cursor->page_num);
+                    index_table_update_row(plan->table_indexes, &old_row, &row);
+                    
+                    WALLogicalRecord record = {
+                        .op = WAL_OP_UPDATE,
+                        .page_number = cursor->page_num,
+                        .cell_num = cursor->cell_num,
+                        .key = key,
+                        .row = cursor_value(cursor)
+                    };
+                    wal_log_changes(table->wal, table->wal_table_id, table->pager, &record);
                     found = true;
                 }
             }
@@ -665,7 +1698,7 @@ ExecuteResult execute_update(ParsedStatement* stmt, Table* table) {
     return found ? EXECUTE_SUCCESS : EXECUTE_NOT_FOUND;
 }
 
-ExecuteResult execute_delete(ParsedStatement* stmt, Table* table) {
+ExecuteResult execute_delete(ParsedStatement* stmt, Table* table, QueryPlan* plan) {
     if (!stmt->has_where) {
         printf("DELETE requires WHERE clause (DELETE ALL not supported)\n");
         return EXECUTE_SUCCESS;
@@ -674,23 +1707,31 @@ ExecuteResult execute_delete(ParsedStatement* stmt, Table* table) {
     Cursor* cursor = NULL;
     bool found = false;
     
-    if (strcmp(stmt->where_clause->column, "id") == 0) {
+    if (plan->scan_type == SCAN_INDEX_SEARCH && plan->condition) {
         // Delete by ID
-        uint32_t key = atoi(stmt->where_clause->value);
+        uint32_t key = atoi(plan->condition->value);
         cursor = table_find(table, key);
         
         if (!cursor->end_of_table) {
             void* node = pager_get_page(table->pager, cursor->page_num);
             if (cursor->cell_num < *leaf_node_num_cells(node)) {
                 uint32_t key_at_cursor = *leaf_node_key(node, cursor->cell_num);
-                if (key_at_cursor == key) {
+                Row row;
+                deserialize_row(cursor_value(cursor), &row);
+                plan->rows_examined += key_at_cursor == key;
+                if (key_at_cursor == key && row_matches_where(stmt, table->name, &row)) {
+                    index_table_delete_row(plan->table_indexes, &row);
                     leaf_node_delete(cursor);
                     
                     // Log to WAL
-                    if (table->wal) {
-                        void* page = pager_get_page(table->pager, cursor->page_num);
-                        wal_write_frame(table->wal, cursor->page_num, page, table->pager->num_pages);
-                    }
+                    WALLogicalRecord record = {
+                        .op = WAL_OP_DELETE,
+                        .page_number = cursor->page_num,
+                        .cell_num = cursor->cell_num,
+                        .key = key,
+                        .row = NULL
+                    };
+                    wal_log_changes(table->wal, table->wal_table_id, table->pager, &record);
                     
                     found = true;
                 }
@@ -702,72 +1743,169 @@ ExecuteResult execute_delete(ParsedStatement* stmt, Table* table) {
     return found ? EXECUTE_SUCCESS : EXECUTE_NOT_FOUND;
 }
 
-ExecuteResult execute_statement(ParsedStatement* stmt, Table* table) {
-    if (stmt->type == STMT_CREATE_TABLE) {
-        return execute_create_table(stmt);
-    }
-
-    if (stmt->type == STMT_CREATE_INDEX) {
-        return execute_create_index(stmt, table);
-    }
-
+/*
+ * Plan a SELECT, INSERT, UPDATE or DELETE. *planned_table is the table
+ * it was costed against; NULL is returned when there is none.
+ */
+static QueryPlan* plan_statement(ParsedStatement* stmt, Table* table, Table** planned_table) {
     // The optimizer needs a concrete table to estimate row counts from.
     // For SELECT statements that name their own table (FROM or JOIN)
     // rather than relying on the active table, resolve that table here.
     Table* table_for_optimizer = table;
+    Table* join_tables[MAX_JOIN_TABLES];
+    bool joined = false;
     if (stmt->type == STMT_SELECT) {
-        if (stmt->has_join) {
+        if (join_is_pairwise(stmt)) {
             table_for_optimizer = resolve_table(stmt->join_clause->left_table);
+            join_tables[0] = table_for_optimizer;
+            join_tables[1] = resolve_table(stmt->join_clause->right_table);
+            joined = join_tables[0] && join_tables[1];
+        } else if (stmt->has_join) {
+            if (!resolve_join_tables(stmt, join_tables)) {
+                return NULL;
+            }
+            table_for_optimizer = join_tables[0];
+            joined = true;
         } else if (stmt->from_table[0] != '\0') {
             table_for_optimizer = resolve_table(stmt->from_table);
         }
     }
     if (!table_for_optimizer) {
         printf("Error: No table available for query.\n");
-        return EXECUTE_NOT_FOUND;
+        return NULL;
     }
+    
+    *planned_table = table_for_optimizer;
+    return optimize_query(stmt, table_for_optimizer, joined ? join_tables : NULL, index_manager,
+                          global_schema);
+}
 
-    QueryPlan* plan = optimize_query(stmt, table_for_optimizer);
+static uint64_t nanoseconds_since(const struct timespec* started) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)(now.tv_sec - started->tv_sec) * 1000000000ull + now.tv_nsec - started->tv_nsec;
+}
 
-    if (stmt->is_explain) {
+// Run a planned statement, or only print its plan for EXPLAIN
+static ExecuteResult execute_plan(ParsedStatement* stmt, Table* table, QueryPlan* plan) {
+    if (stmt->is_explain && !stmt->is_explain_analyze) {
         print_query_plan(plan);
-        free_query_plan(plan);
         return EXECUTE_SUCCESS;
     }
     
+    // EXPLAIN ANALYZE runs the statement for real, measuring each operator;
+    // a SELECT profiles its own operators, anything else is one step
+    plan->analyze = stmt->is_explain_analyze;
+    struct timespec started;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    OperatorProfile* step = stmt->type == STMT_SELECT ? NULL :
+        profile_begin(plan, query_plan_scan_name(plan), plan->estimated_rows);
+    
     ExecuteResult result;
     uint32_t actual_rows = 0;
     
     switch (stmt->type) {
         case STMT_INSERT:
-            result = execute_insert(stmt, table);
+            result = execute_insert(stmt, table, plan);
             actual_rows = (result == EXECUTE_SUCCESS) ? 1 : 0;
             break;
         case STMT_SELECT:
-            result = execute_select(stmt, table, &actual_rows);
+            result = execute_select(stmt, table, plan, &actual_rows);
             break;
         case STMT_UPDATE:
-            result = execute_update(stmt, table);
+            result = execute_update(stmt, table, plan);
             actual_rows = (result == EXECUTE_SUCCESS) ? 1 : 0;
             break;
         case STMT_DELETE:
-            result = execute_delete(stmt, table);
+            result = execute_delete(stmt, table, plan);
             actual_rows = 0;
             break;
         case STMT_CREATE_TABLE:  
         case STMT_CREATE_INDEX:
+        case STMT_ANALYZE:
             result = EXECUTE_SUCCESS;
             break;
     }
     
-    if (global_stats && result == EXECUTE_SUCCESS) {
-        stats_update(global_stats, plan, actual_rows);
+    uint64_t elapsed = nanoseconds_since(&started);
+    if (plan->analyze) {
+        profile_end(step, stmt->type == STMT_INSERT ? actual_rows : plan->rows_examined, 0);
+        print_query_plan(plan);
+        print_plan_profile(plan, elapsed / 1e6, actual_rows);
+    }
+    
+    if (global_stats) {
+        stats_record_latency(global_stats, stmt->type, elapsed);
+        if (result == EXECUTE_SUCCESS) {
+            stats_update(global_stats, plan, actual_rows);
+        }
+    }
+    
+    return result;
+}
+
+/*
+ * fingerprint is the statement's plan cache key, or NULL if it has none.
+ * *cached is set when the cache kept the statement and its plan, which
+ * the caller must then not free.
+ */
+ExecuteResult execute_statement(ParsedStatement* stmt, Table* table,
+                                const StatementFingerprint* fingerprint, bool* cached) {
+    *cached = false;
+    if (stmt->type == STMT_CREATE_TABLE || stmt->type == STMT_CREATE_INDEX ||
+        stmt->type == STMT_ANALYZE) {
+        struct timespec started;
+        clock_gettime(CLOCK_MONOTONIC, &started);
+        ExecuteResult result;
+        if (stmt->type == STMT_CREATE_TABLE) {
+            result = execute_create_table(stmt);
+        } else if (stmt->type == STMT_CREATE_INDEX) {
+            result = execute_create_index(stmt, table);
+        } else {
+            result = execute_analyze(stmt);
+        }
+        if (global_stats) {
+            stats_record_latency(global_stats, stmt->type, nanoseconds_since(&started));
+        }
+        // New tables, indexes and statistics change which plans are best
+        plan_cache_invalidate(plan_cache);
+        return result;
+    }
+    
+    Table* planned_table = NULL;
+    QueryPlan* plan = plan_statement(stmt, table, &planned_table);
+    if (!plan) {
+        return EXECUTE_NOT_FOUND;
     }
     
-    free_query_plan(plan);
+    ExecuteResult result = execute_plan(stmt, table, plan);
+    if (fingerprint && plan_cache_insert(plan_cache, fingerprint, stmt, plan, planned_table)) {
+        *cached = true;
+    } else {
+        free_query_plan(plan);
+    }
     return result;
 }
 
+static void print_execute_result(ExecuteResult result) {
+    switch (result) {
+        case EXECUTE_SUCCESS:
+            printf("Executed.\n");
+            break;
+        case EXECUTE_DUPLICATE_KEY:
+            printf("Error: Duplicate key.\n");
+            break;
+        case EXECUTE_TABLE_FULL:
+            printf("Error: Table full.\n");
+            break;
+        case EXECUTE_NOT_FOUND:
+            printf("Error: Row not found.\n");
+            break;
+        case EXECUTE_FAILED:
+            break;
+    }
+}
+
 int main(int argc, char* argv[]) {
     if (argc < 2) {
         printf("Must supply a database filename.\n");
@@ -781,7 +1919,8 @@ int main(int argc, char* argv[]) {
     global_stats = stats_create();
     global_schema = schema_load(filename);
     table_manager = table_manager_create(filename);  // <-- ADD
-    index_manager = index_manager_create();
+    index_manager = index_manager_create(filename, table_manager->wal);
+    plan_cache = plan_cache_create();
     
     // If a schema was loaded from a previous session, reopen each of its
     // tables so their data is accessible, and make the last one active
@@ -795,6 +1934,22 @@ int main(int argc, char* argv[]) {
                 current_table_name[sizeof(current_table_name) - 1] = '\0';
             }
         }
+        
+        // Reattach the catalog's indexes to their files on disk. Only an
+        // index whose file has gone missing is rebuilt from its table; one
+        // whose rebuild fails is left out of this session, and its
+        // definition stays in the catalog for the next open to retry.
+        for (uint32_t i = 0; i < global_schema->num_indexes; i++) {
+            IndexDef* def = &global_schema->indexes[i];
+            if (index_manager_open_index(index_manager, def)) {
+                continue;
+            }
+            Table* t = table_manager_get(table_manager, def->table_name);
+            if (t && index_manager_create_index(index_manager, def) &&
+                !index_manager_build_from_table(index_manager, def, t)) {
+                index_manager_drop_index(index_manager, def);
+            }
+        }
     }
     
     InputBuffer* input_buffer = new_input_buffer();
@@ -815,10 +1970,24 @@ int main(int argc, char* argv[]) {
             }
         }
         
+        // A statement shaped like one seen before reuses its parse and plan
+        // with this statement's literals bound in
+        StatementFingerprint fingerprint;
+        bool cacheable = plan_cache_fingerprint(input_buffer->buffer, current_table_name, &fingerprint);
+        PlanCacheEntry* entry = cacheable ? plan_cache_lookup(plan_cache, &fingerprint) : NULL;
+        ExecuteResult result;
+        if (entry) {
+            result = execute_plan(entry->stmt, active_table, entry->plan);
+            plan_cache_fingerprint_free(&fingerprint);
+            print_execute_result(result);
+            continue;
+        }
+        
         ParsedStatement* stmt = parse_statement(input_buffer->buffer);
         
         if (stmt == NULL) {
             printf("Syntax error. Could not parse statement.\n");
+            plan_cache_fingerprint_free(&fingerprint);
             continue;
         }
         
@@ -826,29 +1995,21 @@ int main(int argc, char* argv[]) {
         // SELECT/CREATE INDEX can supply their own target table by name.
         bool statement_supplies_own_table =
             (stmt->type == STMT_SELECT && (stmt->from_table[0] != '\0' || stmt->has_join)) ||
-            (stmt->type == STMT_CREATE_INDEX && stmt->index_table[0] != '\0');
+            (stmt->type == STMT_CREATE_INDEX && stmt->index_table[0] != '\0') ||
+            stmt->type == STMT_ANALYZE;
         if (stmt->type != STMT_CREATE_TABLE && !active_table && !statement_supplies_own_table) {
             printf("Error: No active table. Use CREATE TABLE first.\n");
             free_parsed_statement(stmt);
+            plan_cache_fingerprint_free(&fingerprint);
             continue;
         }
         
-        ExecuteResult result = execute_statement(stmt, active_table);
-        free_parsed_statement(stmt);
-        
-        switch (result) {
-            case EXECUTE_SUCCESS:
-                printf("Executed.\n");
-                break;
-            case EXECUTE_DUPLICATE_KEY:
-                printf("Error: Duplicate key.\n");
-                break;
-            case EXECUTE_TABLE_FULL:
-                printf("Error: Table full.\n");
-                break;
-            case EXECUTE_NOT_FOUND:
-                printf("Error: Row not found.\n");
-                break;
+        bool cached;
+        result = execute_statement(stmt, active_table, cacheable ? &fingerprint : NULL, &cached);
+        if (!cached) {
+            free_parsed_statement(stmt);
         }
+        plan_cache_fingerprint_free(&fingerprint);
+        print_execute_result(result);
     }
 }
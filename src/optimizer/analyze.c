@@ -0,0 +1,307 @@
+#include "analyze.h"
+#include "hyperloglog.h"
+#include "../index/btree.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+// Physical column names, for tables without a declared schema
+static const char* analyze_column_names[INDEX_NUM_COLUMNS] = { "id", "username", "email" };
+
+// Leaf page numbers, found from the internal pages alone: the tree is balanced
+static void analyze_collect_leaves(Table* table, uint32_t page_num, uint32_t depth,
+                                   uint32_t** leaves, uint32_t* count, uint32_t* capacity) {
+    if (depth >= table->header->tree_height) {
+        if (*count >= *capacity) {
+            *capacity = *capacity ? *capacity * 2 : 64;
+            *leaves = realloc(*leaves, sizeof(uint32_t) * *capacity);
+        }
+        (*leaves)[(*count)++] = page_num;
+        return;
+    }
+    
+    void* node = pager_get_page(table->pager, page_num);
+    uint32_t num_keys = *internal_node_num_keys(node);
+    for (uint32_t i = 0; i <= num_keys; i++) {
+        uint32_t child = *internal_node_child(node, i);
+        if (child != INVALID_PAGE_NUM) {
+            analyze_collect_leaves(table, child, depth + 1, leaves, count, capacity);
+        }
+    }
+}
+
+static int analyze_compare_u32(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+static int analyze_compare_values(const void* a, const void* b) {
+    return strncmp(a, b, STATS_VALUE_SIZE);
+}
+
+/*
+ * Keep a uniform random subset of the leaves, in page order so they are
+ * read front to back. The seed is fixed, so the same table gives the
+ * same statistics (and plans) every time.
+ */
+static uint32_t analyze_sample_leaves(uint32_t* leaves, uint32_t count) {
+    if (count > ANALYZE_SAMPLE_PAGES) {
+        uint32_t state = 0x9e3779b9u ^ count;
+        for (uint32_t i = 0; i < ANALYZE_SAMPLE_PAGES; i++) {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            uint32_t pick = i + state % (count - i);
+            uint32_t swap = leaves[i];
+            leaves[i] = leaves[pick];
+            leaves[pick] = swap;
+        }
+        count = ANALYZE_SAMPLE_PAGES;
+    }
+    qsort(leaves, count, sizeof(uint32_t), analyze_compare_u32);
+    return count;
+}
+
+/*
+ * Equi-depth bounds from n sorted values: bucket b ends at the value a
+ * (b + 1) / num_buckets share of the way through
+ */
+static void analyze_fill_histogram(ColumnStats* stats, const char* values, uint32_t n) {
+    stats->num_buckets = n < STATS_HISTOGRAM_BUCKETS ? n : STATS_HISTOGRAM_BUCKETS;
+    if (n == 0) {
+        return;
+    }
+    
+    memcpy(stats->min_value, values, STATS_VALUE_SIZE);
+    for (uint32_t b = 0; b < stats->num_buckets; b++) {
+        uint64_t last = ((uint64_t)(b + 1) * n) / stats->num_buckets - 1;
+        memcpy(stats->bounds[b], values + last * STATS_VALUE_SIZE, STATS_VALUE_SIZE);
+    }
+}
+
+// Sampled distinct values, scaled to the whole table
+static uint32_t analyze_scale_distinct(uint64_t sampled_distinct, uint32_t sampled_rows,
+                                       uint32_t row_count) {
+    if (sampled_distinct > sampled_rows) {
+        sampled_distinct = sampled_rows;
+    }
+    uint64_t distinct = sampled_distinct;
+    if (sampled_rows < row_count && sampled_distinct * 20 >= (uint64_t)sampled_rows * 19) {
+        distinct = sampled_distinct * row_count / sampled_rows;
+    }
+    if (distinct > row_count) {
+        distinct = row_count;
+    }
+    return (uint32_t)distinct;
+}
+
+/*
+ * Statistics for each of the table's columns, written to stats (room for
+ * INDEX_NUM_COLUMNS). schema names the columns; NULL uses the physical
+ * names. Returns the number of columns analyzed.
+ */
+uint32_t analyze_table(Table* table, const TableSchema* schema, ColumnStats* stats) {
+    uint32_t* leaves = NULL;
+    uint32_t num_leaves = 0;
+    uint32_t capacity = 0;
+    analyze_collect_leaves(table, table->root_page_num, 1, &leaves, &num_leaves, &capacity);
+    num_leaves = analyze_sample_leaves(leaves, num_leaves);
+    
+    // Gather the sample, hashing each value in full as it goes by
+    uint32_t max_rows = num_leaves * LEAF_NODE_MAX_CELLS;
+    uint32_t* ids = malloc(sizeof(uint32_t) * (max_rows + 1));
+    char* usernames = malloc((size_t)STATS_VALUE_SIZE * (max_rows + 1));
+    char* emails = malloc((size_t)STATS_VALUE_SIZE * (max_rows + 1));
+    HyperLogLog* sketches = malloc(sizeof(HyperLogLog) * INDEX_NUM_COLUMNS);
+    for (uint32_t c = 0; c < INDEX_NUM_COLUMNS; c++) {
+        hll_init(&sketches[c]);
+    }
+    
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < num_leaves; i++) {
+        void* node = pager_get_page(table->pager, leaves[i]);
+        if (get_node_type(node) != NODE_LEAF) {
+            continue;
+        }
+        uint32_t num_cells = *leaf_node_num_cells(node);
+        for (uint32_t cell = 0; cell < num_cells; cell++, n++) {
+            Row row;
+            deserialize_row(leaf_node_value(node, cell), &row);
+            ids[n] = row.id;
+            strncpy(usernames + (size_t)n * STATS_VALUE_SIZE, row.username, STATS_VALUE_SIZE);
+            strncpy(emails + (size_t)n * STATS_VALUE_SIZE, row.email, STATS_VALUE_SIZE);
+            usernames[(size_t)n * STATS_VALUE_SIZE + STATS_VALUE_SIZE - 1] = '\0';
+            emails[(size_t)n * STATS_VALUE_SIZE + STATS_VALUE_SIZE - 1] = '\0';
+            
+            hll_add(&sketches[ROW_COLUMN_ID], hll_hash(&row.id, sizeof(row.id)));
+            hll_add(&sketches[ROW_COLUMN_USERNAME],
+                    hll_hash(row.username, strnlen(row.username, COLUMN_USERNAME_SIZE)));
+            hll_add(&sketches[ROW_COLUMN_EMAIL],
+                    hll_hash(row.email, strnlen(row.email, COLUMN_EMAIL_SIZE)));
+        }
+    }
+    free(leaves);
+    
+    // Ids sort as numbers, then take the same text form as the other columns
+    qsort(ids, n, sizeof(uint32_t), analyze_compare_u32);
+    char* id_values = malloc((size_t)STATS_VALUE_SIZE * (n + 1));
+    for (uint32_t i = 0; i < n; i++) {
+        snprintf(id_values + (size_t)i * STATS_VALUE_SIZE, STATS_VALUE_SIZE, "%u", ids[i]);
+    }
+    qsort(usernames, n, STATS_VALUE_SIZE, analyze_compare_values);
+    qsort(emails, n, STATS_VALUE_SIZE, analyze_compare_values);
+    const char* sorted[INDEX_NUM_COLUMNS] = { id_values, usernames, emails };
+    
+    uint32_t num_columns = schema && schema->num_columns < INDEX_NUM_COLUMNS ?
+                           schema->num_columns : INDEX_NUM_COLUMNS;
+    for (uint32_t c = 0; c < num_columns; c++) {
+        ColumnStats* column = &stats[c];
+        memset(column, 0, sizeof(ColumnStats));
+        strncpy(column->table_name, table->name, MAX_TABLE_NAME - 1);
+        strncpy(column->column_name, schema ? schema->columns[c].name : analyze_column_names[c],
+                MAX_COLUMN_NAME - 1);
+        column->column_id = c;
+        column->row_count = table->header->row_count;
+        column->sampled_rows = n;
+        column->distinct_count = analyze_scale_distinct(hll_estimate(&sketches[c]), n,
+                                                        column->row_count);
+        analyze_fill_histogram(column, sorted[c], n);
+    }
+    
+    free(ids);
+    free(id_values);
+    free(usernames);
+    free(emails);
+    free(sketches);
+    return num_columns;
+}
+
+// Distinct values at the table's current size
+uint32_t column_stats_distinct(const ColumnStats* stats, uint32_t row_count) {
+    uint64_t distinct = stats->distinct_count;
+    if (stats->row_count > 0 && (uint64_t)stats->distinct_count * 20 >= (uint64_t)stats->row_count * 19) {
+        distinct = distinct * row_count / stats->row_count;
+    }
+    if (distinct > row_count) {
+        distinct = row_count;
+    }
+    return distinct > 0 ? (uint32_t)distinct : 1;
+}
+
+static int stats_compare(const ColumnStats* stats, const char* a, const char* b) {
+    if (stats->column_id == ROW_COLUMN_ID) {
+        long long x = strtoll(a, NULL, 10);
+        long long y = strtoll(b, NULL, 10);
+        return (x > y) - (x < y);
+    }
+    return strncmp(a, b, STATS_VALUE_SIZE - 1);
+}
+
+/*
+ * Share of rows whose value is below `value` (at most `value` when
+ * inclusive): the buckets wholly below it, plus part of the bucket it
+ * falls in, interpolated for ids and taken as half for text
+ */
+static double stats_fraction_below(const ColumnStats* stats, const char* value, bool inclusive) {
+    uint32_t b = 0;
+    while (b < stats->num_buckets) {
+        int cmp = stats_compare(stats, stats->bounds[b], value);
+        if (cmp > 0 || (cmp == 0 && !inclusive)) {
+            break;
+        }
+        b++;
+    }
+    if (b == stats->num_buckets) {
+        return 1.0;
+    }
+    
+    const char* lower = b > 0 ? stats->bounds[b - 1] : stats->min_value;
+    if (stats_compare(stats, value, lower) < 0 ||
+        (b == 0 && stats_compare(stats, value, lower) == 0 && !inclusive)) {
+        return (double)b / stats->num_buckets;
+    }
+    
+    double within = 0.5;
+    if (stats->column_id == ROW_COLUMN_ID) {
+        double low = strtod(lower, NULL);
+        double high = strtod(stats->bounds[b], NULL);
+        double v = strtod(value, NULL);
+        within = high > low ? (v - low) / (high - low) : 0.5;
+        within = within < 0.0 ? 0.0 : within > 1.0 ? 1.0 : within;
+    }
+    return (b + within) / stats->num_buckets;
+}
+
+/*
+ * Estimated share of rows matching condition, or false if the statistics
+ * cannot say (no sampled rows, or a LIKE without a literal prefix).
+ * Equality is one over the distinct count, raised for a value that fills
+ * whole histogram buckets on its own.
+ */
+bool column_stats_selectivity(const ColumnStats* stats, const Condition* condition,
+                              double* selectivity) {
+    if (stats->num_buckets == 0) {
+        return false;
+    }
+    
+    const char* op = condition->operator;
+    double s;
+    if (strcmp(op, "=") == 0) {
+        const char* max = stats->bounds[stats->num_buckets - 1];
+        if (stats_compare(stats, condition->value, stats->min_value) < 0 ||
+            stats_compare(stats, condition->value, max) > 0) {
+            s = 0.0;
+        } else {
+            uint32_t repeats = 0;
+            for (uint32_t b = 0; b < stats->num_buckets; b++) {
+                repeats += stats_compare(stats, stats->bounds[b], condition->value) == 0;
+            }
+            s = 1.0 / column_stats_distinct(stats, stats->row_count);
+            if (repeats > 1 && (double)(repeats - 1) / stats->num_buckets > s) {
+                s = (double)(repeats - 1) / stats->num_buckets;
+            }
+        }
+    } else if (strcmp(op, "<") == 0) {
+        s = stats_fraction_below(stats, condition->value, false);
+    } else if (strcmp(op, "<=") == 0) {
+        s = stats_fraction_below(stats, condition->value, true);
+    } else if (strcmp(op, ">") == 0) {
+        s = 1.0 - stats_fraction_below(stats, condition->value, true);
+    } else if (strcmp(op, ">=") == 0) {
+        s = 1.0 - stats_fraction_below(stats, condition->value, false);
+    } else if (strcmp(op, "BETWEEN") == 0) {
+        s = stats_fraction_below(stats, condition->value2, true) -
+            stats_fraction_below(stats, condition->value, false);
+    } else if (strcmp(op, "LIKE") == 0 && stats->column_id != ROW_COLUMN_ID) {
+        // 'abc%' spans ["abc", "abd")
+        char lower[STATS_VALUE_SIZE];
+        char upper[STATS_VALUE_SIZE];
+        size_t length = condition_like_prefix(condition, lower, sizeof(lower));
+        if (length == 0) {
+            return false;
+        }
+        strcpy(upper, lower);
+        while (length > 0 && (unsigned char)upper[length - 1] == 0xff) {
+            upper[--length] = '\0';
+        }
+        if (length == 0) {
+            s = 1.0 - stats_fraction_below(stats, lower, false);
+        } else {
+            upper[length - 1]++;
+            s = stats_fraction_below(stats, upper, false) -
+                stats_fraction_below(stats, lower, false);
+        }
+    } else if (strcmp(op, "!=") == 0) {
+        Condition equals = *condition;
+        equals.operator = "=";
+        equals.op = OP_EQUALS;
+        column_stats_selectivity(stats, &equals, &s);
+        s = 1.0 - s;
+    } else {
+        return false;
+    }
+    
+    *selectivity = s < 0.0 ? 0.0 : s > 1.0 ? 1.0 : s;
+    return true;
+}
@@ -0,0 +1,28 @@
+#ifndef ANALYZE_H
+#define ANALYZE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../storage/table.h"
+#include "../storage/schema.h"
+#include "../parser/parser.h"
+
+/*
+ * ANALYZE: column statistics for the planner
+ *
+ * Reads up to ANALYZE_SAMPLE_PAGES leaf pages picked uniformly at random
+ * (every leaf of a smaller table); only internal pages are read to find
+ * them. For each column the sampled values give an equi-depth histogram
+ * and a HyperLogLog distinct count. A column whose sampled values are
+ * nearly all distinct is taken to stay that way, so its count is scaled
+ * up to the table; otherwise the sample has seen most of its values.
+ */
+#define ANALYZE_SAMPLE_PAGES 512
+
+// Function declarations
+uint32_t analyze_table(Table* table, const TableSchema* schema, ColumnStats* stats);
+bool column_stats_selectivity(const ColumnStats* stats, const Condition* condition,
+                              double* selectivity);
+uint32_t column_stats_distinct(const ColumnStats* stats, uint32_t row_count);
+
+#endif // ANALYZE_H
@@ -0,0 +1,55 @@
+#include "hyperloglog.h"
+#include "../transaction/checksum.h"
+#include <string.h>
+#include <math.h>
+
+void hll_init(HyperLogLog* hll) {
+    memset(hll->registers, 0, sizeof(hll->registers));
+}
+
+/*
+ * CRC32C spreads the value over 32 bits and the splitmix64 finalizer
+ * spreads those (and the length) over all 64, so the register index and
+ * the zero run come from independent-looking bits
+ */
+uint64_t hll_hash(const void* data, size_t length) {
+    uint64_t hash = ((uint64_t)length << 32) | crc32c(0, data, length);
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+    return hash ^ (hash >> 31);
+}
+
+void hll_add(HyperLogLog* hll, uint64_t hash) {
+    uint32_t index = (uint32_t)(hash >> (64 - HLL_PRECISION));
+    uint64_t rest = hash << HLL_PRECISION;
+    
+    // Position of the first set bit; a sentinel bit caps the run
+    uint8_t rank = 1;
+    rest |= 1ULL << (HLL_PRECISION - 1);
+    while (!(rest & (1ULL << 63))) {
+        rank++;
+        rest <<= 1;
+    }
+    
+    if (rank > hll->registers[index]) {
+        hll->registers[index] = rank;
+    }
+}
+
+uint64_t hll_estimate(const HyperLogLog* hll) {
+    const double m = HLL_REGISTERS;
+    const double alpha = 0.7213 / (1.0 + 1.079 / m);
+    
+    double sum = 0.0;
+    uint32_t zeros = 0;
+    for (uint32_t i = 0; i < HLL_REGISTERS; i++) {
+        sum += ldexp(1.0, -hll->registers[i]);
+        zeros += hll->registers[i] == 0;
+    }
+    
+    double estimate = alpha * m * m / sum;
+    if (estimate <= 2.5 * m && zeros > 0) {
+        estimate = m * log(m / zeros);
+    }
+    return (uint64_t)(estimate + 0.5);
+}
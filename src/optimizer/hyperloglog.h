@@ -0,0 +1,30 @@
+#ifndef HYPERLOGLOG_H
+#define HYPERLOGLOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * HyperLogLog distinct-value sketch
+ *
+ * A value's 64-bit hash picks one of HLL_REGISTERS registers with its
+ * top HLL_PRECISION bits; the register keeps the longest run of leading
+ * zeros seen in the remaining bits. The harmonic mean of the registers
+ * estimates the number of distinct values to about 1.6% (1.04 / sqrt(m))
+ * in 4 KB, however many values are added. Small counts fall back to
+ * linear counting over the empty registers, which is nearly exact.
+ */
+#define HLL_PRECISION 12
+#define HLL_REGISTERS (1u << HLL_PRECISION)
+
+typedef struct {
+    uint8_t registers[HLL_REGISTERS];
+} HyperLogLog;
+
+// Function declarations
+void hll_init(HyperLogLog* hll);
+uint64_t hll_hash(const void* data, size_t length);
+void hll_add(HyperLogLog* hll, uint64_t hash);
+uint64_t hll_estimate(const HyperLogLog* hll);
+
+#endif // HYPERLOGLOG_H
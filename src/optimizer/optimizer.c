@@ -1,148 +1,1041 @@
 #include "optimizer.h"
 #include "../index/btree.h"
+#include "../index/bitmap_index.h"
+#include "analyze.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 
-// Helper function to count total rows in table
-static uint32_t count_table_rows(Table* table) {
-    uint32_t count = 0;
-    Cursor* cursor = table_start(table);
+// Levels of a B+tree with the given fanout holding `entries` entries
+static uint32_t tree_height_for(uint32_t entries, uint32_t fanout) {
+    uint32_t height = 1;
+    while (entries > fanout) {
+        height++;
+        entries /= fanout;
+    }
+    return height;
+}
+
+/*
+ * Columns a SELECT reads, as INDEX_COLUMN_* bits, or 0 if it reads one
+ * that no index can hold (a schema alias, or an unknown column)
+ */
+static uint32_t select_needed_columns(ParsedStatement* stmt) {
+    uint32_t needed = INDEX_COLUMN_ID;
+    
+    if (stmt->has_aggregation) {
+        if (strcmp(stmt->agg_column, "*") != 0) {
+            needed |= index_column_bit(stmt->agg_column);
+        }
+    } else if (stmt->num_select_columns == 0) {
+        needed = INDEX_COLUMN_ALL;
+    } else {
+        for (uint32_t i = 0; i < stmt->num_select_columns; i++) {
+            uint32_t bit = index_column_bit(stmt->select_columns[i]);
+            if (!bit) {
+                return 0;
+            }
+            needed |= bit;
+        }
+    }
+    
+    if (stmt->has_order_by) {
+        uint32_t bit = index_column_bit(stmt->order_by_column);
+        if (!bit) {
+            return 0;
+        }
+        needed |= bit;
+    }
+    
+    // Every condition is rechecked on the rows the access path yields
+    for (Condition* condition = stmt->has_where ? stmt->where_clause : NULL; condition;
+         condition = condition->next) {
+        uint32_t bit = index_column_bit(condition->column);
+        if (!bit) {
+            return 0;
+        }
+        needed |= bit;
+    }
+    return needed;
+}
+
+// WHERE id = value [AND ...], answered by the primary B+tree
+static bool where_is_id_equality(ParsedStatement* stmt) {
+    return stmt->has_where && stmt->where_clause->conjunct &&
+           strcmp(stmt->where_clause->column, "id") == 0 && stmt->where_clause->op == OP_EQUALS;
+}
+
+/*
+ * The key range of a B+tree scan that finds every row matching a range
+ * or LIKE 'prefix%' condition. False if no ordered scan can serve it.
+ */
+bool condition_index_range(const Condition* condition, IndexRange* range) {
+    memset(range, 0, sizeof(IndexRange));
+    const char* op = condition->operator;
+    
+    if (strcmp(op, "LIKE") == 0) {
+        return condition_like_prefix(condition, range->prefix, sizeof(range->prefix)) > 0;
+    }
+    if (strcmp(op, ">") == 0 || strcmp(op, ">=") == 0 || strcmp(op, "BETWEEN") == 0) {
+        strncpy(range->lower, condition->value, INDEX_KEY_SIZE - 1);
+        range->has_lower = true;
+    }
+    if (strcmp(op, "<") == 0 || strcmp(op, "<=") == 0) {
+        strncpy(range->upper, condition->value, INDEX_KEY_SIZE - 1);
+        range->has_upper = true;
+    } else if (strcmp(op, "BETWEEN") == 0) {
+        strncpy(range->upper, condition->value2, INDEX_KEY_SIZE - 1);
+        range->has_upper = true;
+    }
+    return range->has_lower || range->has_upper;
+}
+
+static uint32_t id_bound(const char* value) {
+    long long id = atoll(value);
+    return id < 0 ? 0 : id > UINT32_MAX ? UINT32_MAX : (uint32_t)id;
+}
+
+/*
+ * The inclusive id bounds of a range condition on the primary key, for
+ * a walk along the table's leaves. Rows are rechecked, so `>` and `<`
+ * share the bounds of `>=` and `<=`. False if it is not such a range.
+ */
+bool condition_id_range(const Condition* condition, uint32_t* lower, uint32_t* upper) {
+    const char* op = condition->operator;
+    bool between = strcmp(op, "BETWEEN") == 0;
+    if (strcmp(condition->column, "id") != 0 ||
+        (!between && strcmp(op, "<") != 0 && strcmp(op, "<=") != 0 &&
+         strcmp(op, ">") != 0 && strcmp(op, ">=") != 0)) {
+        return false;
+    }
+    
+    *lower = op[0] == '>' || between ? id_bound(condition->value) : 0;
+    *upper = op[0] == '<' ? id_bound(condition->value) :
+             between ? id_bound(condition->value2) : UINT32_MAX;
+    return true;
+}
+
+static bool index_covers(SecondaryIndex* index, uint32_t needed) {
+    return index && needed && (needed & ~secondary_index_columns(index)) == 0;
+}
+
+/*
+ * Rows a WHERE condition is estimated to match. With ANALYZE statistics
+ * for its column this comes from the histogram and distinct count;
+ * otherwise ranges and prefixes match fixed fractions of the table, and
+ * an equality is taken to be selective (at most one row).
+ */
+#define RANGE_SELECTIVITY_DIVISOR 3
+#define BETWEEN_SELECTIVITY_DIVISOR 10
+#define PREFIX_SELECTIVITY_DIVISOR 10
+
+static uint32_t condition_rows(const Condition* condition, const ColumnStats* stats,
+                               uint32_t total_rows) {
+    double selectivity;
+    if (stats && column_stats_selectivity(stats, condition, &selectivity)) {
+        uint32_t rows = (uint32_t)(selectivity * total_rows + 0.5);
+        return rows > 0 ? rows : 1;
+    }
+    
+    const char* op = condition->operator;
+    if (strcmp(op, "=") == 0) {
+        return 1;
+    } else if (strcmp(op, "!=") == 0) {
+        return total_rows;
+    } else if (strcmp(op, "LIKE") == 0) {
+        return total_rows / PREFIX_SELECTIVITY_DIVISOR + 1;
+    } else if (strcmp(op, "BETWEEN") == 0) {
+        return total_rows / BETWEEN_SELECTIVITY_DIVISOR + 1;
+    }
+    return total_rows / RANGE_SELECTIVITY_DIVISOR + 1;
+}
+
+static uint32_t cost_clamp(uint64_t cost) {
+    return cost > UINT32_MAX ? UINT32_MAX : (uint32_t)cost;
+}
+
+// Descend to the leftmost leaf, then read every leaf and row
+static uint64_t full_scan_cost(Table* table) {
+    TableHeader* header = table->header;
+    uint64_t pages = header->tree_height - 1 + (header->leaf_pages ? header->leaf_pages : 1);
+    return pages * COST_PAGE_READ + (uint64_t)header->row_count * COST_ROW_CPU;
+}
+
+// Fetch rows one at a time by id, a root-to-leaf descent each
+static uint64_t fetch_cost(Table* table, uint32_t rows) {
+    return (uint64_t)rows * (table->header->tree_height * COST_PAGE_READ + COST_ROW_CPU);
+}
+
+// One descent, then the leaves holding `rows` consecutive ids
+static uint64_t primary_range_cost(Table* table, uint32_t rows) {
+    TableHeader* header = table->header;
+    uint32_t rows_per_leaf = header->leaf_pages ? header->row_count / header->leaf_pages : 0;
+    uint64_t pages = header->tree_height + rows / (rows_per_leaf ? rows_per_leaf : 1);
+    return pages * COST_PAGE_READ + (uint64_t)rows * COST_ROW_CPU;
+}
+
+/*
+ * `rows` entries of a secondary index: a bucket and its overflow pages
+ * for hash, a descent and the leaves for B+tree, then a table fetch per
+ * entry unless the index covers the query
+ */
+static uint64_t secondary_scan_cost(SecondaryIndex* index, bool covering, Table* table,
+                                    uint32_t rows) {
+    uint64_t pages = rows / index->leaf_max_entries +
+        (index->type == INDEX_TYPE_HASH ? 1 :
+         tree_height_for(table->header->row_count, index->leaf_max_entries));
+    uint64_t cost = pages * COST_PAGE_READ + (uint64_t)rows * COST_ROW_CPU;
+    return covering ? cost : cost + fetch_cost(table, rows);
+}
+
+/*
+ * Bitmap indexes for the WHERE conditions, one slot per condition: a
+ * condition is answered by a bitmap when it is `column = value` on a
+ * column with a bitmap index. OR needs every condition answered; under
+ * AND, including the top-level terms of a clause mixing AND and OR, the
+ * rest are rechecked on each fetched row. NULL when no bitmap plan
+ * applies. Bitmap cardinalities give exact per-value row counts:
+ * the estimate is the smallest for AND and the sum for OR. *exact is
+ * set when the bitmaps decide the whole clause, so rows need no recheck.
+ */
+static SecondaryIndex** choose_bitmap_indexes(ParsedStatement* stmt, IndexTable* indexes,
+                                              uint32_t total_rows, uint32_t* rows, bool* exact) {
+    if (stmt->type != STMT_SELECT || !stmt->has_where || !indexes) {
+        return NULL;
+    }
+    
+    uint32_t num_conditions = 0;
+    for (Condition* condition = stmt->where_clause; condition; condition = condition->next) {
+        num_conditions++;
+    }
+    
+    SecondaryIndex** bitmaps = calloc(num_conditions, sizeof(SecondaryIndex*));
+    uint32_t answered = 0;
+    uint64_t estimate = stmt->where_is_or ? 0 : total_rows;
+    bool untruncated = true;
+    uint32_t i = 0;
+    for (Condition* condition = stmt->where_clause; condition; condition = condition->next, i++) {
+        if (condition->op != OP_EQUALS || (!stmt->where_is_or && !condition->conjunct)) {
+            continue;
+        }
+        bitmaps[i] = index_table_get(indexes, condition->column, INDEX_TYPE_BITMAP);
+        if (!bitmaps[i]) {
+            continue;
+        }
+        
+        const RoaringBitmap* ids = bitmap_index_get(bitmaps[i], condition->value);
+        uint64_t count = ids ? roaring_cardinality(ids) : 0;
+        estimate = stmt->where_is_or ? estimate + count : (count < estimate ? count : estimate);
+        untruncated = untruncated && strlen(condition->value) < INDEX_KEY_SIZE - 1;
+        answered++;
+    }
+    
+    *exact = answered == num_conditions && untruncated;
+    *rows = estimate < total_rows ? (uint32_t)estimate : total_rows;
+    if (stmt->where_is_or ? answered < num_conditions : answered == 0) {
+        free(bitmaps);
+        return NULL;
+    }
+    return bitmaps;
+}
+
+// Columns of a bitmap plan, each listed once, for EXPLAIN
+static void bitmap_columns(ParsedStatement* stmt, SecondaryIndex** bitmaps, char* columns,
+                           size_t size) {
+    columns[0] = '\0';
+    uint32_t i = 0;
+    for (Condition* condition = stmt->where_clause; condition; condition = condition->next, i++) {
+        uint32_t earlier = 0;
+        while (earlier < i && bitmaps[earlier] != bitmaps[i]) {
+            earlier++;
+        }
+        if (bitmaps[i] && earlier == i) {
+            size_t used = strlen(columns);
+            snprintf(columns + used, size - used, "%s%s", used ? ", " : "", condition->column);
+        }
+    }
+}
+
+/*
+ * Rows of an equi-join: each left row meets the right rows sharing its
+ * value, |L| * |R| / max(distinct left, distinct right). Without
+ * statistics the join column is taken to be a key of the larger side.
+ */
+static uint32_t join_rows(ParsedStatement* stmt, Table* left, Table* right, Schema* schema) {
+    uint64_t left_rows = left->header->row_count;
+    uint64_t right_rows = right->header->row_count;
+    const ColumnStats* left_stats = schema ?
+        schema_get_column_stats(schema, left->name, stmt->join_clause->left_column) : NULL;
+    const ColumnStats* right_stats = schema ?
+        schema_get_column_stats(schema, right->name, stmt->join_clause->right_column) : NULL;
+    
+    uint64_t left_distinct = left_stats ? column_stats_distinct(left_stats, left_rows) : left_rows;
+    uint64_t right_distinct = right_stats ? column_stats_distinct(right_stats, right_rows) : right_rows;
+    uint64_t distinct = left_distinct > right_distinct ? left_distinct : right_distinct;
+    if (distinct == 0) {
+        return 0;
+    }
+    uint64_t rows = left_rows * right_rows / distinct;
+    return rows > UINT32_MAX ? UINT32_MAX : (uint32_t)rows;
+}
+
+// Whether a column is its table's primary key: the first column of its schema
+bool column_is_primary_key(Schema* schema, const char* table_name, const char* column) {
+    TableSchema* table_schema = schema ? schema_get_table(schema, table_name) : NULL;
+    if (!table_schema || table_schema->num_columns == 0) {
+        return strcmp(column, "id") == 0;
+    }
+    return strcmp(table_schema->columns[0].name, column) == 0;
+}
+
+// Comparison sort of `rows` rows
+static uint64_t sort_cost(uint64_t rows) {
+    uint64_t comparisons = 0;
+    for (uint64_t n = rows; n > 1; n /= 2) {
+        comparisons += rows;
+    }
+    return comparisons * COST_ROW_CPU;
+}
+
+static void path_init(AccessPath* path, ScanType scan_type, SecondaryIndex* index,
+                      Condition* condition, uint32_t rows, uint64_t cost) {
+    memset(path, 0, sizeof(AccessPath));
+    path->scan_type = scan_type;
+    path->secondary_index = index;
+    path->condition = condition;
+    path->estimated_rows = rows;
+    path->estimated_cost = cost_clamp(cost);
+}
+
+// Record a candidate for EXPLAIN and keep the cheapest; ties keep the earlier
+static void consider_path(QueryPlan* plan, AccessPath* best, const AccessPath* path) {
+    if (plan->num_paths < MAX_ACCESS_PATHS) {
+        plan->paths[plan->num_paths++] = *path;
+    }
+    if (!best->description[0] || path->estimated_cost < best->estimated_cost) {
+        *best = *path;
+    }
+}
+
+/*
+ * The paths one WHERE condition can drive: a primary key probe or range
+ * for id, otherwise each index on its column. An equality can use hash
+ * or B+tree, a range or LIKE prefix only the ordered B+tree. A path is
+ * index-only when the index holds every column the query reads; stored
+ * keys are truncated, so an equality on a value that fills the key
+ * still reads the table.
+ */
+static void consider_condition_paths(QueryPlan* plan, AccessPath* best, ParsedStatement* stmt,
+                                     Table* table, Condition* condition, const ColumnStats* stats) {
+    uint32_t total_rows = table->header->row_count;
+    bool equality = strcmp(condition->operator, "=") == 0;
+    uint32_t rows = condition_rows(condition, stats, total_rows);
+    AccessPath path;
     
-    while (!cursor->end_of_table) {
-        count++;
-        cursor_advance(cursor);
+    if (strcmp(condition->column, "id") == 0) {
+        uint32_t lower, upper;
+        if (equality) {
+            path_init(&path, SCAN_INDEX_SEARCH, NULL, condition, 1,
+                      table->header->tree_height * COST_PAGE_READ + COST_ROW_CPU);
+            snprintf(path.description, sizeof(path.description), "primary key lookup (id =)");
+            consider_path(plan, best, &path);
+        } else if (condition_id_range(condition, &lower, &upper)) {
+            path_init(&path, SCAN_INDEX_RANGE, NULL, condition, rows,
+                      primary_range_cost(table, rows));
+            path.is_range = true;
+            path.used_statistics = stats != NULL;
+            snprintf(path.description, sizeof(path.description), "primary key range (id %s)",
+                     condition->operator);
+            consider_path(plan, best, &path);
+        }
+        return;
     }
     
-    free(cursor);
-    return count;
+    IndexRange range;
+    bool is_range = !equality && condition_index_range(condition, &range);
+    uint32_t needed = select_needed_columns(stmt);
+    SecondaryIndex* candidates[] = {
+        index_table_get(plan->table_indexes, condition->column, INDEX_TYPE_HASH),
+        index_table_get(plan->table_indexes, condition->column, INDEX_TYPE_BTREE)
+    };
+    for (uint32_t i = 0; i < sizeof(candidates) / sizeof(candidates[0]); i++) {
+        SecondaryIndex* index = candidates[i];
+        if (!index || (!equality && (!is_range || index->type != INDEX_TYPE_BTREE))) {
+            continue;
+        }
+        
+        bool covering = index_covers(index, needed) &&
+                        (is_range || strlen(condition->value) < INDEX_KEY_SIZE - 1);
+        ScanType scan_type = covering ? SCAN_INDEX_ONLY : is_range ? SCAN_INDEX_RANGE :
+                             SCAN_INDEX_SEARCH;
+        path_init(&path, scan_type, index, condition, rows,
+                  secondary_scan_cost(index, covering, table, rows));
+        path.is_range = is_range;
+        path.used_statistics = stats != NULL;
+        snprintf(path.description, sizeof(path.description), "%s%s on %s (%s)",
+                 covering ? "index-only " : "",
+                 index->type == INDEX_TYPE_HASH ? "hash index" : "B+tree index",
+                 condition->column, condition->operator);
+        consider_path(plan, best, &path);
+    }
 }
 
-QueryPlan* optimize_query(ParsedStatement* stmt, Table* table) {
+/*
+ * The ways to run an equi-join. A nested loop scans the right table
+ * for every left row. An index nested loop scans one table and probes
+ * the other's primary key or an index on its join column per row, in
+ * either direction. A hash join hashes the smaller table (by row count)
+ * and streams the larger past it. A merge join sorts both on the join
+ * column, unless both join on their primary keys and are in order.
+ */
+#define HASH_BUILD_ROW_COST (2 * COST_ROW_CPU)
+
+static void consider_join_paths(QueryPlan* plan, AccessPath* best, ParsedStatement* stmt,
+                                Table* left, Table* right, IndexManager* indexes,
+                                Schema* schema) {
+    JoinClause* join = stmt->join_clause;
+    uint64_t left_rows = left->header->row_count;
+    uint64_t right_rows = right->header->row_count;
+    uint32_t rows = join_rows(stmt, left, right, schema);
+    bool used_statistics = schema &&
+        (schema_get_column_stats(schema, left->name, join->left_column) ||
+         schema_get_column_stats(schema, right->name, join->right_column));
+    uint64_t scans = full_scan_cost(left) + full_scan_cost(right);
+    AccessPath path;
+    
+    path_init(&path, SCAN_NESTED_LOOP, NULL, NULL, rows,
+              full_scan_cost(left) + left_rows * full_scan_cost(right));
+    path.used_statistics = used_statistics;
+    snprintf(path.description, sizeof(path.description), "nested loop join");
+    consider_path(plan, best, &path);
+    
+    for (int left_inner = 0; left_inner < 2; left_inner++) {
+        Table* outer = left_inner ? right : left;
+        Table* inner = left_inner ? left : right;
+        const char* inner_column = left_inner ? join->left_column : join->right_column;
+        uint64_t outer_rows = outer->header->row_count;
+        uint32_t rows_per_probe = outer_rows ? (uint32_t)(rows / outer_rows) : 0;
+        
+        if (column_is_primary_key(schema, inner->name, inner_column)) {
+            path_init(&path, SCAN_INDEX_NESTED_LOOP, NULL, NULL, rows,
+                      full_scan_cost(outer) + fetch_cost(inner, outer_rows));
+            path.used_statistics = used_statistics;
+            path.join_left_inner = left_inner;
+            snprintf(path.description, sizeof(path.description),
+                     "index nested loop (%.24s primary key)", inner->name);
+            consider_path(plan, best, &path);
+        }
+        
+        IndexTable* inner_indexes = index_manager_table(indexes, inner->name);
+        IndexType types[] = {INDEX_TYPE_HASH, INDEX_TYPE_BTREE};
+        for (int i = 0; i < 2; i++) {
+            SecondaryIndex* index = index_table_get(inner_indexes, inner_column, types[i]);
+            if (!index) {
+                continue;
+            }
+            path_init(&path, SCAN_INDEX_NESTED_LOOP, index, NULL, rows,
+                      full_scan_cost(outer) +
+                      outer_rows * secondary_scan_cost(index, false, inner, rows_per_probe));
+            path.used_statistics = used_statistics;
+            path.join_left_inner = left_inner;
+            snprintf(path.description, sizeof(path.description), "index nested loop (%.24s %s)",
+                     inner->name, types[i] == INDEX_TYPE_HASH ? "hash index" : "B+tree");
+            consider_path(plan, best, &path);
+        }
+    }
+    
+    bool build_left = left_rows < right_rows;
+    path_init(&path, SCAN_HASH_JOIN, NULL, NULL, rows,
+              scans + (build_left ? left_rows : right_rows) * HASH_BUILD_ROW_COST +
+              (build_left ? right_rows : left_rows) * COST_ROW_CPU);
+    path.used_statistics = used_statistics;
+    path.join_left_inner = build_left;
+    snprintf(path.description, sizeof(path.description), "hash join (build %.32s)",
+             build_left ? left->name : right->name);
+    consider_path(plan, best, &path);
+    
+    bool presorted = column_is_primary_key(schema, left->name, join->left_column) &&
+                     column_is_primary_key(schema, right->name, join->right_column);
+    path_init(&path, SCAN_MERGE_JOIN, NULL, NULL, rows,
+              scans + (presorted ? 0 : sort_cost(left_rows) + sort_cost(right_rows)) +
+              (left_rows + right_rows) * COST_ROW_CPU);
+    path.used_statistics = used_statistics;
+    snprintf(path.description, sizeof(path.description), "%s join",
+             presorted ? "merge" : "sort-merge");
+    consider_path(plan, best, &path);
+}
+
+// Whether a JOIN is one ON equality between two tables, planned by consider_join_paths
+bool join_is_pairwise(const ParsedStatement* stmt) {
+    return stmt->has_join && stmt->num_join_tables == 2 && stmt->num_join_clauses == 1;
+}
+
+/*
+ * Multi-way joins are planned as left-deep trees: the rows joined so far
+ * are kept in memory and meet one more table per step, by nested loop,
+ * index nested loop, or a hash join built on either side. Each ON
+ * equality linking the new table divides the rows' product by the larger
+ * of its two distinct counts: ANALYZE's count, or a primary key's row
+ * count, and on the joined side at most the rows joined so far. When
+ * neither is known the larger side is taken to be a key, as for two
+ * tables. Every row a step produces costs COST_ROW_CPU to materialize.
+ */
+typedef struct {
+    ParsedStatement* stmt;
+    Table** tables;
+    IndexManager* indexes;
+    Schema* schema;
+    uint32_t num_tables;
+    bool connected;           // ON equalities link every table, so no step needs a cross product
+} JoinSearch;
+
+typedef struct {
+    bool valid;
+    double rows;
+    double cost;              // Of the tree up to and including the step
+    JoinStep step;
+} JoinCandidate;
+
+// The side of an ON clause on table `position` when the other side is in `mask`: 0 left, 1 right, -1 neither
+static int join_clause_side(const JoinClause* clause, uint32_t mask, uint32_t position) {
+    if (clause->left_position == (int)position && clause->right_position >= 0 &&
+        (mask & (1u << clause->right_position))) {
+        return 0;
+    }
+    if (clause->right_position == (int)position && clause->left_position >= 0 &&
+        (mask & (1u << clause->left_position))) {
+        return 1;
+    }
+    return -1;
+}
+
+// Distinct values of a table's join column; 0 if unknown
+static double join_column_distinct(JoinSearch* search, int position, const char* column) {
+    Table* table = search->tables[position];
+    const ColumnStats* stats = search->schema ?
+        schema_get_column_stats(search->schema, table->name, column) : NULL;
+    if (stats) {
+        return column_stats_distinct(stats, table->header->row_count);
+    }
+    return column_is_primary_key(search->schema, table->name, column) ?
+        table->header->row_count : 0;
+}
+
+static void join_candidate_keep(JoinCandidate* best, const JoinCandidate* candidate) {
+    if (!best->valid || candidate->cost < best->cost) {
+        *best = *candidate;
+    }
+}
+
+// The first step: a scan of one table
+static void join_scan_candidate(JoinSearch* search, uint32_t position, JoinCandidate* out) {
+    Table* table = search->tables[position];
+    memset(out, 0, sizeof(JoinCandidate));
+    out->valid = true;
+    out->rows = table->header->row_count;
+    out->cost = full_scan_cost(table);
+    out->step.table = position;
+    out->step.method = SCAN_FULL_TABLE;
+    out->step.clause = -1;
+    snprintf(out->step.description, sizeof(out->step.description), "SCAN %.48s", table->name);
+}
+
+// The cheapest way to join the rows of `outer` (the tables in mask) with table `position`
+static void join_step_candidate(JoinSearch* search, uint32_t mask, const JoinCandidate* outer,
+                                uint32_t position, JoinCandidate* out) {
+    Table* table = search->tables[position];
+    double table_rows = table->header->row_count;
+    double outer_rows = outer->rows;
+    
+    // Every linking equality filters; the first drives the step unless an index serves another
+    double rows = outer_rows * table_rows;
+    int first_clause = -1;
+    for (uint32_t i = 0; i < search->stmt->num_join_clauses; i++) {
+        const JoinClause* clause = &search->stmt->join_clause[i];
+        int side = join_clause_side(clause, mask, position);
+        if (side < 0) {
+            continue;
+        }
+        int outer_position = side ? clause->left_position : clause->right_position;
+        double inner_distinct = join_column_distinct(search, position,
+                                                     side ? clause->right_column : clause->left_column);
+        double outer_distinct = join_column_distinct(search, outer_position,
+                                                     side ? clause->left_column : clause->right_column);
+        if (inner_distinct == 0 && outer_distinct == 0) {
+            inner_distinct = table_rows;
+            outer_distinct = search->tables[outer_position]->header->row_count;
+        }
+        if (outer_distinct > outer_rows) {
+            outer_distinct = outer_rows;
+        }
+        double distinct = inner_distinct > outer_distinct ? inner_distinct : outer_distinct;
+        rows /= distinct > 1 ? distinct : 1;
+        if (first_clause < 0) {
+            first_clause = (int)i;
+        }
+    }
+    if (rows < 1 && outer_rows * table_rows >= 1) {
+        rows = 1;
+    }
+    
+    JoinCandidate candidate;
+    memset(out, 0, sizeof(JoinCandidate));
+    memset(&candidate, 0, sizeof(JoinCandidate));
+    candidate.valid = true;
+    candidate.rows = rows;
+    candidate.step.table = position;
+    candidate.step.index = NULL;
+    candidate.step.build_outer = false;
+    double base = outer->cost + rows * COST_ROW_CPU;
+    
+    char on[64] = "(cross product)";
+    if (first_clause >= 0) {
+        const JoinClause* clause = &search->stmt->join_clause[first_clause];
+        snprintf(on, sizeof(on), "on %.12s.%.12s = %.12s.%.12s", clause->left_table,
+                 clause->left_column, clause->right_table, clause->right_column);
+    }
+    
+    candidate.step.method = SCAN_NESTED_LOOP;
+    candidate.step.clause = first_clause;
+    candidate.cost = base + outer_rows * full_scan_cost(table);
+    snprintf(candidate.step.description, sizeof(candidate.step.description),
+             "NESTED LOOP JOIN %s", on);
+    snprintf(candidate.step.inner, sizeof(candidate.step.inner), "SCAN %.48s", table->name);
+    join_candidate_keep(out, &candidate);
+    if (first_clause < 0) {
+        return;
+    }
+    
+    candidate.step.method = SCAN_HASH_JOIN;
+    candidate.cost = base + full_scan_cost(table) + table_rows * HASH_BUILD_ROW_COST +
+                     outer_rows * COST_ROW_CPU;
+    snprintf(candidate.step.description, sizeof(candidate.step.description), "HASH JOIN %s", on);
+    snprintf(candidate.step.inner, sizeof(candidate.step.inner), "HASH %.48s", table->name);
+    join_candidate_keep(out, &candidate);
+    
+    candidate.step.build_outer = true;
+    candidate.cost = base + full_scan_cost(table) + outer_rows * HASH_BUILD_ROW_COST;
+    snprintf(candidate.step.description, sizeof(candidate.step.description),
+             "HASH JOIN (build outer) %s", on);
+    snprintf(candidate.step.inner, sizeof(candidate.step.inner), "SCAN %.48s", table->name);
+    join_candidate_keep(out, &candidate);
+    candidate.step.build_outer = false;
+    
+    // Probes of the table's primary key or an index on its side of any linking equality
+    IndexTable* indexes = index_manager_table(search->indexes, table->name);
+    for (uint32_t i = 0; i < search->stmt->num_join_clauses; i++) {
+        const JoinClause* clause = &search->stmt->join_clause[i];
+        int side = join_clause_side(clause, mask, position);
+        if (side < 0) {
+            continue;
+        }
+        const char* column = side ? clause->right_column : clause->left_column;
+        candidate.step.method = SCAN_INDEX_NESTED_LOOP;
+        candidate.step.clause = (int)i;
+        snprintf(candidate.step.description, sizeof(candidate.step.description),
+                 "INDEX NESTED LOOP JOIN on %.12s.%.12s = %.12s.%.12s", clause->left_table,
+                 clause->left_column, clause->right_table, clause->right_column);
+        
+        if (column_is_primary_key(search->schema, table->name, column)) {
+            candidate.step.index = NULL;
+            candidate.cost = base + outer_rows * (table->header->tree_height * COST_PAGE_READ +
+                                                  COST_ROW_CPU);
+            snprintf(candidate.step.inner, sizeof(candidate.step.inner),
+                     "PROBE %.32s (primary key)", table->name);
+            join_candidate_keep(out, &candidate);
+        }
+        
+        uint32_t rows_per_probe = (uint32_t)(outer_rows >= 1 ? rows / outer_rows : rows);
+        IndexType types[] = {INDEX_TYPE_HASH, INDEX_TYPE_BTREE};
+        for (int t = 0; t < 2; t++) {
+            SecondaryIndex* index = index_table_get(indexes, column, types[t]);
+            if (!index) {
+                continue;
+            }
+            candidate.step.index = index;
+            candidate.cost = base + outer_rows * secondary_scan_cost(index, false, table,
+                                                                     rows_per_probe);
+            snprintf(candidate.step.inner, sizeof(candidate.step.inner), "PROBE %.24s (%s on %.16s)",
+                     table->name, types[t] == INDEX_TYPE_HASH ? "hash index" : "B+tree", column);
+            join_candidate_keep(out, &candidate);
+        }
+    }
+}
+
+// Every table reachable from the first through ON equalities
+static bool join_graph_connected(JoinSearch* search) {
+    uint32_t all = (1u << search->num_tables) - 1;
+    uint32_t reached = 1;
+    for (bool grew = true; grew; ) {
+        grew = false;
+        for (uint32_t t = 0; t < search->num_tables; t++) {
+            for (uint32_t i = 0; !(reached & (1u << t)) && i < search->stmt->num_join_clauses; i++) {
+                if (join_clause_side(&search->stmt->join_clause[i], reached, t) >= 0) {
+                    reached |= 1u << t;
+                    grew = true;
+                }
+            }
+        }
+    }
+    return reached == all;
+}
+
+static bool join_linked(JoinSearch* search, uint32_t mask, uint32_t position) {
+    for (uint32_t i = 0; i < search->stmt->num_join_clauses; i++) {
+        if (join_clause_side(&search->stmt->join_clause[i], mask, position) >= 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Dynamic programming over subsets: the cheapest tree for each set of
+ * tables extends the cheapest tree for the set without one of them.
+ * Subsets are visited in increasing order, so each is final before it
+ * is extended.
+ */
+static JoinCandidate join_order_exhaustive(JoinSearch* search, JoinStep* steps) {
+    uint32_t n = search->num_tables;
+    uint32_t all = (1u << n) - 1;
+    JoinCandidate* best = calloc(all + 1, sizeof(JoinCandidate));
+    for (uint32_t t = 0; t < n; t++) {
+        join_scan_candidate(search, t, &best[1u << t]);
+    }
+    
+    for (uint32_t mask = 1; mask < all; mask++) {
+        if (!best[mask].valid) {
+            continue;
+        }
+        for (uint32_t t = 0; t < n; t++) {
+            if ((mask & (1u << t)) || (search->connected && !join_linked(search, mask, t))) {
+                continue;
+            }
+            JoinCandidate candidate;
+            join_step_candidate(search, mask, &best[mask], t, &candidate);
+            join_candidate_keep(&best[mask | (1u << t)], &candidate);
+        }
+    }
+    
+    JoinCandidate result = best[all];
+    for (uint32_t mask = all, k = n; k-- > 0; ) {
+        steps[k] = best[mask].step;
+        steps[k].estimated_rows = best[mask].rows > UINT32_MAX ? UINT32_MAX : (uint32_t)best[mask].rows;
+        steps[k].estimated_cost = best[mask].cost > UINT32_MAX ? UINT32_MAX : (uint32_t)best[mask].cost;
+        mask &= ~(1u << steps[k].table);
+    }
+    free(best);
+    return result;
+}
+
+// Start from the smallest table, then add whichever table is cheapest to join next
+static JoinCandidate join_order_greedy(JoinSearch* search, JoinStep* steps) {
+    uint32_t first = 0;
+    for (uint32_t t = 1; t < search->num_tables; t++) {
+        if (search->tables[t]->header->row_count < search->tables[first]->header->row_count) {
+            first = t;
+        }
+    }
+    
+    JoinCandidate current;
+    join_scan_candidate(search, first, &current);
+    uint32_t mask = 1u << first;
+    for (uint32_t k = 0; ; k++) {
+        steps[k] = current.step;
+        steps[k].estimated_rows = current.rows > UINT32_MAX ? UINT32_MAX : (uint32_t)current.rows;
+        steps[k].estimated_cost = current.cost > UINT32_MAX ? UINT32_MAX : (uint32_t)current.cost;
+        if (k + 1 == search->num_tables) {
+            return current;
+        }
+        
+        JoinCandidate next;
+        memset(&next, 0, sizeof(JoinCandidate));
+        for (uint32_t t = 0; t < search->num_tables; t++) {
+            if ((mask & (1u << t)) || (search->connected && !join_linked(search, mask, t))) {
+                continue;
+            }
+            JoinCandidate candidate;
+            join_step_candidate(search, mask, &current, t, &candidate);
+            join_candidate_keep(&next, &candidate);
+        }
+        current = next;
+        mask |= 1u << current.step.table;
+    }
+}
+
+static void consider_join_order(QueryPlan* plan, AccessPath* best, ParsedStatement* stmt,
+                                Table** tables, IndexManager* indexes, Schema* schema) {
+    JoinSearch search = {stmt, tables, indexes, schema, stmt->num_join_tables, false};
+    search.connected = join_graph_connected(&search);
+    
+    plan->join_greedy = search.num_tables > JOIN_DP_MAX_TABLES;
+    JoinCandidate result = plan->join_greedy ? join_order_greedy(&search, plan->join_steps) :
+                                               join_order_exhaustive(&search, plan->join_steps);
+    plan->num_join_steps = search.num_tables;
+    
+    AccessPath path;
+    path_init(&path, result.step.method, NULL, NULL,
+              result.rows > UINT32_MAX ? UINT32_MAX : (uint32_t)result.rows, (uint64_t)result.cost);
+    for (uint32_t i = 0; i < stmt->num_join_clauses && schema; i++) {
+        path.used_statistics = path.used_statistics ||
+            schema_get_column_stats(schema, stmt->join_clause[i].left_table,
+                                    stmt->join_clause[i].left_column) ||
+            schema_get_column_stats(schema, stmt->join_clause[i].right_table,
+                                    stmt->join_clause[i].right_column);
+    }
+    snprintf(path.description, sizeof(path.description), "left-deep join of %u tables",
+             search.num_tables);
+    consider_path(plan, best, &path);
+}
+
+// Whole-table COUNT of any column, or SUM/AVG/MIN/MAX of id ("*" meaning id)
+static bool aggregate_has_summary(const ParsedStatement* stmt) {
+    if (!stmt->has_aggregation || stmt->has_where || stmt->has_join) {
+        return false;
+    }
+    return stmt->agg_type == AGG_COUNT || strcmp(stmt->agg_column, "id") == 0 ||
+           strcmp(stmt->agg_column, "*") == 0;
+}
+
+/*
+ * join_tables are a JOIN's tables: the left and right of its ON equality
+ * for a pairwise join, otherwise each table by its position in the
+ * statement; NULL without a JOIN. schema holds the ANALYZE statistics;
+ * NULL plans without them.
+ *
+ * A SELECT weighs every access path: a full scan; for each condition of
+ * an AND list (or a lone condition), the primary key or each index on
+ * its column; and the bitmap indexes. The cheapest in page reads and
+ * per-row CPU is the plan, and the executor follows it exactly.
+ */
+QueryPlan* optimize_query(ParsedStatement* stmt, Table* table, Table** join_tables,
+                          IndexManager* indexes, Schema* schema) {
     QueryPlan* plan = malloc(sizeof(QueryPlan));
     memset(plan, 0, sizeof(QueryPlan));
     
-    // Get actual table size for better estimates
-    uint32_t total_rows = count_table_rows(table);
+    // Maintained by the B+tree, so planning never walks the table
+    uint32_t total_rows = table->header->row_count;
+    uint32_t tree_height = table->header->tree_height;
+    uint32_t point_cost = tree_height * COST_PAGE_READ + COST_ROW_CPU;
     
-    if (stmt->type == STMT_SELECT) {
-        // Check if we can use index (B-tree search by ID)
-        if (stmt->has_where && strcmp(stmt->where_clause->column, "id") == 0) {
-            plan->scan_type = SCAN_INDEX_SEARCH;
-            plan->index_column = strdup("id");
-            plan->estimated_rows = 1;  // Expect to find 0 or 1 row
-            
-            // Cost: log(N) for tree traversal
-            uint32_t tree_height = 1;
-            uint32_t temp = total_rows;
-            while (temp > LEAF_NODE_MAX_CELLS) {
-                tree_height++;
-                temp /= LEAF_NODE_MAX_CELLS;
-            }
-            plan->estimated_cost = tree_height * 5;
-            plan->uses_index = true;
+    // Resolve the table's indexes once; execution uses these handles
+    plan->table_indexes = index_manager_table(indexes, table->name);
+    
+    AccessPath best;
+    memset(&best, 0, sizeof(AccessPath));
+    
+    if (stmt->type == STMT_SELECT && stmt->has_join && join_tables) {
+        if (join_is_pairwise(stmt)) {
+            consider_join_paths(plan, &best, stmt, join_tables[0], join_tables[1], indexes, schema);
         } else {
-            // Full table scan
-            plan->scan_type = SCAN_FULL_TABLE;
-            plan->index_column = NULL;
-            plan->estimated_rows = total_rows;
-            
-            // Cost: O(N) - must scan every row
-            plan->estimated_cost = total_rows > 0 ? total_rows * 5 : 1;
-            plan->uses_index = false;
+            consider_join_order(plan, &best, stmt, join_tables, indexes, schema);
         }
-    } else if (stmt->type == STMT_INSERT) {
-        plan->scan_type = SCAN_INDEX_SEARCH;
-        plan->index_column = strdup("id");
-        plan->estimated_rows = 1;
+    } else if (stmt->type == STMT_SELECT) {
+        AccessPath path;
+        path_init(&path, SCAN_FULL_TABLE, NULL, NULL, total_rows, full_scan_cost(table));
+        snprintf(path.description, sizeof(path.description), "full table scan");
+        consider_path(plan, &best, &path);
         
-        // Cost: log(N) to find position + write
-        uint32_t tree_height = 1;
-        uint32_t temp = total_rows;
-        while (temp > LEAF_NODE_MAX_CELLS) {
-            tree_height++;
-            temp /= LEAF_NODE_MAX_CELLS;
-        }
-        plan->estimated_cost = tree_height * 5 + 10;
-        plan->uses_index = true;
-    } else if (stmt->type == STMT_UPDATE) {
-        if (stmt->has_where && strcmp(stmt->where_clause->column, "id") == 0) {
-            plan->scan_type = SCAN_INDEX_SEARCH;
-            plan->index_column = strdup("id");
-            plan->estimated_rows = 1;
-            
-            uint32_t tree_height = 1;
-            uint32_t temp = total_rows;
-            while (temp > LEAF_NODE_MAX_CELLS) {
-                tree_height++;
-                temp /= LEAF_NODE_MAX_CELLS;
+        // The B+tree keeps the row count and id aggregates current, so an
+        // aggregate over the whole table costs one look at its header
+        if (aggregate_has_summary(stmt)) {
+            path_init(&path, SCAN_AGGREGATE_SUMMARY, NULL, NULL, 1, COST_ROW_CPU);
+            snprintf(path.description, sizeof(path.description), "maintained aggregates");
+            consider_path(plan, &best, &path);
+        }
+        
+        // Any condition every matching row satisfies (a term of the top
+        // AND) can drive the scan; the rest of the clause is a residual
+        // filter, checked on each row it yields
+        if (stmt->has_where) {
+            for (Condition* condition = stmt->where_clause; condition; condition = condition->next) {
+                if (!condition->conjunct) {
+                    continue;
+                }
+                const ColumnStats* stats = schema ?
+                    schema_get_column_stats(schema, table->name, condition->column) : NULL;
+                consider_condition_paths(plan, &best, stmt, table, condition, stats);
             }
-            plan->estimated_cost = tree_height * 5 + 15;
-            plan->uses_index = true;
-        } else {
-            plan->scan_type = SCAN_FULL_TABLE;
-            plan->index_column = NULL;
-            plan->estimated_rows = total_rows;
-            plan->estimated_cost = total_rows * 10 + 50;
-            plan->uses_index = false;
-        }
-    } else if (stmt->type == STMT_DELETE) {
-        if (stmt->has_where && strcmp(stmt->where_clause->column, "id") == 0) {
-            plan->scan_type = SCAN_INDEX_SEARCH;
-            plan->index_column = strdup("id");
-            plan->estimated_rows = 1;
+        }
+        
+        // Bitmaps combine in memory; the rows they select are fetched by id
+        // unless the bitmaps alone answer a COUNT or an id list
+        uint32_t bitmap_rows = 0;
+        bool bitmap_exact = false;
+        SecondaryIndex** bitmaps = choose_bitmap_indexes(stmt, plan->table_indexes, total_rows,
+                                                         &bitmap_rows, &bitmap_exact);
+        bool bitmap_ids_only = bitmap_exact &&
+            (select_needed_columns(stmt) == INDEX_COLUMN_ID ||
+             (stmt->has_aggregation && stmt->agg_type == AGG_COUNT));
+        if (bitmaps) {
+            char columns[256];
+            bitmap_columns(stmt, bitmaps, columns, sizeof(columns));
+            path_init(&path, SCAN_BITMAP, NULL, NULL, bitmap_rows,
+                      (uint64_t)bitmap_rows * COST_ROW_CPU +
+                      (bitmap_ids_only ? 0 : fetch_cost(table, bitmap_rows)));
+            snprintf(path.description, sizeof(path.description), "bitmap %s on %.48s",
+                     stmt->where_is_or ? "OR" : "AND", columns);
+            consider_path(plan, &best, &path);
             
-            uint32_t tree_height = 1;
-            uint32_t temp = total_rows;
-            while (temp > LEAF_NODE_MAX_CELLS) {
-                tree_height++;
-                temp /= LEAF_NODE_MAX_CELLS;
+            if (best.scan_type == SCAN_BITMAP) {
+                plan->condition_bitmaps = bitmaps;
+                plan->bitmap_exact = bitmap_exact;
+                plan->bitmap_ids_only = bitmap_ids_only;
+                plan->index_column = strdup(columns);
+            } else {
+                free(bitmaps);
             }
-            plan->estimated_cost = tree_height * 5 + 20;
-            plan->uses_index = true;
-        } else {
-            plan->scan_type = SCAN_FULL_TABLE;
-            plan->index_column = NULL;
-            plan->estimated_rows = total_rows;
-            plan->estimated_cost = total_rows * 10 + 100;
-            plan->uses_index = false;
         }
+    } else if (stmt->type == STMT_INSERT) {
+        // Descend to the leaf, then write it
+        path_init(&best, SCAN_INDEX_SEARCH, NULL, NULL, 1, point_cost + COST_PAGE_READ);
+        snprintf(best.description, sizeof(best.description), "primary key insert");
+        consider_path(plan, &best, &best);
+        plan->index_column = strdup("id");
+    } else if (where_is_id_equality(stmt)) {
+        // UPDATE or DELETE by id: a probe and one page write
+        path_init(&best, SCAN_INDEX_SEARCH, NULL, stmt->where_clause, 1,
+                  point_cost + COST_PAGE_READ);
+        snprintf(best.description, sizeof(best.description), "primary key lookup (id =)");
+        consider_path(plan, &best, &best);
+    } else {
+        path_init(&best, SCAN_FULL_TABLE, NULL, NULL, total_rows, full_scan_cost(table));
+        snprintf(best.description, sizeof(best.description), "full table scan");
+        consider_path(plan, &best, &best);
+    }
+    
+    plan->scan_type = best.scan_type;
+    plan->secondary_index = best.secondary_index;
+    plan->condition = best.condition;
+    plan->is_range = best.is_range;
+    plan->estimated_rows = best.estimated_rows;
+    plan->estimated_cost = best.estimated_cost;
+    plan->used_statistics = best.used_statistics;
+    plan->join_left_inner = best.join_left_inner;
+    plan->uses_index = best.scan_type != SCAN_FULL_TABLE && best.scan_type != SCAN_NESTED_LOOP &&
+                       best.scan_type != SCAN_HASH_JOIN && best.scan_type != SCAN_MERGE_JOIN;
+    if (best.condition) {
+        plan->index_column = strdup(best.condition->column);
+    } else if (best.scan_type == SCAN_INDEX_NESTED_LOOP && plan->num_join_steps == 0) {
+        plan->index_column = strdup(best.join_left_inner ? stmt->join_clause->left_column :
+                                    stmt->join_clause->right_column);
     }
     
     return plan;
 }
 
-void print_query_plan(QueryPlan* plan) {
-    printf("\n=== Query Plan ===\n");
-    
+// The plan's access path as EXPLAIN names it
+const char* query_plan_scan_name(QueryPlan* plan) {
+    bool hash = plan->secondary_index && plan->secondary_index->type == INDEX_TYPE_HASH;
     switch (plan->scan_type) {
         case SCAN_FULL_TABLE:
-            printf("Scan Type: FULL TABLE SCAN\n");
-            break;
+            return "FULL TABLE SCAN";
         case SCAN_INDEX_SEARCH:
-            printf("Scan Type: INDEX SEARCH (B+Tree)\n");
-            break;
+            return hash ? "INDEX SEARCH (Hash)" : "INDEX SEARCH (B+Tree)";
         case SCAN_INDEX_RANGE:
-            printf("Scan Type: INDEX RANGE SCAN\n");
-            break;
+            return "INDEX RANGE SCAN (B+Tree)";
+        case SCAN_INDEX_ONLY:
+            return hash ? "INDEX ONLY SCAN (Hash)" : "INDEX ONLY SCAN (B+Tree)";
+        case SCAN_BITMAP:
+            return "BITMAP INDEX SCAN";
+        case SCAN_NESTED_LOOP:
+            return "NESTED LOOP JOIN";
+        case SCAN_INDEX_NESTED_LOOP:
+            return "INDEX NESTED LOOP JOIN";
+        case SCAN_HASH_JOIN:
+            return "HASH JOIN";
+        case SCAN_MERGE_JOIN:
+            return "MERGE JOIN";
+        case SCAN_AGGREGATE_SUMMARY:
+            return "AGGREGATE SUMMARY";
+    }
+    return "UNKNOWN";
+}
+
+/*
+ * A multi-way join's tree from the last step down: each join over the
+ * steps before it and the table it added, the first table at the bottom
+ */
+static void print_join_tree(QueryPlan* plan, uint32_t step, int depth) {
+    JoinStep* join = &plan->join_steps[step];
+    printf("%*s-> %-*s rows %-8u cost %u\n", depth * 2, "", 60 - depth * 2, join->description,
+           join->estimated_rows, join->estimated_cost);
+    if (step > 0) {
+        print_join_tree(plan, step - 1, depth + 1);
+        printf("%*s-> %s\n", (depth + 1) * 2, "", join->inner);
     }
+}
+
+void print_query_plan(QueryPlan* plan) {
+    printf("\n=== Query Plan ===\n");
+    printf("Scan Type: %s\n", query_plan_scan_name(plan));
     
-    if (plan->index_column) {
+    if (plan->num_join_steps > 0) {
+        printf("Join Order: %s over %u tables\n",
+               plan->join_greedy ? "greedy" : "dynamic programming", plan->num_join_steps);
+    } else if (plan->scan_type == SCAN_BITMAP) {
+        printf("Index Used: %s (Bitmap%s)\n", plan->index_column,
+               plan->bitmap_exact ? ", Exact" : ", Rechecked");
+    } else if (plan->scan_type == SCAN_AGGREGATE_SUMMARY) {
+        printf("Index Used: NONE (Table Header Aggregates)\n");
+    } else if (plan->secondary_index) {
+        printf("Index Used: %s (Secondary %s%s)\n", plan->index_column,
+               plan->secondary_index->type == INDEX_TYPE_HASH ? "Hash Index" : "B+Tree",
+               plan->scan_type == SCAN_INDEX_ONLY ? ", Covering" : "");
+    } else if (plan->index_column) {
         printf("Index Used: %s (Primary Key)\n", plan->index_column);
     } else {
         printf("Index Used: NONE (Sequential Scan)\n");
     }
     
-    printf("Estimated Rows: %u\n", plan->estimated_rows);
+    printf("Estimated Rows: %u%s\n", plan->estimated_rows,
+           plan->used_statistics ? " (from ANALYZE statistics)" : "");
     printf("Estimated Cost: %u", plan->estimated_cost);
     
     // Add interpretation
-    if (plan->uses_index) {
+    if (plan->num_join_steps > 0) {
+        printf(" (Left-Deep Join Tree)\n");
+    } else if (plan->scan_type == SCAN_BITMAP) {
+        printf(" (O(k) - Bitmap AND/OR)\n");
+    } else if (plan->scan_type == SCAN_NESTED_LOOP) {
+        printf(" (O(n * m) - Nested Loop)\n");
+    } else if (plan->scan_type == SCAN_INDEX_NESTED_LOOP) {
+        printf(" (O(n log m) - Index Probe per Row)\n");
+    } else if (plan->scan_type == SCAN_HASH_JOIN) {
+        printf(" (O(n + m) - Hash Build and Probe)\n");
+    } else if (plan->scan_type == SCAN_MERGE_JOIN) {
+        printf(" (O(n log n + m log m) - Sort and Merge)\n");
+    } else if (plan->scan_type == SCAN_AGGREGATE_SUMMARY) {
+        printf(" (O(1) - Maintained Aggregates)\n");
+    } else if (plan->secondary_index && plan->secondary_index->type == INDEX_TYPE_HASH) {
+        printf(" (O(1) - Hash Probe)\n");
+    } else if (plan->is_range) {
+        printf(" (O(log n + k) - Range Scan)\n");
+    } else if (plan->uses_index) {
         printf(" (O(log n) - Binary Search)\n");
     } else {
         printf(" (O(n) - Linear Scan)\n");
     }
     
+    // The alternatives the plan won against, the chosen one starred
+    if (plan->num_paths > 1) {
+        printf("Access Paths:\n");
+        for (uint32_t i = 0; i < plan->num_paths; i++) {
+            AccessPath* path = &plan->paths[i];
+            bool chosen = path->scan_type == plan->scan_type &&
+                          path->secondary_index == plan->secondary_index &&
+                          path->condition == plan->condition && path->is_range == plan->is_range &&
+                          path->join_left_inner == plan->join_left_inner;
+            printf("  %c %-44s rows %-8u cost %u\n", chosen ? '*' : ' ', path->description,
+                   path->estimated_rows, path->estimated_cost);
+        }
+    }
+    
+    if (plan->num_join_steps > 0) {
+        printf("Join Tree:\n");
+        print_join_tree(plan, plan->num_join_steps - 1, 1);
+    }
+    
     // Performance warning
     if (plan->scan_type == SCAN_FULL_TABLE && plan->estimated_rows > 100) {
         printf("\n⚠️  WARNING: Full table scan on large table!\n");
@@ -152,46 +1045,101 @@ void print_query_plan(QueryPlan* plan) {
     printf("==================\n\n");
 }
 
-void free_query_plan(QueryPlan* plan) {
-    if (!plan) return;
-    if (plan->index_column) {
-        free(plan->index_column);
+static double profile_elapsed_ms(struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1e3 + (now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+// Start measuring an operator; NULL unless EXPLAIN ANALYZE is running the plan
+OperatorProfile* profile_begin(QueryPlan* plan, const char* name, uint32_t estimated_rows) {
+    if (!plan->analyze || plan->num_operators >= MAX_PLAN_OPERATORS) {
+        return NULL;
     }
-    free(plan);
+    
+    OperatorProfile* op = &plan->operators[plan->num_operators++];
+    memset(op, 0, sizeof(OperatorProfile));
+    snprintf(op->name, sizeof(op->name), "%s", name);
+    op->estimated_rows = estimated_rows;
+    op->pages_at_start = pager_counters();
+    clock_gettime(CLOCK_MONOTONIC, &op->started);
+    return op;
 }
 
-QueryStats* stats_create() {
-    QueryStats* stats = malloc(sizeof(QueryStats));
-    memset(stats, 0, sizeof(QueryStats));
-    return stats;
+// Start measuring the plan's access path, named as EXPLAIN shows it
+OperatorProfile* profile_begin_scan(QueryPlan* plan) {
+    char name[64];
+    if (plan->index_column) {
+        snprintf(name, sizeof(name), "%s on %s", query_plan_scan_name(plan), plan->index_column);
+    } else {
+        snprintf(name, sizeof(name), "%s", query_plan_scan_name(plan));
+    }
+    return profile_begin(plan, name, plan->estimated_rows);
 }
 
-void stats_update(QueryStats* stats, QueryPlan* plan, uint32_t rows_returned) {
-    if (plan->scan_type == SCAN_FULL_TABLE) {
-        stats->full_scans++;
-    } else if (plan->scan_type == SCAN_INDEX_SEARCH) {
-        stats->index_searches++;
+void profile_end(OperatorProfile* op, uint64_t actual_rows, uint64_t rows_removed) {
+    if (!op) {
+        return;
     }
     
-    stats->rows_scanned += plan->estimated_rows;
-    stats->rows_returned += rows_returned;
+    op->milliseconds = profile_elapsed_ms(&op->started);
+    PagerCounters now = pager_counters();
+    op->pages.hits = now.hits - op->pages_at_start.hits;
+    op->pages.misses = now.misses - op->pages_at_start.misses;
+    op->pages.reads = now.reads - op->pages_at_start.reads;
+    op->actual_rows = actual_rows;
+    op->rows_removed = rows_removed;
 }
 
-void stats_print(QueryStats* stats) {
-    printf("\n=== Query Statistics ===\n");
-    printf("Full Table Scans: %u\n", stats->full_scans);
-    printf("Index Searches: %u\n", stats->index_searches);
-    printf("Total Rows Scanned: %u\n", stats->rows_scanned);
-    printf("Total Rows Returned: %u\n", stats->rows_returned);
+/*
+ * The operators EXPLAIN ANALYZE measured, as a tree from the output
+ * down to the scan, with estimated and actual rows side by side. An
+ * estimate off by 10x or more either way is flagged.
+ */
+#define PROFILE_MISESTIMATE_FACTOR 10.0
+
+void print_plan_profile(QueryPlan* plan, double total_ms, uint32_t rows_returned) {
+    printf("=== Execution ===\n");
+    printf("%-44s %9s %9s %9s %9s %7s %6s\n", "Operator", "Est Rows", "Rows", "Time ms",
+           "Hits", "Misses", "Reads");
     
-    if (stats->rows_scanned > 0) {
-        float efficiency = (float)stats->rows_returned / stats->rows_scanned * 100;
-        printf("Scan Efficiency: %.2f%%\n", efficiency);
+    for (uint32_t depth = 0; depth < plan->num_operators; depth++) {
+        OperatorProfile* op = &plan->operators[plan->num_operators - 1 - depth];
+        char label[96];
+        snprintf(label, sizeof(label), "%*s-> %s", (int)depth * 2, "", op->name);
+        char estimate[16] = "-";
+        if (op->estimated_rows != PROFILE_NO_ESTIMATE) {
+            snprintf(estimate, sizeof(estimate), "%u", op->estimated_rows);
+        }
+        printf("%-44s %9s %9llu %9.3f %9llu %7llu %6llu", label, estimate,
+               (unsigned long long)op->actual_rows, op->milliseconds,
+               (unsigned long long)op->pages.hits, (unsigned long long)op->pages.misses,
+               (unsigned long long)op->pages.reads);
+        
+        if (op->estimated_rows != PROFILE_NO_ESTIMATE) {
+            double estimated = op->estimated_rows > 0 ? op->estimated_rows : 1;
+            double actual = op->actual_rows > 0 ? (double)op->actual_rows : 1;
+            double factor = estimated > actual ? estimated / actual : actual / estimated;
+            if (factor >= PROFILE_MISESTIMATE_FACTOR) {
+                printf("  (%s by %.0fx)", estimated > actual ? "over" : "under", factor);
+            }
+        }
+        printf("\n");
+        if (op->rows_removed > 0) {
+            printf("%*s   Rows removed by filter: %llu\n", (int)depth * 2, "",
+                   (unsigned long long)op->rows_removed);
+        }
     }
     
-    printf("========================\n\n");
+    printf("Execution Time: %.3f ms, %u rows returned\n", total_ms, rows_returned);
+    printf("==================\n\n");
 }
 
-void stats_free(QueryStats* stats) {
-    free(stats);
+void free_query_plan(QueryPlan* plan) {
+    if (!plan) return;
+    if (plan->index_column) {
+        free(plan->index_column);
+    }
+    free(plan->condition_bitmaps);
+    free(plan);
 }
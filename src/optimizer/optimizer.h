@@ -3,37 +3,121 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <time.h>
 #include "../parser/parser.h"
 #include "../storage/table.h"
+#include "../index/secondary_index.h"
 
 typedef enum {
     SCAN_FULL_TABLE,
     SCAN_INDEX_SEARCH,
-    SCAN_INDEX_RANGE
+    SCAN_INDEX_RANGE,
+    SCAN_INDEX_ONLY,     // Answered from a covering secondary index alone
+    SCAN_BITMAP,         // AND/OR of bitmap indexes, then rows by id
+    SCAN_NESTED_LOOP,    // JOIN: the right table scanned for each left row
+    SCAN_INDEX_NESTED_LOOP,  // JOIN: the inner table probed by key for each outer row
+    SCAN_HASH_JOIN,      // JOIN: the smaller table hashed, the other streamed past it
+    SCAN_MERGE_JOIN,     // JOIN: both tables in join column order, merged
+    SCAN_AGGREGATE_SUMMARY  // COUNT/SUM/AVG/MIN/MAX(id) read from the table header's aggregates
 } ScanType;
 
+#define MAX_ACCESS_PATHS 16
+
+// Cost units: one page read, and examining one row or index entry
+#define COST_PAGE_READ 4
+#define COST_ROW_CPU 1
+
+/*
+ * One way of reading a table for a statement. Costs are in page reads
+ * (COST_PAGE_READ each) plus CPU per row or entry examined (COST_ROW_CPU).
+ */
+typedef struct {
+    ScanType scan_type;
+    SecondaryIndex* secondary_index;  // NULL for the primary key or a full scan
+    Condition* condition;             // WHERE condition that drives the path, NULL if none
+    bool is_range;
+    uint32_t estimated_rows;
+    uint32_t estimated_cost;
+    bool used_statistics;
+    bool join_left_inner;             // JOIN: the left table is probed or hashed, not the right
+    char description[64];
+} AccessPath;
+
+/*
+ * One step of a multi-way join's left-deep tree: the rows joined so far
+ * meet one more table. The first step just scans its table.
+ */
+typedef struct {
+    uint32_t table;                   // Position among the statement's join tables
+    ScanType method;                  // SCAN_FULL_TABLE for the first step, then a join kind
+    SecondaryIndex* index;            // INDEX NESTED LOOP: the probed index, NULL for the primary key
+    int clause;                       // ON clause that drives the step, -1 for a cross product
+    bool build_outer;                 // HASH JOIN: the rows so far are hashed, not the table
+    uint32_t estimated_rows;          // Rows after the step
+    uint32_t estimated_cost;          // ...and the cost of the tree up to it
+    char description[96];             // The join, as EXPLAIN shows it
+    char inner[64];                   // How the table is read
+} JoinStep;
+
+// Left-deep orders are enumerated exhaustively up to this many tables, greedily beyond
+#define JOIN_DP_MAX_TABLES 6
+
+#define MAX_PLAN_OPERATORS (MAX_JOIN_TABLES + 1)
+#define PROFILE_NO_ESTIMATE UINT32_MAX
+
+// What one operator did when EXPLAIN ANALYZE ran the plan
+typedef struct {
+    char name[64];
+    uint32_t estimated_rows;          // PROFILE_NO_ESTIMATE if the planner made none
+    uint64_t actual_rows;
+    uint64_t rows_removed;            // Produced but rejected by WHERE or the join condition
+    double milliseconds;              // The operator's own time, not its input's
+    PagerCounters pages;              // Page requests while it ran
+    struct timespec started;
+    PagerCounters pages_at_start;
+} OperatorProfile;
+
 typedef struct {
     ScanType scan_type;
     char* index_column;
+    SecondaryIndex* secondary_index;  // NULL when the primary key is used
+    IndexTable* table_indexes;        // Indexes the statement maintains, NULL if none
+    bool is_range;                    // Ordered scan over an IndexRange, not a probe
+    SecondaryIndex** condition_bitmaps;  // SCAN_BITMAP: each WHERE condition's bitmap index, or NULL
+    bool bitmap_exact;                // The bitmaps alone decide the WHERE clause
+    bool bitmap_ids_only;             // ...and the query reads only ids (or counts), so no row is fetched
     uint32_t estimated_rows;
     uint32_t estimated_cost;
     bool uses_index;
+    bool used_statistics;             // Row estimate came from ANALYZE statistics
+    Condition* condition;             // WHERE condition the access path is driven by, NULL if none
+    bool join_left_inner;             // INDEX NESTED LOOP probes, HASH JOIN builds on, the left table
+    AccessPath paths[MAX_ACCESS_PATHS];  // Every path considered; the cheapest is the plan
+    uint32_t num_paths;
+    JoinStep join_steps[MAX_JOIN_TABLES];  // Multi-way JOIN: the tree, in execution order
+    uint32_t num_join_steps;
+    bool join_greedy;                 // ...chosen greedily, as it joins too many tables to enumerate
+    
+    bool analyze;                     // EXPLAIN ANALYZE: run and measure, discard result rows
+    uint64_t rows_examined;           // Rows the access path produced
+    uint64_t rows_matched;            // ...and those that satisfied WHERE
+    OperatorProfile operators[MAX_PLAN_OPERATORS];  // In execution order, the scan first
+    uint32_t num_operators;
 } QueryPlan;
 
-typedef struct {
-    uint32_t full_scans;
-    uint32_t index_searches;
-    uint32_t rows_scanned;
-    uint32_t rows_returned;
-} QueryStats;
-
 // Function declarations
-QueryPlan* optimize_query(ParsedStatement* stmt, Table* table);
+QueryPlan* optimize_query(ParsedStatement* stmt, Table* table, Table** join_tables,
+                          IndexManager* indexes, Schema* schema);
+bool join_is_pairwise(const ParsedStatement* stmt);
+bool condition_index_range(const Condition* condition, IndexRange* range);
+bool condition_id_range(const Condition* condition, uint32_t* lower, uint32_t* upper);
+bool column_is_primary_key(Schema* schema, const char* table_name, const char* column);
+const char* query_plan_scan_name(QueryPlan* plan);
 void print_query_plan(QueryPlan* plan);
+OperatorProfile* profile_begin(QueryPlan* plan, const char* name, uint32_t estimated_rows);
+OperatorProfile* profile_begin_scan(QueryPlan* plan);
+void profile_end(OperatorProfile* op, uint64_t actual_rows, uint64_t rows_removed);
+void print_plan_profile(QueryPlan* plan, double total_ms, uint32_t rows_returned);
 void free_query_plan(QueryPlan* plan);
-QueryStats* stats_create();
-void stats_update(QueryStats* stats, QueryPlan* plan, uint32_t rows_returned);
-void stats_print(QueryStats* stats);
-void stats_free(QueryStats* stats);
 
 #endif // OPTIMIZER_H
@@ -0,0 +1,352 @@
+#include "plan_cache.h"
+#include "../transaction/checksum.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#define FINGERPRINT_MAX_TOKENS 256
+
+PlanCache* plan_cache_create(void) {
+    PlanCache* cache = malloc(sizeof(PlanCache));
+    memset(cache, 0, sizeof(PlanCache));
+    for (uint32_t i = 0; i < PLAN_CACHE_BUCKETS; i++) {
+        cache->buckets[i] = -1;
+    }
+    return cache;
+}
+
+void plan_cache_free(PlanCache* cache) {
+    if (!cache) {
+        return;
+    }
+    plan_cache_invalidate(cache);
+    free(cache);
+}
+
+/*
+ * Whether token i is a literal value rather than syntax or a name: the
+ * three values of INSERT, or whatever follows a comparison, LIKE,
+ * BETWEEN (and its AND) or LIMIT
+ */
+static bool token_is_literal(const TokenType* types, uint32_t i) {
+    TokenType type = types[i];
+    if (type != TOKEN_NUMBER && type != TOKEN_STRING && type != TOKEN_IDENTIFIER) {
+        return false;
+    }
+    if (types[0] == TOKEN_INSERT) {
+        return i >= 1 && i <= 3;
+    }
+    if (i == 0) {
+        return false;
+    }
+    
+    switch (types[i - 1]) {
+        case TOKEN_EQUALS:
+        case TOKEN_NOT_EQUALS:
+        case TOKEN_LESS:
+        case TOKEN_LESS_EQUALS:
+        case TOKEN_GREATER:
+        case TOKEN_GREATER_EQUALS:
+        case TOKEN_LIKE:
+        case TOKEN_BETWEEN:
+        case TOKEN_LIMIT:
+            return true;
+        case TOKEN_AND:
+            return i >= 3 && types[i - 3] == TOKEN_BETWEEN;
+        default:
+            return false;
+    }
+}
+
+static bool key_append(char* key, size_t* used, const char* text) {
+    size_t length = strlen(text);
+    if (*used + length + 2 > PLAN_CACHE_KEY_SIZE) {
+        return false;
+    }
+    key[(*used)++] = ' ';
+    memcpy(key + *used, text, length + 1);
+    *used += length;
+    return true;
+}
+
+/*
+ * Fingerprint a SELECT, INSERT, UPDATE or DELETE; false for anything
+ * else (EXPLAIN included), for text the lexer rejects, or when the
+ * statement is too long to cache. context (the active table) is part of
+ * the key, since statements without FROM run against it.
+ */
+bool plan_cache_fingerprint(const char* sql, const char* context, StatementFingerprint* fingerprint) {
+    memset(fingerprint, 0, sizeof(StatementFingerprint));
+    size_t used = strlen(context);
+    if (used + 1 >= PLAN_CACHE_KEY_SIZE) {
+        return false;
+    }
+    memcpy(fingerprint->key, context, used + 1);
+    
+    TokenType types[FINGERPRINT_MAX_TOKENS];
+    uint32_t num_tokens = 0;
+    bool ok = true;
+    Lexer* lexer = lexer_init(sql);
+    while (ok) {
+        Token* token = lexer_next_token(lexer);
+        if (token->type == TOKEN_EOF) {
+            token_free(token);
+            break;
+        }
+        if (token->type == TOKEN_ERROR || num_tokens == FINGERPRINT_MAX_TOKENS) {
+            token_free(token);
+            ok = false;
+            break;
+        }
+        
+        types[num_tokens] = token->type;
+        if (num_tokens == 0 && token->type != TOKEN_SELECT && token->type != TOKEN_INSERT &&
+            token->type != TOKEN_UPDATE && token->type != TOKEN_DELETE) {
+            ok = false;
+        } else if (token_is_literal(types, num_tokens)) {
+            // The marker keeps what decides plan validity: the token type,
+            // keys too long for an index, LIKE patterns with no prefix
+            char marker[8];
+            snprintf(marker, sizeof(marker), "?%c%s%s",
+                     token->type == TOKEN_NUMBER ? 'n' : token->type == TOKEN_STRING ? 's' : 'i',
+                     strlen(token->value) >= INDEX_KEY_SIZE - 1 ? "L" : "",
+                     types[num_tokens - 1] == TOKEN_LIKE &&
+                     (token->value[0] == '%' || token->value[0] == '_' || !token->value[0]) ? "W" : "");
+            ok = fingerprint->num_params < PLAN_CACHE_MAX_PARAMS && key_append(fingerprint->key, &used, marker);
+            if (ok) {
+                fingerprint->params[fingerprint->num_params++] = token->value;
+                token->value = NULL;
+            }
+        } else if (token->value) {
+            ok = key_append(fingerprint->key, &used, token->value);
+        } else {
+            // Keywords and punctuation by type number; not every one has a name
+            char type[8];
+            snprintf(type, sizeof(type), "#%d", token->type);
+            ok = key_append(fingerprint->key, &used, type);
+        }
+        num_tokens++;
+        token_free(token);
+    }
+    lexer_free(lexer);
+    
+    if (!ok || num_tokens == 0) {
+        plan_cache_fingerprint_free(fingerprint);
+        return false;
+    }
+    fingerprint->hash = crc32c(0, fingerprint->key, used);
+    return true;
+}
+
+void plan_cache_fingerprint_free(StatementFingerprint* fingerprint) {
+    for (uint32_t i = 0; i < fingerprint->num_params; i++) {
+        free(fingerprint->params[i]);
+    }
+    fingerprint->num_params = 0;
+}
+
+static void slot_add(ParamSlot* slots, uint32_t* count, ParamSlotKind kind, char** string) {
+    if (*count < PLAN_CACHE_MAX_PARAMS) {
+        slots[*count].kind = kind;
+        slots[*count].string = string;
+    }
+    (*count)++;
+}
+
+/*
+ * Where a parsed statement keeps its literals, in the order they appear
+ * in its text: INSERT's three values; UPDATE's assigned value; then each
+ * WHERE condition's value (and BETWEEN's upper bound); then LIMIT
+ */
+static uint32_t statement_slots(ParsedStatement* stmt, ParamSlot* slots) {
+    uint32_t count = 0;
+    if (stmt->type == STMT_INSERT) {
+        slot_add(slots, &count, PARAM_ROW_ID, NULL);
+        slot_add(slots, &count, PARAM_ROW_USERNAME, NULL);
+        slot_add(slots, &count, PARAM_ROW_EMAIL, NULL);
+        return count;
+    }
+    
+    for (int i = 0; i < stmt->num_assignments; i++) {
+        slot_add(slots, &count, PARAM_STRING, &stmt->assignments[i].value);
+    }
+    for (Condition* condition = stmt->where_clause; condition; condition = condition->next) {
+        slot_add(slots, &count, PARAM_STRING, &condition->value);
+        if (condition->value2) {
+            slot_add(slots, &count, PARAM_STRING, &condition->value2);
+        }
+    }
+    if (stmt->has_limit) {
+        slot_add(slots, &count, PARAM_LIMIT, NULL);
+    }
+    return count;
+}
+
+// Whether a slot holds the literal as the parser would have stored it
+static bool slot_holds(const ParamSlot* slot, ParsedStatement* stmt, const char* value) {
+    switch (slot->kind) {
+        case PARAM_STRING:
+            return strcmp(*slot->string, value) == 0;
+        case PARAM_ROW_ID:
+            return stmt->row_to_insert.id == (uint32_t)atoi(value);
+        case PARAM_ROW_USERNAME:
+            return strncmp(stmt->row_to_insert.username, value, COLUMN_USERNAME_SIZE) == 0;
+        case PARAM_ROW_EMAIL:
+            return strncmp(stmt->row_to_insert.email, value, COLUMN_EMAIL_SIZE) == 0;
+        case PARAM_LIMIT:
+            return stmt->limit == (uint32_t)atoi(value);
+    }
+    return false;
+}
+
+static void slot_bind(const ParamSlot* slot, ParsedStatement* stmt, const char* value) {
+    switch (slot->kind) {
+        case PARAM_STRING:
+            free(*slot->string);
+            *slot->string = strdup(value);
+            break;
+        case PARAM_ROW_ID:
+            stmt->row_to_insert.id = atoi(value);
+            break;
+        case PARAM_ROW_USERNAME:
+            strncpy(stmt->row_to_insert.username, value, COLUMN_USERNAME_SIZE);
+            break;
+        case PARAM_ROW_EMAIL:
+            strncpy(stmt->row_to_insert.email, value, COLUMN_EMAIL_SIZE);
+            break;
+        case PARAM_LIMIT:
+            stmt->limit = atoi(value);
+            break;
+    }
+}
+
+static void plan_cache_remove(PlanCache* cache, int32_t index) {
+    PlanCacheEntry* entry = &cache->entries[index];
+    int32_t* link = &cache->buckets[entry->hash % PLAN_CACHE_BUCKETS];
+    while (*link != index) {
+        link = &cache->entries[*link].next;
+    }
+    *link = entry->next;
+    
+    free_parsed_statement(entry->stmt);
+    free_query_plan(entry->plan);
+    memset(entry, 0, sizeof(PlanCacheEntry));
+    cache->count--;
+}
+
+/*
+ * The cached statement and plan for a fingerprint, with the new literals
+ * bound into the statement; NULL on a miss. A plan costed when its table
+ * had half or twice as many rows is dropped and planned afresh.
+ */
+PlanCacheEntry* plan_cache_lookup(PlanCache* cache, const StatementFingerprint* fingerprint) {
+    int32_t index = cache->buckets[fingerprint->hash % PLAN_CACHE_BUCKETS];
+    while (index >= 0) {
+        PlanCacheEntry* entry = &cache->entries[index];
+        if (entry->hash == fingerprint->hash && strcmp(entry->key, fingerprint->key) == 0) {
+            break;
+        }
+        index = entry->next;
+    }
+    if (index < 0) {
+        cache->misses++;
+        return NULL;
+    }
+    
+    PlanCacheEntry* entry = &cache->entries[index];
+    uint64_t rows = entry->table->header->row_count;
+    if (rows > (uint64_t)entry->planned_rows * 2 || rows < entry->planned_rows / 2) {
+        plan_cache_remove(cache, index);
+        cache->invalidations++;
+        cache->misses++;
+        return NULL;
+    }
+    
+    for (uint32_t i = 0; i < entry->num_slots; i++) {
+        slot_bind(&entry->slots[i], entry->stmt, fingerprint->params[i]);
+    }
+    
+    // A reused plan starts each run with fresh execution counters
+    QueryPlan* plan = entry->plan;
+    plan->rows_examined = 0;
+    plan->rows_matched = 0;
+    plan->num_operators = 0;
+    
+    entry->last_used = ++cache->clock;
+    cache->hits++;
+    return entry;
+}
+
+/*
+ * Keep a statement and its plan under the fingerprint, evicting the
+ * least recently used entry when full. The cache takes ownership and
+ * returns true only if every literal was found in the statement where
+ * binding will put it; otherwise the caller keeps both.
+ */
+bool plan_cache_insert(PlanCache* cache, const StatementFingerprint* fingerprint,
+                       ParsedStatement* stmt, QueryPlan* plan, Table* table) {
+    ParamSlot slots[PLAN_CACHE_MAX_PARAMS];
+    uint32_t num_slots = statement_slots(stmt, slots);
+    if (num_slots != fingerprint->num_params) {
+        return false;
+    }
+    for (uint32_t i = 0; i < num_slots; i++) {
+        if (!slot_holds(&slots[i], stmt, fingerprint->params[i])) {
+            return false;
+        }
+    }
+    
+    int32_t index = 0;
+    if (cache->count == PLAN_CACHE_CAPACITY) {
+        for (int32_t i = 1; i < PLAN_CACHE_CAPACITY; i++) {
+            if (cache->entries[i].last_used < cache->entries[index].last_used) {
+                index = i;
+            }
+        }
+        plan_cache_remove(cache, index);
+    } else {
+        while (cache->entries[index].used) {
+            index++;
+        }
+    }
+    
+    PlanCacheEntry* entry = &cache->entries[index];
+    entry->used = true;
+    memcpy(entry->key, fingerprint->key, sizeof(entry->key));
+    entry->hash = fingerprint->hash;
+    entry->stmt = stmt;
+    entry->plan = plan;
+    memcpy(entry->slots, slots, sizeof(ParamSlot) * num_slots);
+    entry->num_slots = num_slots;
+    entry->table = table;
+    entry->planned_rows = table->header->row_count;
+    entry->last_used = ++cache->clock;
+    
+    int32_t* bucket = &cache->buckets[fingerprint->hash % PLAN_CACHE_BUCKETS];
+    entry->next = *bucket;
+    *bucket = index;
+    cache->count++;
+    return true;
+}
+
+// Drop every plan: tables, indexes or statistics changed under them
+void plan_cache_invalidate(PlanCache* cache) {
+    for (int32_t i = 0; i < PLAN_CACHE_CAPACITY; i++) {
+        if (cache->entries[i].used) {
+            plan_cache_remove(cache, i);
+            cache->invalidations++;
+        }
+    }
+}
+
+void plan_cache_print(PlanCache* cache) {
+    printf("\n=== Plan Cache ===\n");
+    printf("Entries: %u / %u\n", cache->count, PLAN_CACHE_CAPACITY);
+    printf("Hits: %llu\n", (unsigned long long)cache->hits);
+    printf("Misses: %llu\n", (unsigned long long)cache->misses);
+    printf("Invalidations: %llu\n", (unsigned long long)cache->invalidations);
+    if (cache->hits + cache->misses > 0) {
+        printf("Hit Rate: %.2f%%\n", (double)cache->hits / (cache->hits + cache->misses) * 100);
+    }
+    printf("==================\n");
+}
@@ -0,0 +1,75 @@
+#ifndef PLAN_CACHE_H
+#define PLAN_CACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "optimizer.h"
+
+#define PLAN_CACHE_CAPACITY 128
+#define PLAN_CACHE_BUCKETS 256
+#define PLAN_CACHE_MAX_PARAMS 16
+#define PLAN_CACHE_KEY_SIZE 512
+
+/*
+ * A statement with its literals taken out: the key is the token stream
+ * with each literal replaced by a marker of its token type (and whether
+ * it is too long for an index key, or a LIKE pattern with no literal
+ * prefix, since either changes which plans are valid); params are the
+ * literal values in statement order.
+ */
+typedef struct {
+    char key[PLAN_CACHE_KEY_SIZE];
+    uint32_t hash;
+    char* params[PLAN_CACHE_MAX_PARAMS];
+    uint32_t num_params;
+} StatementFingerprint;
+
+typedef enum {
+    PARAM_STRING,        // A heap string of the statement: a condition or assignment value
+    PARAM_ROW_ID,
+    PARAM_ROW_USERNAME,
+    PARAM_ROW_EMAIL,
+    PARAM_LIMIT
+} ParamSlotKind;
+
+// Where one literal lives in a parsed statement
+typedef struct {
+    ParamSlotKind kind;
+    char** string;       // PARAM_STRING only
+} ParamSlot;
+
+typedef struct {
+    bool used;
+    char key[PLAN_CACHE_KEY_SIZE];
+    uint32_t hash;
+    int32_t next;                 // Next entry in the bucket, -1 at the end
+    ParsedStatement* stmt;        // Parsed once; literals are rebound on each hit
+    QueryPlan* plan;
+    ParamSlot slots[PLAN_CACHE_MAX_PARAMS];
+    uint32_t num_slots;
+    Table* table;                 // Table the plan was costed against
+    uint32_t planned_rows;        // ...and its row count then
+    uint64_t last_used;
+} PlanCacheEntry;
+
+typedef struct {
+    PlanCacheEntry entries[PLAN_CACHE_CAPACITY];
+    int32_t buckets[PLAN_CACHE_BUCKETS];
+    uint32_t count;
+    uint64_t clock;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t invalidations;       // Entries dropped by DDL, ANALYZE or row count drift
+} PlanCache;
+
+PlanCache* plan_cache_create(void);
+void plan_cache_free(PlanCache* cache);
+bool plan_cache_fingerprint(const char* sql, const char* context, StatementFingerprint* fingerprint);
+void plan_cache_fingerprint_free(StatementFingerprint* fingerprint);
+PlanCacheEntry* plan_cache_lookup(PlanCache* cache, const StatementFingerprint* fingerprint);
+bool plan_cache_insert(PlanCache* cache, const StatementFingerprint* fingerprint,
+                       ParsedStatement* stmt, QueryPlan* plan, Table* table);
+void plan_cache_invalidate(PlanCache* cache);
+void plan_cache_print(PlanCache* cache);
+
+#endif // PLAN_CACHE_H
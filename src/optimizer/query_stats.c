@@ -0,0 +1,157 @@
+#include "query_stats.h"
+#include "../storage/pager.h"
+#include "../transaction/wal.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+static const char* statement_type_names[NUM_STATEMENT_TYPES] = {
+    "select", "insert", "update", "delete", "create_table", "create_index", "analyze"
+};
+
+QueryStats* stats_create(void) {
+    QueryStats* stats = malloc(sizeof(QueryStats));
+    memset(stats, 0, sizeof(QueryStats));
+    return stats;
+}
+
+void stats_update(QueryStats* stats, QueryPlan* plan, uint32_t rows_returned) {
+    if (!plan->uses_index) {
+        stats->full_scans++;
+    } else {
+        stats->index_searches++;
+    }
+    
+    stats->rows_scanned += plan->rows_examined;
+    stats->rows_returned += rows_returned;
+}
+
+void stats_record_latency(QueryStats* stats, StatementType type, uint64_t nanoseconds) {
+    if ((uint32_t)type >= NUM_STATEMENT_TYPES) {
+        return;
+    }
+    LatencyHistogram* histogram = &stats->latency[type];
+    uint64_t us = nanoseconds / 1000;
+    uint32_t bucket = 0;
+    while (bucket < LATENCY_BUCKETS - 1 && us >= ((uint64_t)1 << bucket)) {
+        bucket++;
+    }
+    histogram->buckets[bucket]++;
+    histogram->count++;
+    histogram->total_us += us;
+    if (us > histogram->max_us) {
+        histogram->max_us = us;
+    }
+}
+
+/*
+ * Upper bound in microseconds of the bucket holding the given percentile,
+ * or the largest latency seen when that is the open-ended last bucket
+ */
+static uint64_t latency_percentile(const LatencyHistogram* histogram, double percentile) {
+    uint64_t rank = (uint64_t)(histogram->count * percentile / 100.0 + 0.5);
+    if (rank == 0) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < LATENCY_BUCKETS - 1; i++) {
+        seen += histogram->buckets[i];
+        if (seen >= rank) {
+            uint64_t bound = (uint64_t)1 << i;
+            return bound < histogram->max_us ? bound : histogram->max_us;
+        }
+    }
+    return histogram->max_us;
+}
+
+void stats_print(QueryStats* stats) {
+    PagerCounters pages = pager_counters();
+    WALCounters wal = wal_counters();
+    
+    printf("\n=== Query Statistics ===\n");
+    printf("Full Table Scans: %llu\n", (unsigned long long)stats->full_scans);
+    printf("Index Searches: %llu\n", (unsigned long long)stats->index_searches);
+    printf("Total Rows Scanned: %llu\n", (unsigned long long)stats->rows_scanned);
+    printf("Total Rows Returned: %llu\n", (unsigned long long)stats->rows_returned);
+    
+    if (stats->rows_scanned > 0) {
+        double efficiency = (double)stats->rows_returned / stats->rows_scanned * 100;
+        printf("Scan Efficiency: %.2f%%\n", efficiency);
+    }
+    
+    printf("Pages Touched: %llu (%llu cached, %llu loaded, %llu read from disk)\n",
+           (unsigned long long)(pages.hits + pages.misses), (unsigned long long)pages.hits,
+           (unsigned long long)pages.misses, (unsigned long long)pages.reads);
+    printf("Pages Written: %llu\n", (unsigned long long)pages.writes);
+    printf("Data File Syncs: %llu\n", (unsigned long long)pages.syncs);
+    printf("WAL Bytes Written: %llu\n", (unsigned long long)wal.bytes_written);
+    printf("WAL Syncs: %llu\n", (unsigned long long)wal.syncs);
+    printf("Checkpoints: %llu\n", (unsigned long long)wal.checkpoints);
+    
+    // Percentiles are bucket bounds, so at most a factor of two high
+    printf("\nLatency (us)   %8s %10s %10s %10s %10s\n", "count", "avg", "p50", "p99", "max");
+    for (uint32_t type = 0; type < NUM_STATEMENT_TYPES; type++) {
+        const LatencyHistogram* histogram = &stats->latency[type];
+        if (histogram->count == 0) {
+            continue;
+        }
+        printf("  %-12s %8llu %10.1f %10llu %10llu %10llu\n", statement_type_names[type],
+               (unsigned long long)histogram->count,
+               (double)histogram->total_us / histogram->count,
+               (unsigned long long)latency_percentile(histogram, 50),
+               (unsigned long long)latency_percentile(histogram, 99),
+               (unsigned long long)histogram->max_us);
+    }
+    
+    printf("========================\n\n");
+}
+
+// All counters as one line of JSON, for scripts that poll `.stats json`
+void stats_print_json(QueryStats* stats, PlanCache* cache) {
+    PagerCounters pages = pager_counters();
+    WALCounters wal = wal_counters();
+    
+    printf("{\"rows\":{\"scanned\":%llu,\"returned\":%llu}",
+           (unsigned long long)stats->rows_scanned, (unsigned long long)stats->rows_returned);
+    printf(",\"scans\":{\"full\":%llu,\"index\":%llu}",
+           (unsigned long long)stats->full_scans, (unsigned long long)stats->index_searches);
+    printf(",\"pages\":{\"touched\":%llu,\"hits\":%llu,\"misses\":%llu,\"reads\":%llu,\"writes\":%llu,"
+           "\"data_syncs\":%llu}",
+           (unsigned long long)(pages.hits + pages.misses), (unsigned long long)pages.hits,
+           (unsigned long long)pages.misses, (unsigned long long)pages.reads,
+           (unsigned long long)pages.writes, (unsigned long long)pages.syncs);
+    printf(",\"wal\":{\"bytes_written\":%llu,\"syncs\":%llu,\"checkpoints\":%llu}",
+           (unsigned long long)wal.bytes_written, (unsigned long long)wal.syncs,
+           (unsigned long long)wal.checkpoints);
+    if (cache) {
+        printf(",\"plan_cache\":{\"entries\":%u,\"hits\":%llu,\"misses\":%llu,\"invalidations\":%llu}",
+               cache->count, (unsigned long long)cache->hits, (unsigned long long)cache->misses,
+               (unsigned long long)cache->invalidations);
+    }
+    
+    // Bucket i holds latencies below bucket_upper_bounds[i]; null is unbounded
+    printf(",\"latency_us\":{\"bucket_upper_bounds\":[");
+    for (uint32_t i = 0; i < LATENCY_BUCKETS; i++) {
+        if (i == LATENCY_BUCKETS - 1) {
+            printf("%snull", i ? "," : "");
+        } else {
+            printf("%s%llu", i ? "," : "", (unsigned long long)1 << i);
+        }
+    }
+    printf("]");
+    for (uint32_t type = 0; type < NUM_STATEMENT_TYPES; type++) {
+        const LatencyHistogram* histogram = &stats->latency[type];
+        printf(",\"%s\":{\"count\":%llu,\"sum\":%llu,\"max\":%llu,\"buckets\":[",
+               statement_type_names[type], (unsigned long long)histogram->count,
+               (unsigned long long)histogram->total_us, (unsigned long long)histogram->max_us);
+        for (uint32_t i = 0; i < LATENCY_BUCKETS; i++) {
+            printf("%s%llu", i ? "," : "", (unsigned long long)histogram->buckets[i]);
+        }
+        printf("]}");
+    }
+    printf("}}\n");
+}
+
+void stats_free(QueryStats* stats) {
+    free(stats);
+}
@@ -0,0 +1,41 @@
+#ifndef QUERY_STATS_H
+#define QUERY_STATS_H
+
+#include <stdint.h>
+#include "optimizer.h"
+#include "plan_cache.h"
+
+#define NUM_STATEMENT_TYPES (STMT_ANALYZE + 1)
+
+// Bucket i counts statements that took under 2^i microseconds (and at
+// least 2^(i-1)); the last bucket has no upper bound
+#define LATENCY_BUCKETS 24
+
+typedef struct {
+    uint64_t count;
+    uint64_t total_us;
+    uint64_t max_us;
+    uint64_t buckets[LATENCY_BUCKETS];
+} LatencyHistogram;
+
+/*
+ * Work done by the statements run since startup. Rows are those the
+ * access paths actually produced; pages, WAL bytes and syncs come from
+ * the pager and WAL counters when the statistics are printed.
+ */
+typedef struct {
+    uint64_t full_scans;
+    uint64_t index_searches;
+    uint64_t rows_scanned;
+    uint64_t rows_returned;
+    LatencyHistogram latency[NUM_STATEMENT_TYPES];  // By StatementType
+} QueryStats;
+
+QueryStats* stats_create(void);
+void stats_update(QueryStats* stats, QueryPlan* plan, uint32_t rows_returned);
+void stats_record_latency(QueryStats* stats, StatementType type, uint64_t nanoseconds);
+void stats_print(QueryStats* stats);
+void stats_print_json(QueryStats* stats, PlanCache* cache);
+void stats_free(QueryStats* stats);
+
+#endif // QUERY_STATS_H
@@ -120,6 +120,22 @@ static Token* read_identifier(Lexer* lexer) {
         return make_token(TOKEN_INTO, NULL, 0);
     } else if (strncasecmp(value, "values", length) == 0 && length == 6) {
         return make_token(TOKEN_VALUES, NULL, 0);
+    } else if (strncasecmp(value, "using", length) == 0 && length == 5) {
+        return make_token(TOKEN_USING, NULL, 0);
+    } else if (strncasecmp(value, "include", length) == 0 && length == 7) {
+        return make_token(TOKEN_INCLUDE, NULL, 0);
+    } else if (strncasecmp(value, "with", length) == 0 && length == 4) {
+        return make_token(TOKEN_WITH, NULL, 0);
+    } else if (strncasecmp(value, "like", length) == 0 && length == 4) {
+        return make_token(TOKEN_LIKE, NULL, 0);
+    } else if (strncasecmp(value, "between", length) == 0 && length == 7) {
+        return make_token(TOKEN_BETWEEN, NULL, 0);
+    } else if (strncasecmp(value, "and", length) == 0 && length == 3) {
+        return make_token(TOKEN_AND, NULL, 0);
+    } else if (strncasecmp(value, "or", length) == 0 && length == 2) {
+        return make_token(TOKEN_OR, NULL, 0);
+    } else if (strncasecmp(value, "analyze", length) == 0 && length == 7) {
+        return make_token(TOKEN_ANALYZE, NULL, 0);
     } else {
         return make_token(TOKEN_IDENTIFIER, value, length);
     }
@@ -166,6 +182,25 @@ Token* lexer_next_token(Lexer* lexer) {
         case '=':
             lexer->position++;
             return make_token(TOKEN_EQUALS, NULL, 0);
+        case '<':
+        case '>':
+            lexer->position++;
+            if (lexer->position < lexer->length && lexer->input[lexer->position] == '=') {
+                lexer->position++;
+                return make_token(current == '<' ? TOKEN_LESS_EQUALS : TOKEN_GREATER_EQUALS, NULL, 0);
+            }
+            if (current == '<' && lexer->position < lexer->length &&
+                lexer->input[lexer->position] == '>') {
+                lexer->position++;
+                return make_token(TOKEN_NOT_EQUALS, NULL, 0);
+            }
+            return make_token(current == '<' ? TOKEN_LESS : TOKEN_GREATER, NULL, 0);
+        case '!':
+            if (lexer->position + 1 < lexer->length && lexer->input[lexer->position + 1] == '=') {
+                lexer->position += 2;
+                return make_token(TOKEN_NOT_EQUALS, NULL, 0);
+            }
+            break;
         case ',':
             lexer->position++;
             return make_token(TOKEN_COMMA, NULL, 0);
@@ -215,6 +250,7 @@ const char* token_type_to_string(TokenType type) {
         case TOKEN_NUMBER: return "NUMBER";
         case TOKEN_STRING: return "STRING";
         case TOKEN_EQUALS: return "EQUALS";
+        case TOKEN_NOT_EQUALS: return "NOT_EQUALS";
         case TOKEN_COMMA: return "COMMA";
         case TOKEN_ASTERISK: return "ASTERISK";
         case TOKEN_LPAREN: return "LPAREN";
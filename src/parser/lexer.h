@@ -35,10 +35,23 @@ typedef enum {
     TOKEN_FROM,
     TOKEN_INTO,
     TOKEN_VALUES,
+    TOKEN_USING,
+    TOKEN_INCLUDE,
+    TOKEN_WITH,
+    TOKEN_LIKE,
+    TOKEN_BETWEEN,
+    TOKEN_AND,
+    TOKEN_OR,
+    TOKEN_ANALYZE,
     TOKEN_IDENTIFIER,
     TOKEN_NUMBER,
     TOKEN_STRING,
     TOKEN_EQUALS,
+    TOKEN_LESS,
+    TOKEN_LESS_EQUALS,
+    TOKEN_GREATER,
+    TOKEN_GREATER_EQUALS,
+    TOKEN_NOT_EQUALS,
     TOKEN_COMMA,
     TOKEN_ASTERISK,
     TOKEN_LPAREN,
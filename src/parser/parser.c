@@ -2,6 +2,7 @@
 #include "../storage/schema.h"
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <stdio.h>
 
 typedef struct {
@@ -24,44 +25,271 @@ static bool parser_expect(Parser* parser, TokenType type) {  // <-- MOVE THIS UP
     return false;
 }
 
-static Condition* parse_where_clause(Parser* parser) {
-    if (parser->current_token->type != TOKEN_WHERE) {
-        return NULL;
+static char* parse_condition_value(Parser* parser) {
+    if (parser->current_token->type == TOKEN_NUMBER ||
+        parser->current_token->type == TOKEN_STRING ||
+        parser->current_token->type == TOKEN_IDENTIFIER) {
+        char* value = strdup(parser->current_token->value);
+        parser_advance(parser);
+        return value;
     }
-    parser_advance(parser); // Skip WHERE
-    
+    return NULL;
+}
+
+static void free_conditions(Condition* condition) {
+    while (condition) {
+        Condition* next = condition->next;
+        free(condition->column);
+        free(condition->operator);
+        free(condition->value);
+        free(condition->value2);
+        free(condition);
+        condition = next;
+    }
+}
+
+// column op value [AND value2]
+static Condition* parse_condition(Parser* parser) {
     if (parser->current_token->type != TOKEN_IDENTIFIER) {
         return NULL;
     }
     
-    Condition* condition = malloc(sizeof(Condition));
-    condition->column = strdup(parser->current_token->value);
+    char* column = strdup(parser->current_token->value);
     parser_advance(parser);
     
-    if (parser->current_token->type != TOKEN_EQUALS) {
-        free(condition->column);
-        free(condition);
-        return NULL;
+    const char* operator;
+    ConditionOp op;
+    switch (parser->current_token->type) {
+        case TOKEN_EQUALS:         operator = "=";       op = OP_EQUALS;         break;
+        case TOKEN_NOT_EQUALS:     operator = "!=";      op = OP_NOT_EQUALS;     break;
+        case TOKEN_LESS:           operator = "<";       op = OP_LESS;           break;
+        case TOKEN_LESS_EQUALS:    operator = "<=";      op = OP_LESS_EQUALS;    break;
+        case TOKEN_GREATER:        operator = ">";       op = OP_GREATER;        break;
+        case TOKEN_GREATER_EQUALS: operator = ">=";      op = OP_GREATER_EQUALS; break;
+        case TOKEN_LIKE:           operator = "LIKE";    op = OP_LIKE;           break;
+        case TOKEN_BETWEEN:        operator = "BETWEEN"; op = OP_BETWEEN;        break;
+        default:
+            free(column);
+            return NULL;
     }
-    condition->operator = strdup("=");
     parser_advance(parser);
     
+    Condition* condition = malloc(sizeof(Condition));
+    memset(condition, 0, sizeof(Condition));
+    condition->column = column;
+    condition->operator = strdup(operator);
+    condition->op = op;
+    
     // Accept NUMBER, STRING, or IDENTIFIER for value
-    if (parser->current_token->type == TOKEN_NUMBER || 
-        parser->current_token->type == TOKEN_STRING ||
-        parser->current_token->type == TOKEN_IDENTIFIER) {
-        condition->value = strdup(parser->current_token->value);
-        parser_advance(parser);
-    } else {
-        free(condition->column);
-        free(condition->operator);
-        free(condition);
+    condition->value = parse_condition_value(parser);
+    if (condition->value && strcmp(operator, "BETWEEN") == 0 && parser_expect(parser, TOKEN_AND)) {
+        condition->value2 = parse_condition_value(parser);
+    }
+    
+    if (!condition->value || (strcmp(operator, "BETWEEN") == 0 && !condition->value2)) {
+        free_conditions(condition);
         return NULL;
     }
     
     return condition;
 }
 
+static void free_where_tree(WhereNode* node) {
+    if (node) {
+        free_where_tree(node->left);
+        free_where_tree(node->right);
+        free(node);
+    }
+}
+
+static WhereNode* where_node(WhereNodeType type, Condition* condition, WhereNode* left,
+                             WhereNode* right) {
+    WhereNode* node = malloc(sizeof(WhereNode));
+    node->type = type;
+    node->condition = condition;
+    node->left = left;
+    node->right = right;
+    return node;
+}
+
+static WhereNode* parse_where_or(Parser* parser, Condition*** tail, uint32_t* count);
+
+// condition, or ( expression ); conditions are appended to the list at *tail
+static WhereNode* parse_where_primary(Parser* parser, Condition*** tail, uint32_t* count) {
+    if (parser_expect(parser, TOKEN_LPAREN)) {
+        WhereNode* node = parse_where_or(parser, tail, count);
+        if (node && !parser_expect(parser, TOKEN_RPAREN)) {
+            free_where_tree(node);
+            return NULL;
+        }
+        return node;
+    }
+    
+    Condition* condition = parse_condition(parser);
+    if (!condition) {
+        return NULL;
+    }
+    condition->position = (*count)++;
+    **tail = condition;
+    *tail = &condition->next;
+    return where_node(WHERE_CONDITION, condition, NULL, NULL);
+}
+
+// AND binds tighter than OR; both associate to the left
+static WhereNode* parse_where_and(Parser* parser, Condition*** tail, uint32_t* count) {
+    WhereNode* node = parse_where_primary(parser, tail, count);
+    while (node && parser_expect(parser, TOKEN_AND)) {
+        WhereNode* right = parse_where_primary(parser, tail, count);
+        if (!right) {
+            free_where_tree(node);
+            return NULL;
+        }
+        node = where_node(WHERE_AND, NULL, node, right);
+    }
+    return node;
+}
+
+static WhereNode* parse_where_or(Parser* parser, Condition*** tail, uint32_t* count) {
+    WhereNode* node = parse_where_and(parser, tail, count);
+    while (node && parser_expect(parser, TOKEN_OR)) {
+        WhereNode* right = parse_where_and(parser, tail, count);
+        if (!right) {
+            free_where_tree(node);
+            return NULL;
+        }
+        node = where_node(WHERE_OR, NULL, node, right);
+    }
+    return node;
+}
+
+// Whether the expression contains a node of the given type
+static bool where_tree_has(const WhereNode* node, WhereNodeType type) {
+    return node && (node->type == type || where_tree_has(node->left, type) ||
+                    where_tree_has(node->right, type));
+}
+
+// Conditions reached from the root through ANDs alone must hold for every matching row
+static void mark_conjuncts(WhereNode* node) {
+    if (node->type == WHERE_CONDITION) {
+        node->condition->conjunct = true;
+    } else if (node->type == WHERE_AND) {
+        mark_conjuncts(node->left);
+        mark_conjuncts(node->right);
+    }
+}
+
+/*
+ * WHERE expression: conditions combined with AND, OR and parentheses,
+ * AND binding tighter. The conditions also form a list in text order.
+ * Returns false for a malformed clause; a statement without WHERE is fine.
+ */
+static bool parse_where_clause(Parser* parser, ParsedStatement* stmt) {
+    if (!parser_expect(parser, TOKEN_WHERE)) {
+        return true;
+    }
+    
+    // The list hangs off stmt as it grows, so a failed parse frees it with stmt
+    Condition** tail = &stmt->where_clause;
+    uint32_t count = 0;
+    stmt->where_tree = parse_where_or(parser, &tail, &count);
+    if (!stmt->where_tree) {
+        return false;
+    }
+    
+    stmt->has_where = true;
+    bool has_and = where_tree_has(stmt->where_tree, WHERE_AND);
+    bool has_or = where_tree_has(stmt->where_tree, WHERE_OR);
+    stmt->where_is_or = has_or && !has_and;
+    stmt->where_is_nested = has_or && has_and;
+    mark_conjuncts(stmt->where_tree);
+    return true;
+}
+
+// Whether the WHERE clause is one condition, with no AND or OR
+bool where_is_single(const ParsedStatement* stmt) {
+    return stmt->has_where && stmt->where_clause->next == NULL;
+}
+
+// SQL LIKE: % matches any run of characters, _ any single character
+bool like_match(const char* pattern, const char* value) {
+    for (; *pattern; pattern++, value++) {
+        if (*pattern == '%') {
+            for (const char* rest = value; ; rest++) {
+                if (like_match(pattern + 1, rest)) {
+                    return true;
+                }
+                if (!*rest) {
+                    return false;
+                }
+            }
+        }
+        if (!*value || (*pattern != '_' && *pattern != *value)) {
+            return false;
+        }
+    }
+    return *value == '\0';
+}
+
+/*
+ * Evaluate a condition against a column value. Numeric columns compare
+ * as unsigned integers, everything else as strings.
+ */
+// Whether a comparison result satisfies the operator; cmp_upper is against BETWEEN's upper bound
+bool condition_compare(const Condition* condition, int cmp, int cmp_upper) {
+    switch (condition->op) {
+        case OP_EQUALS:         return cmp == 0;
+        case OP_NOT_EQUALS:     return cmp != 0;
+        case OP_LESS:           return cmp < 0;
+        case OP_LESS_EQUALS:    return cmp <= 0;
+        case OP_GREATER:        return cmp > 0;
+        case OP_GREATER_EQUALS: return cmp >= 0;
+        case OP_BETWEEN:        return cmp >= 0 && cmp_upper <= 0;
+        case OP_LIKE:           return false;
+    }
+    return false;
+}
+
+bool condition_matches(const Condition* condition, const char* value, bool numeric) {
+    if (condition->op == OP_LIKE) {
+        return like_match(condition->value, value);
+    }
+    
+    int cmp;
+    int cmp_upper = 0;
+    if (numeric) {
+        long long v = strtoll(value, NULL, 10);
+        long long lower = strtoll(condition->value, NULL, 10);
+        cmp = (v > lower) - (v < lower);
+        if (condition->value2) {
+            long long upper = strtoll(condition->value2, NULL, 10);
+            cmp_upper = (v > upper) - (v < upper);
+        }
+    } else {
+        cmp = strcmp(value, condition->value);
+        if (condition->value2) {
+            cmp_upper = strcmp(value, condition->value2);
+        }
+    }
+    return condition_compare(condition, cmp, cmp_upper);
+}
+
+/*
+ * The literal text a LIKE pattern starts with, up to its first wildcard.
+ * Returns the prefix length; 0 for other operators or a leading wildcard.
+ */
+size_t condition_like_prefix(const Condition* condition, char* prefix, size_t size) {
+    if (strcmp(condition->operator, "LIKE") != 0) {
+        return 0;
+    }
+    size_t length = strcspn(condition->value, "%_");
+    if (length >= size) {
+        length = size - 1;
+    }
+    memcpy(prefix, condition->value, length);
+    prefix[length] = '\0';
+    return length;
+}
+
 static ParsedStatement* parse_create_table(Parser* parser) {
     ParsedStatement* stmt = malloc(sizeof(ParsedStatement));
     memset(stmt, 0, sizeof(ParsedStatement));
@@ -146,6 +374,69 @@ static ParsedStatement* parse_create_table(Parser* parser) {
     return stmt;
 }
 
+// USING BTREE | USING HASH | USING BITMAP
+static bool parse_index_method(Parser* parser, ParsedStatement* stmt) {
+    if (!parser_expect(parser, TOKEN_USING)) {
+        return true;
+    }
+    if (parser->current_token->type != TOKEN_IDENTIFIER) {
+        return false;
+    }
+    
+    if (strcasecmp(parser->current_token->value, "hash") == 0) {
+        stmt->index_type = INDEX_TYPE_HASH;
+    } else if (strcasecmp(parser->current_token->value, "btree") == 0) {
+        stmt->index_type = INDEX_TYPE_BTREE;
+    } else if (strcasecmp(parser->current_token->value, "bitmap") == 0) {
+        stmt->index_type = INDEX_TYPE_BITMAP;
+    } else {
+        return false;
+    }
+    parser_advance(parser);
+    return true;
+}
+
+// Comma-separated identifiers up to the next non-identifier
+static bool parse_column_list(Parser* parser, char columns[][MAX_COLUMN_NAME], uint32_t* count) {
+    *count = 0;
+    while (parser->current_token->type == TOKEN_IDENTIFIER) {
+        if (*count >= MAX_COLUMNS) {
+            return false;
+        }
+        strncpy(columns[(*count)++], parser->current_token->value, MAX_COLUMN_NAME - 1);
+        parser_advance(parser);
+        if (parser->current_token->type != TOKEN_COMMA) {
+            break;
+        }
+        parser_advance(parser);
+    }
+    return *count > 0;
+}
+
+// INCLUDE (column, ...)
+static bool parse_index_include(Parser* parser, ParsedStatement* stmt) {
+    if (!parser_expect(parser, TOKEN_INCLUDE)) {
+        return true;
+    }
+    return parser_expect(parser, TOKEN_LPAREN) &&
+           parse_column_list(parser, stmt->index_include, &stmt->num_index_include) &&
+           parser_expect(parser, TOKEN_RPAREN);
+}
+
+// WITH BLOOM
+static bool parse_index_options(Parser* parser, ParsedStatement* stmt) {
+    if (!parser_expect(parser, TOKEN_WITH)) {
+        return true;
+    }
+    if (parser->current_token->type != TOKEN_IDENTIFIER ||
+        strcasecmp(parser->current_token->value, "bloom") != 0) {
+        return false;
+    }
+    stmt->index_flags |= INDEX_FLAG_BLOOM;
+    parser_advance(parser);
+    return true;
+}
+
 static ParsedStatement* parse_create_index(Parser* parser) {
     ParsedStatement* stmt = malloc(sizeof(ParsedStatement));
     memset(stmt, 0, sizeof(ParsedStatement));
@@ -158,13 +449,15 @@ static ParsedStatement* parse_create_index(Parser* parser) {
         return NULL;
     }
     
-    // ON table_name (column_name)
+    // ON table_name [USING method] (column_name) [USING method] [INCLUDE (columns)] [WITH BLOOM]
     if (parser_expect(parser, TOKEN_ON)) {
         if (parser->current_token->type == TOKEN_IDENTIFIER) {
             strncpy(stmt->index_table, parser->current_token->value, 63);
             parser_advance(parser);
         }
         
+        bool method_ok = parse_index_method(parser, stmt);
+        
         if (parser_expect(parser, TOKEN_LPAREN)) {
             if (parser->current_token->type == TOKEN_IDENTIFIER) {
                 strncpy(stmt->index_column, parser->current_token->value, 31);
@@ -172,11 +465,45 @@ static ParsedStatement* parse_create_index(Parser* parser) {
             }
             parser_expect(parser, TOKEN_RPAREN);
         }
+        
+        if (!method_ok || !parse_index_method(parser, stmt) ||
+            !parse_index_include(parser, stmt) || !parse_index_options(parser, stmt)) {
+            free(stmt);
+            return NULL;
+        }
     }
     
     return stmt;
 }
 
+// table.column, or a bare column of the table already in `table`
+static bool parse_join_column(Parser* parser, char* table, char* column) {
+    if (parser->current_token->type != TOKEN_IDENTIFIER) {
+        return false;
+    }
+    const char* value = parser->current_token->value;
+    const char* dot = strchr(value, '.');
+    if (dot) {
+        size_t table_len = (size_t)(dot - value) < 63 ? (size_t)(dot - value) : 63;
+        memcpy(table, value, table_len);
+        table[table_len] = '\0';
+        value = dot + 1;
+    }
+    strncpy(column, value, 31);
+    column[31] = '\0';
+    parser_advance(parser);
+    return true;
+}
+
+static int join_table_position(ParsedStatement* stmt, const char* table) {
+    for (uint32_t i = 0; i < stmt->num_join_tables; i++) {
+        if (strcmp(stmt->join_tables[i], table) == 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
 static ParsedStatement* parse_select(Parser* parser) {
     ParsedStatement* stmt = malloc(sizeof(ParsedStatement));
     memset(stmt, 0, sizeof(ParsedStatement));
@@ -217,7 +544,7 @@ static ParsedStatement* parse_select(Parser* parser) {
         }
     } else if (parser->current_token->type == TOKEN_ASTERISK) {
         parser_advance(parser);
-    } else {
+    } else if (!parse_column_list(parser, stmt->select_columns, &stmt->num_select_columns)) {
         free(stmt);
         return NULL;
     }
@@ -230,61 +557,58 @@ static ParsedStatement* parse_select(Parser* parser) {
             parser_advance(parser);
         }
         
-        // Check for JOIN
-        if (parser->current_token->type == TOKEN_INNER || 
-            parser->current_token->type == TOKEN_JOIN) {
-            
+        // Any number of [INNER] JOIN <table> ON a.x = b.y [AND ...]
+        if (stmt->from_table[0] != '\0') {
+            strcpy(stmt->join_tables[0], stmt->from_table);
+            stmt->num_join_tables = 1;
+        }
+        while (parser->current_token->type == TOKEN_INNER ||
+               parser->current_token->type == TOKEN_JOIN) {
             if (parser->current_token->type == TOKEN_INNER) {
                 parser_advance(parser);
             }
+            if (!parser_expect(parser, TOKEN_JOIN) ||
+                stmt->num_join_tables == 0 || stmt->num_join_tables == MAX_JOIN_TABLES ||
+                parser->current_token->type != TOKEN_IDENTIFIER) {
+                free_parsed_statement(stmt);
+                return NULL;
+            }
+            char* joined = stmt->join_tables[stmt->num_join_tables++];
+            strncpy(joined, parser->current_token->value, 63);
+            parser_advance(parser);
             
-            if (parser_expect(parser, TOKEN_JOIN)) {
-                stmt->join_clause = malloc(sizeof(JoinClause));
-                strncpy(stmt->join_clause->left_table, stmt->from_table, 63);
-                
-                // Get right table name
-                if (parser->current_token->type == TOKEN_IDENTIFIER) {
-                    strncpy(stmt->join_clause->right_table, parser->current_token->value, 63);
-                    parser_advance(parser);
-                }
+            if (!parser_expect(parser, TOKEN_ON)) {
+                free_parsed_statement(stmt);
+                return NULL;
+            }
+            do {
+                stmt->join_clause = realloc(stmt->join_clause,
+                                            sizeof(JoinClause) * (stmt->num_join_clauses + 1));
+                JoinClause* clause = &stmt->join_clause[stmt->num_join_clauses++];
+                memset(clause, 0, sizeof(JoinClause));
+                // Unqualified columns belong to the previous table and the joined one
+                strcpy(clause->left_table, stmt->join_tables[stmt->num_join_tables - 2]);
+                strcpy(clause->right_table, joined);
                 
-                // ON clause
-                if (parser_expect(parser, TOKEN_ON)) {
-                    // Parse left_table.column = right_table.column
-                    if (parser->current_token->type == TOKEN_IDENTIFIER) {
-                        // This should be table.column format
-                        char* dot = strchr(parser->current_token->value, '.');
-                        if (dot) {
-                            int table_len = dot - parser->current_token->value;
-                            strncpy(stmt->join_clause->left_table, parser->current_token->value, table_len);
-                            stmt->join_clause->left_table[table_len] = '\0';
-                            strncpy(stmt->join_clause->left_column, dot + 1, 31);
-                        }
-                        parser_advance(parser);
-                    }
-                    
-                    parser_expect(parser, TOKEN_EQUALS);
-                    
-                    if (parser->current_token->type == TOKEN_IDENTIFIER) {
-                        char* dot = strchr(parser->current_token->value, '.');
-                        if (dot) {
-                            int table_len = dot - parser->current_token->value;
-                            strncpy(stmt->join_clause->right_table, parser->current_token->value, table_len);
-                            stmt->join_clause->right_table[table_len] = '\0';
-                            strncpy(stmt->join_clause->right_column, dot + 1, 31);
-                        }
-                        parser_advance(parser);
-                    }
+                if (!parse_join_column(parser, clause->left_table, clause->left_column) ||
+                    !parser_expect(parser, TOKEN_EQUALS) ||
+                    !parse_join_column(parser, clause->right_table, clause->right_column)) {
+                    free_parsed_statement(stmt);
+                    return NULL;
                 }
-                
-                stmt->has_join = true;
-            }
+                clause->left_position = join_table_position(stmt, clause->left_table);
+                clause->right_position = join_table_position(stmt, clause->right_table);
+            } while (parser_expect(parser, TOKEN_AND));
+            
+            stmt->has_join = true;
         }
     }
     
-    // Optional WHERE clause (keep existing code)
-    stmt->where_clause = parse_where_clause(parser);
-    stmt->has_where = (stmt->where_clause != NULL);
+    // Optional WHERE clause
+    if (!parse_where_clause(parser, stmt)) {
+        free_parsed_statement(stmt);
+        return NULL;
+    }
     
     // Optional ORDER BY (keep existing code)
     if (parser->current_token->type == TOKEN_ORDER) {
@@ -401,8 +725,10 @@ static ParsedStatement* parse_update(Parser* parser) {
     }
     
     // WHERE clause
-    stmt->where_clause = parse_where_clause(parser);
-    stmt->has_where = (stmt->where_clause != NULL);
+    if (!parse_where_clause(parser, stmt)) {
+        free_parsed_statement(stmt);
+        return NULL;
+    }
     
     return stmt;
 }
@@ -415,8 +741,31 @@ static ParsedStatement* parse_delete(Parser* parser) {
     parser_advance(parser); // Skip DELETE
     
     // WHERE clause
-    stmt->where_clause = parse_where_clause(parser);
-    stmt->has_where = (stmt->where_clause != NULL);
+    if (!parse_where_clause(parser, stmt)) {
+        free_parsed_statement(stmt);
+        return NULL;
+    }
+    
+    return stmt;
+}
+
+// ANALYZE [table]
+static ParsedStatement* parse_analyze(Parser* parser) {
+    ParsedStatement* stmt = malloc(sizeof(ParsedStatement));
+    memset(stmt, 0, sizeof(ParsedStatement));
+    stmt->type = STMT_ANALYZE;
+    
+    parser_advance(parser); // Skip ANALYZE
+    
+    if (parser->current_token->type == TOKEN_IDENTIFIER) {
+        strncpy(stmt->table_name, parser->current_token->value, 63);
+        parser_advance(parser);
+    }
+    if (parser->current_token->type != TOKEN_EOF &&
+        parser->current_token->type != TOKEN_SEMICOLON) {
+        free(stmt);
+        return NULL;
+    }
     
     return stmt;
 }
@@ -429,10 +778,15 @@ ParsedStatement* parse_statement(const char* input) {
     
     ParsedStatement* stmt = NULL;
     bool is_explain = false;
+    bool is_explain_analyze = false;
     
     if (parser.current_token->type == TOKEN_EXPLAIN) {
         is_explain = true;
         parser_advance(&parser);
+        if (parser.current_token->type == TOKEN_ANALYZE) {
+            is_explain_analyze = true;
+            parser_advance(&parser);
+        }
     }
     
     switch (parser.current_token->type) {
@@ -448,6 +802,7 @@ ParsedStatement* parse_statement(const char* input) {
                 parser.lexer = lexer_init(input);
                 parser.current_token = NULL;
                 if (is_explain) parser_advance(&parser); // Skip EXPLAIN if present
+                if (is_explain_analyze) parser_advance(&parser); // ...and ANALYZE
                 parser_advance(&parser); // Now at CREATE
                 stmt = parse_create_table(&parser);
             } else if (parser.current_token->type == TOKEN_INDEX) {
@@ -459,6 +814,7 @@ ParsedStatement* parse_statement(const char* input) {
                 parser.lexer = lexer_init(input);
                 parser.current_token = NULL;
                 if (is_explain) parser_advance(&parser); // Skip EXPLAIN if present
+                if (is_explain_analyze) parser_advance(&parser); // ...and ANALYZE
                 parser_advance(&parser); // Now at CREATE
                 stmt = parse_create_index(&parser);
             }
@@ -475,12 +831,16 @@ ParsedStatement* parse_statement(const char* input) {
         case TOKEN_DELETE:
             stmt = parse_delete(&parser);
             break;
+        case TOKEN_ANALYZE:
+            stmt = parse_analyze(&parser);
+            break;
         default:
             break;
     }
     
     if (stmt) {
         stmt->is_explain = is_explain;
+        stmt->is_explain_analyze = is_explain_analyze;
     }
     
     token_free(parser.current_token);
@@ -492,12 +852,8 @@ ParsedStatement* parse_statement(const char* input) {
 void free_parsed_statement(ParsedStatement* stmt) {
     if (!stmt) return;
     
-    if (stmt->where_clause) {
-        free(stmt->where_clause->column);
-        free(stmt->where_clause->operator);
-        free(stmt->where_clause->value);
-        free(stmt->where_clause);
-    }
+    free_conditions(stmt->where_clause);
+    free_where_tree(stmt->where_tree);
     
     if (stmt->assignments) {
         for (int i = 0; i < stmt->num_assignments; i++) {
@@ -511,9 +867,7 @@ void free_parsed_statement(ParsedStatement* stmt) {
         free(stmt->columns);
     }
     
-    if (stmt->join_clause) {  // <-- ADD
-        free(stmt->join_clause);
-    }
+    free(stmt->join_clause);
     
     free(stmt);
 }
@@ -13,7 +13,8 @@ typedef enum {
     STMT_UPDATE,
     STMT_DELETE,
     STMT_CREATE_TABLE,
-    STMT_CREATE_INDEX
+    STMT_CREATE_INDEX,
+    STMT_ANALYZE
 } StatementType;
 
 typedef enum {
@@ -30,17 +31,53 @@ typedef struct {
     char* value;
 } Assignment;
 
-typedef struct {
+typedef enum {
+    OP_EQUALS,
+    OP_NOT_EQUALS,
+    OP_LESS,
+    OP_LESS_EQUALS,
+    OP_GREATER,
+    OP_GREATER_EQUALS,
+    OP_LIKE,
+    OP_BETWEEN
+} ConditionOp;
+
+// column op value, where op is =, !=, <, <=, >, >=, LIKE or BETWEEN
+typedef struct Condition {
     char* column;
     char* operator;
+    ConditionOp op;          // The operator, decoded
     char* value;
+    char* value2;            // Upper bound for BETWEEN, otherwise NULL
+    uint32_t position;       // Place in the WHERE list, counting from 0
+    bool conjunct;           // Holds for every matching row: a term of the top-level AND
+    struct Condition* next;  // Next condition of the WHERE list
 } Condition;
 
+typedef enum {
+    WHERE_CONDITION,
+    WHERE_AND,
+    WHERE_OR
+} WhereNodeType;
+
+// A WHERE expression: one condition, or the AND / OR of two expressions
+typedef struct WhereNode {
+    WhereNodeType type;
+    Condition* condition;    // WHERE_CONDITION only
+    struct WhereNode* left;
+    struct WhereNode* right;
+} WhereNode;
+
+#define MAX_JOIN_TABLES 8        // As many tables as a database holds
+
+// One ON equality, left_table.left_column = right_table.right_column
 typedef struct {
     char left_table[64];
     char right_table[64];
     char left_column[32];
     char right_column[32];
+    int left_position;       // Each side's place among the statement's join tables, -1 if absent
+    int right_position;
 } JoinClause;
 
 typedef struct {
@@ -48,11 +85,15 @@ typedef struct {
     Row row_to_insert;
     Assignment* assignments;
     int num_assignments;
-    Condition* where_clause;
+    Condition* where_clause;    // Every condition of the WHERE clause, in text order
+    WhereNode* where_tree;      // ...and how AND, OR and parentheses combine them
     bool has_where;
+    bool where_is_or;           // The clause is conditions joined by OR alone
+    bool where_is_nested;       // The clause mixes AND and OR
     bool is_explain;
+    bool is_explain_analyze;    // EXPLAIN ANALYZE: run the statement and measure it
     
-    // For CREATE TABLE
+    // For CREATE TABLE, and ANALYZE (empty for every table)
     char table_name[64];
     ColumnDef* columns;
     uint32_t num_columns;
@@ -60,6 +101,14 @@ typedef struct {
     // For CREATE INDEX  
     char index_table[64];
     char index_column[32];
+    IndexType index_type;
+    char index_include[MAX_COLUMNS][MAX_COLUMN_NAME];
+    uint32_t num_index_include;
+    uint32_t index_flags;       // INDEX_FLAG_* from WITH options
+    
+    // SELECT column list; empty for SELECT *
+    char select_columns[MAX_COLUMNS][MAX_COLUMN_NAME];
+    uint32_t num_select_columns;
     
     // For aggregations
     AggregationType agg_type;
@@ -73,8 +122,11 @@ typedef struct {
     uint32_t limit;
     bool has_limit;
     
-    // For JOIN  
+    // For JOIN: the tables in FROM / JOIN order, and every ON equality
     JoinClause* join_clause;
+    uint32_t num_join_clauses;
+    char join_tables[MAX_JOIN_TABLES][64];
+    uint32_t num_join_tables;
     bool has_join;
     char from_table[64];  // For multi-table support
 } ParsedStatement;
@@ -82,5 +134,10 @@ typedef struct {
 // Function declarations
 ParsedStatement* parse_statement(const char* input);
 void free_parsed_statement(ParsedStatement* stmt);
+bool condition_matches(const Condition* condition, const char* value, bool numeric);
+bool condition_compare(const Condition* condition, int cmp, int cmp_upper);
+bool like_match(const char* pattern, const char* value);
+bool where_is_single(const ParsedStatement* stmt);
+size_t condition_like_prefix(const Condition* condition, char* prefix, size_t size);
 
 #endif // PARSER_H
@@ -7,6 +7,8 @@
 #include <errno.h>
 #include <sys/stat.h>
 
+static PagerCounters counters;
+
 Pager* pager_open(const char* filename) {
     int fd = open(filename, O_RDWR | O_CREAT, S_IWUSR | S_IRUSR);
     
@@ -32,6 +34,12 @@ Pager* pager_open(const char* filename) {
         pager->pages[i] = NULL;
     }
     
+    pager->dirty_pages = NULL;
+    pager->num_dirty = 0;
+    pager->dirty_capacity = 0;
+    memset(pager->dirty_map, 0, sizeof(pager->dirty_map));
+    memset(pager->logged_map, 0, sizeof(pager->logged_map));
+    
     return pager;
 }
 
@@ -64,13 +72,17 @@ Page* pager_get_page(Pager* pager, uint32_t page_num) {
                 printf("Error reading file: %d\n", errno);
                 exit(EXIT_FAILURE);
             }
+            counters.reads += bytes_read > 0;
         }
         
         pager->pages[page_num] = page;
+        counters.misses++;
         
         if (page_num >= pager->num_pages) {
             pager->num_pages = page_num + 1;
         }
+    } else {
+        counters.hits++;
     }
     
     return pager->pages[page_num];
@@ -97,6 +109,51 @@ void pager_flush(Pager* pager, uint32_t page_num) {
         printf("Error writing: %d\n", errno);
         exit(EXIT_FAILURE);
     }
+    counters.writes++;
+}
+
+/*
+ * Fetch a page that the caller is about to modify. The page is recorded
+ * in the dirty set so the next WAL append knows what changed.
+ */
+Page* pager_get_page_for_write(Pager* pager, uint32_t page_num) {
+    Page* page = pager_get_page(pager, page_num);
+    pager_mark_dirty(pager, page_num);
+    return page;
+}
+
+void pager_mark_dirty(Pager* pager, uint32_t page_num) {
+    if (pager->dirty_map[page_num / 8] & (1 << (page_num % 8))) {
+        return;
+    }
+    pager->dirty_map[page_num / 8] |= (1 << (page_num % 8));
+    
+    if (pager->num_dirty >= pager->dirty_capacity) {
+        pager->dirty_capacity = pager->dirty_capacity ? pager->dirty_capacity * 2 : 16;
+        pager->dirty_pages = realloc(pager->dirty_pages,
+                                     sizeof(uint32_t) * pager->dirty_capacity);
+    }
+    pager->dirty_pages[pager->num_dirty++] = page_num;
+}
+
+void pager_clear_dirty(Pager* pager) {
+    for (uint32_t i = 0; i < pager->num_dirty; i++) {
+        uint32_t page_num = pager->dirty_pages[i];
+        pager->dirty_map[page_num / 8] &= ~(1 << (page_num % 8));
+    }
+    pager->num_dirty = 0;
+}
+
+bool pager_is_logged(Pager* pager, uint32_t page_num) {
+    return (pager->logged_map[page_num / 8] & (1 << (page_num % 8))) != 0;
+}
+
+void pager_set_logged(Pager* pager, uint32_t page_num) {
+    pager->logged_map[page_num / 8] |= (1 << (page_num % 8));
+}
+
+void pager_clear_logged(Pager* pager) {
+    memset(pager->logged_map, 0, sizeof(pager->logged_map));
 }
 
 void pager_close(Pager* pager) {
@@ -110,5 +167,17 @@ void pager_close(Pager* pager) {
     }
     
     close(pager->file_descriptor);
+    free(pager->dirty_pages);
     free(pager);
 }
+
+// fsync a table or schema file, counted with the pagers' activity
+void pager_sync_file(int fd) {
+    fsync(fd);
+    counters.syncs++;
+}
+
+// Hits, misses, file reads and writes of every pager so far
+PagerCounters pager_counters(void) {
+    return counters;
+}
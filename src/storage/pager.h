@@ -7,6 +7,7 @@
 
 #define PAGE_SIZE 4096
 #define TABLE_MAX_PAGES 100000
+#define PAGER_BITMAP_BYTES ((TABLE_MAX_PAGES + 7) / 8)
 
 // A page is the basic unit of storage
 typedef struct {
@@ -19,12 +20,38 @@ typedef struct {
     uint32_t file_length;
     uint32_t num_pages;
     Page* pages[TABLE_MAX_PAGES];
+    
+    // Pages modified since the last WAL append, in first-touch order
+    uint32_t* dirty_pages;
+    uint32_t num_dirty;
+    uint32_t dirty_capacity;
+    uint8_t dirty_map[PAGER_BITMAP_BYTES];
+    
+    // Pages whose full image is already in the WAL since the last checkpoint
+    uint8_t logged_map[PAGER_BITMAP_BYTES];
 } Pager;
 
+// Page requests since startup, summed over every pager
+typedef struct {
+    uint64_t hits;     // Page was already cached
+    uint64_t misses;   // Page was loaded on first use
+    uint64_t reads;    // Misses that read the page from the file
+    uint64_t writes;   // Pages written back to their file
+    uint64_t syncs;    // fsyncs of table and schema files
+} PagerCounters;
+
 // Function declarations
 Pager* pager_open(const char* filename);
 void pager_close(Pager* pager);
 Page* pager_get_page(Pager* pager, uint32_t page_num);
 void pager_flush(Pager* pager, uint32_t page_num);
+Page* pager_get_page_for_write(Pager* pager, uint32_t page_num);
+void pager_mark_dirty(Pager* pager, uint32_t page_num);
+void pager_clear_dirty(Pager* pager);
+bool pager_is_logged(Pager* pager, uint32_t page_num);
+void pager_set_logged(Pager* pager, uint32_t page_num);
+void pager_clear_logged(Pager* pager);
+void pager_sync_file(int fd);
+PagerCounters pager_counters(void);
 
 #endif // PAGER_H
@@ -1,4 +1,5 @@
 #include "schema.h"
+#include "pager.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -12,6 +13,8 @@ Schema* schema_create() {
 }
 
 void schema_free(Schema* schema) {
+    free(schema->indexes);
+    free(schema->column_stats);
     free(schema);
 }
 
@@ -56,6 +59,50 @@ TableSchema* schema_get_table(Schema* schema, const char* table_name) {
     return NULL;
 }
 
+bool schema_add_index(Schema* schema, const IndexDef* def) {
+    if (schema->num_indexes >= schema->indexes_capacity) {
+        uint32_t capacity = schema->indexes_capacity ? schema->indexes_capacity * 2 : 8;
+        IndexDef* indexes = realloc(schema->indexes, sizeof(IndexDef) * capacity);
+        if (!indexes) {
+            printf("Error: Out of memory for index definitions\n");
+            return false;
+        }
+        schema->indexes = indexes;
+        schema->indexes_capacity = capacity;
+    }
+    
+    schema->indexes[schema->num_indexes++] = *def;
+    return true;
+}
+
+// Replace every statistic of table_name with the count given
+void schema_set_column_stats(Schema* schema, const char* table_name,
+                             const ColumnStats* stats, uint32_t count) {
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < schema->num_column_stats; i++) {
+        if (strcmp(schema->column_stats[i].table_name, table_name) != 0) {
+            schema->column_stats[kept++] = schema->column_stats[i];
+        }
+    }
+    
+    schema->column_stats = realloc(schema->column_stats, sizeof(ColumnStats) * (kept + count));
+    memcpy(&schema->column_stats[kept], stats, sizeof(ColumnStats) * count);
+    schema->num_column_stats = kept + count;
+}
+
+// NULL until ANALYZE has run on the table
+const ColumnStats* schema_get_column_stats(Schema* schema, const char* table_name,
+                                           const char* column_name) {
+    for (uint32_t i = 0; i < schema->num_column_stats; i++) {
+        const ColumnStats* stats = &schema->column_stats[i];
+        if (strcmp(stats->table_name, table_name) == 0 &&
+            strcmp(stats->column_name, column_name) == 0) {
+            return stats;
+        }
+    }
+    return NULL;
+}
+
 void schema_print(Schema* schema) {
     printf("\n=== Database Schema ===\n");
     printf("Tables: %u\n\n", schema->num_tables);
@@ -91,6 +138,37 @@ void schema_print(Schema* schema) {
         }
         printf("\n");
     }
+    
+    if (schema->num_indexes > 0) {
+        printf("Indexes:\n");
+        for (uint32_t i = 0; i < schema->num_indexes; i++) {
+            IndexDef* def = &schema->indexes[i];
+            printf("  - %s (%s)%s", def->table_name, def->column_name,
+                   def->type == INDEX_TYPE_HASH ? " USING HASH" :
+                   def->type == INDEX_TYPE_BITMAP ? " USING BITMAP" : "");
+            if (def->include_columns & (INDEX_COLUMN_USERNAME | INDEX_COLUMN_EMAIL)) {
+                bool both = (def->include_columns & INDEX_COLUMN_USERNAME) &&
+                            (def->include_columns & INDEX_COLUMN_EMAIL);
+                printf(" INCLUDE (%s%s%s)",
+                       def->include_columns & INDEX_COLUMN_USERNAME ? "username" : "",
+                       both ? ", " : "",
+                       def->include_columns & INDEX_COLUMN_EMAIL ? "email" : "");
+            }
+            printf("%s\n", def->flags & INDEX_FLAG_BLOOM ? " WITH BLOOM" : "");
+        }
+        printf("\n");
+    }
+    
+    if (schema->num_column_stats > 0) {
+        printf("Statistics:\n");
+        for (uint32_t i = 0; i < schema->num_column_stats; i++) {
+            ColumnStats* stats = &schema->column_stats[i];
+            printf("  - %s.%s: %u rows (%u sampled), ~%u distinct, %u histogram buckets\n",
+                   stats->table_name, stats->column_name, stats->row_count,
+                   stats->sampled_rows, stats->distinct_count, stats->num_buckets);
+        }
+        printf("\n");
+    }
     printf("=====================\n\n");
 }
 
@@ -103,7 +181,17 @@ bool schema_save(Schema* schema, const char* filename) {
         return false;
     }
     
-    write(fd, schema, sizeof(Schema));
+    uint32_t def_size = sizeof(IndexDef);
+    write(fd, schema, SCHEMA_TABLES_SIZE);
+    write(fd, &schema->num_indexes, sizeof(uint32_t));
+    write(fd, &def_size, sizeof(uint32_t));
+    write(fd, schema->indexes, def_size * schema->num_indexes);
+    
+    uint32_t stats_size = sizeof(ColumnStats);
+    write(fd, &schema->num_column_stats, sizeof(uint32_t));
+    write(fd, &stats_size, sizeof(uint32_t));
+    write(fd, schema->column_stats, stats_size * schema->num_column_stats);
+    pager_sync_file(fd);
     close(fd);
     return true;
 }
@@ -118,14 +206,45 @@ Schema* schema_load(const char* filename) {
         return schema_create();
     }
     
-    Schema* schema = malloc(sizeof(Schema));
-    ssize_t bytes_read = read(fd, schema, sizeof(Schema));
-    close(fd);
+    Schema* schema = schema_create();
+    ssize_t bytes_read = read(fd, schema, SCHEMA_TABLES_SIZE);
     
-    if (bytes_read < (ssize_t)sizeof(Schema)) {
+    if (bytes_read < (ssize_t)SCHEMA_TABLES_SIZE) {
+        close(fd);
         free(schema);
         return schema_create();
     }
     
+    // Index definitions follow; files from older builds end here
+    uint32_t counts[2];
+    if (read(fd, counts, sizeof(counts)) == sizeof(counts)) {
+        uint32_t def_size = counts[1];
+        for (uint32_t i = 0; i < counts[0]; i++) {
+            char record[256];
+            if (def_size > sizeof(record) || read(fd, record, def_size) != (ssize_t)def_size) {
+                break;
+            }
+            IndexDef def;
+            memset(&def, 0, sizeof(IndexDef));
+            memcpy(&def, record, def_size < sizeof(IndexDef) ? def_size : sizeof(IndexDef));
+            if (!schema_add_index(schema, &def)) {
+                break;
+            }
+        }
+    }
+    
+    // Then the statistics; a record of another size is from another build
+    if (read(fd, counts, sizeof(counts)) == sizeof(counts) && counts[1] == sizeof(ColumnStats)) {
+        ColumnStats* stats = malloc(sizeof(ColumnStats) * counts[0]);
+        if (stats && read(fd, stats, sizeof(ColumnStats) * counts[0]) ==
+                         (ssize_t)(sizeof(ColumnStats) * counts[0])) {
+            schema->column_stats = stats;
+            schema->num_column_stats = counts[0];
+        } else {
+            free(stats);
+        }
+    }
+    close(fd);
+    
     return schema;
 }
@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 #define MAX_TABLE_NAME 32
 #define MAX_COLUMN_NAME 32
@@ -30,17 +31,99 @@ typedef struct {
     uint32_t primary_key_index;
 } TableSchema;
 
+typedef enum {
+    INDEX_TYPE_BTREE,
+    INDEX_TYPE_HASH,
+    INDEX_TYPE_BITMAP
+} IndexType;
+
+#define INDEX_NUM_TYPES 3
+
+// Physical row columns; the index catalog keys indexes by these ids
+typedef enum {
+    ROW_COLUMN_ID,
+    ROW_COLUMN_USERNAME,
+    ROW_COLUMN_EMAIL
+} RowColumn;
+
+#define INDEX_NUM_COLUMNS 3
+
+// Row columns as bits of IndexDef.include_columns
+#define INDEX_COLUMN_ID (1u << ROW_COLUMN_ID)
+#define INDEX_COLUMN_USERNAME (1u << ROW_COLUMN_USERNAME)
+#define INDEX_COLUMN_EMAIL (1u << ROW_COLUMN_EMAIL)
+#define INDEX_COLUMN_ALL (INDEX_COLUMN_ID | INDEX_COLUMN_USERNAME | INDEX_COLUMN_EMAIL)
+
+/*
+ * A secondary index; its entries live in "<db>.<table>.<column>.idx"
+ * (B+tree), "<db>.<table>.<column>.hash" (hash) or
+ * "<db>.<table>.<column>.bitmap" (bitmap). Fields after column_name are
+ * absent (zero) in older schema files.
+ */
+typedef struct {
+    char table_name[MAX_TABLE_NAME];
+    char column_name[MAX_COLUMN_NAME];
+    uint32_t type;             // IndexType
+    uint32_t include_columns;  // INCLUDE columns stored with each entry
+    uint32_t flags;            // INDEX_FLAG_* options
+} IndexDef;
+
+// IndexDef.flags: keep a Bloom filter of the keys (WITH BLOOM)
+#define INDEX_FLAG_BLOOM (1u << 0)
+
+/*
+ * Column statistics gathered by ANALYZE from a sample of a table's leaf
+ * pages. The histogram is equi-depth: each bucket holds about the same
+ * share of the sampled rows, and bounds[i] is the largest value in
+ * bucket i, so selectivity is read off by counting buckets. Values are
+ * stored as text, truncated to STATS_VALUE_SIZE - 1 bytes; the id column
+ * compares them as numbers.
+ */
+#define STATS_HISTOGRAM_BUCKETS 32
+#define STATS_VALUE_SIZE 32
+
+typedef struct {
+    char table_name[MAX_TABLE_NAME];
+    char column_name[MAX_COLUMN_NAME];
+    uint32_t column_id;        // RowColumn
+    uint32_t row_count;        // Table rows when analyzed
+    uint32_t sampled_rows;
+    uint32_t distinct_count;   // HyperLogLog estimate, scaled to the table
+    uint32_t num_buckets;
+    char min_value[STATS_VALUE_SIZE];
+    char bounds[STATS_HISTOGRAM_BUCKETS][STATS_VALUE_SIZE];
+} ColumnStats;
+
 typedef struct {
     TableSchema tables[MAX_TABLES];
     uint32_t num_tables;
+    IndexDef* indexes;          // Grows as indexes are created
+    uint32_t num_indexes;
+    uint32_t indexes_capacity;
+    ColumnStats* column_stats;  // Replaced table by table on ANALYZE
+    uint32_t num_column_stats;
 } Schema;
 
+/*
+ * Schema file layout: the table part of Schema (everything up to and
+ * including num_tables, which is all older builds wrote), then
+ * num_indexes, the size of one IndexDef, and the IndexDefs, then
+ * num_column_stats, the size of one ColumnStats, and the ColumnStats.
+ * Each later part is optional, since older builds stopped before it.
+ */
+#define SCHEMA_TABLES_SIZE (offsetof(Schema, num_tables) + sizeof(uint32_t))
+
 // Function declarations
 Schema* schema_create();
 void schema_free(Schema* schema);
 bool schema_add_table(Schema* schema, const char* table_name, 
                       ColumnDef* columns, uint32_t num_columns);
 TableSchema* schema_get_table(Schema* schema, const char* table_name);
+bool schema_add_index(Schema* schema, const IndexDef* def);
+void schema_set_column_stats(Schema* schema, const char* table_name,
+                             const ColumnStats* stats, uint32_t count);
+const ColumnStats* schema_get_column_stats(Schema* schema, const char* table_name,
+                                           const char* column_name);
 void schema_print(Schema* schema);
 bool schema_save(Schema* schema, const char* filename);
 Schema* schema_load(const char* filename);
@@ -19,42 +19,168 @@ void deserialize_row(void* source, Row* destination) {
     memcpy(&(destination->email), source + ID_SIZE + USERNAME_SIZE, EMAIL_SIZE);
 }
 
+/*
+ * Upgrade a file from before the header page: copy the root out of page
+ * 0 to a new page, re-parent its children and write the header in its
+ * place. The pages are dirtied like any change, so the move reaches the
+ * file through the WAL together with the first statement that modifies
+ * the table.
+ */
+static void table_move_legacy_root(Table* table) {
+    Pager* pager = table->pager;
+    uint32_t root_page_num = get_unused_page_num(pager);
+    void* old_root = pager_get_page_for_write(pager, 0);
+    void* root = pager_get_page_for_write(pager, root_page_num);
+    memcpy(root, old_root, PAGE_SIZE);
+    
+    if (get_node_type(root) == NODE_INTERNAL) {
+        uint32_t num_keys = *internal_node_num_keys(root);
+        for (uint32_t i = 0; i <= num_keys; i++) {
+            uint32_t child = *internal_node_child(root, i);
+            if (child != INVALID_PAGE_NUM) {
+                *node_parent(pager_get_page_for_write(pager, child)) = root_page_num;
+            }
+        }
+    }
+    
+    memset(old_root, 0, PAGE_SIZE);
+    table->header->magic = TABLE_HEADER_MAGIC;
+    table->header->root_page_num = root_page_num;
+    table->root_page_num = root_page_num;
+    table_stats_recount(table);
+}
+
+// Count the rows and pages under page_num; returns the subtree's height
+static uint32_t table_stats_walk(Table* table, uint32_t page_num) {
+    void* node = pager_get_page(table->pager, page_num);
+    if (get_node_type(node) == NODE_LEAF) {
+        TableHeader* header = table->header;
+        uint32_t num_cells = *leaf_node_num_cells(node);
+        for (uint32_t i = 0; i < num_cells; i++) {
+            uint32_t key = *leaf_node_key(node, i);
+            if (header->row_count + i == 0 || key < header->id_min) {
+                header->id_min = key;
+            }
+            if (header->row_count + i == 0 || key > header->id_max) {
+                header->id_max = key;
+            }
+            header->id_sum += key;
+        }
+        header->leaf_pages++;
+        header->row_count += num_cells;
+        return 1;
+    }
+    
+    table->header->internal_pages++;
+    uint32_t height = 0;
+    uint32_t num_keys = *internal_node_num_keys(node);
+    for (uint32_t i = 0; i <= num_keys; i++) {
+        uint32_t child = *internal_node_child(node, i);
+        if (child != INVALID_PAGE_NUM) {
+            uint32_t child_height = table_stats_walk(table, child);
+            if (child_height > height) {
+                height = child_height;
+            }
+        }
+    }
+    return height + 1;
+}
+
+/*
+ * Rebuild the header's statistics from the tree. Only needed when the
+ * header cannot be trusted: after a crash, or for an upgraded file.
+ */
+void table_stats_recount(Table* table) {
+    TableHeader* header = table->header;
+    header->row_count = 0;
+    header->leaf_pages = 0;
+    header->internal_pages = 0;
+    header->id_min = 0;
+    header->id_max = 0;
+    header->id_sum = 0;
+    header->tree_height = table_stats_walk(table, header->root_page_num);
+    header->stats_clean = 0;
+    header->id_summary = TABLE_ID_SUMMARY;
+}
+
+// Fraction of leaf cell slots in use
+double table_leaf_fill(Table* table) {
+    TableHeader* header = table->header;
+    if (header->leaf_pages == 0) {
+        return 0.0;
+    }
+    return (double)header->row_count / ((double)header->leaf_pages * LEAF_NODE_MAX_CELLS);
+}
+
+void table_stats_print(Table* table) {
+    TableHeader* header = table->header;
+    printf("\n=== Table %s ===\n", table->name);
+    printf("Rows: %u\n", header->row_count);
+    printf("Pages: %u (%u leaf, %u internal)\n", header->leaf_pages + header->internal_pages,
+           header->leaf_pages, header->internal_pages);
+    printf("Tree Height: %u\n", header->tree_height);
+    printf("Leaf Fill: %.1f%%\n", table_leaf_fill(table) * 100);
+}
+
 Table* table_open(const char* filename) {
     Pager* pager = pager_open(filename);
     Table* table = malloc(sizeof(Table));
     table->pager = pager;
     
-    // Open WAL
-    table->wal = wal_open(filename);
-    if (!table->wal) {
-        printf("Warning: Could not open WAL file.\n");
-    } else {
-        // Recover from WAL if needed
-        if (table->wal->frame_count > 0) {
-            wal_recover(table->wal, pager);
+    table->wal = NULL;
+    table->wal_table_id = 0;
+    
+    // Older builds kept a WAL per table; replay and remove it
+    char wal_filename[512];
+    snprintf(wal_filename, sizeof(wal_filename), "%s-wal", filename);
+    if (access(wal_filename, F_OK) == 0) {
+        WAL* wal = wal_open_with_segment_size(filename, 0);
+        if (wal) {
+            if (wal->frame_count > 0) {
+                wal_register_table(wal, filename, pager);
+                wal_recover(wal);
+            }
+            wal_close(wal);
+            unlink(wal_filename);
         }
     }
     
     if (pager->num_pages == 0) {
-        // New database file. Initialize page 0 as leaf node
-        void* root_node = pager_get_page(pager, 0);
+        // New database file: header in page 0, an empty root leaf in page 1
+        table->header = (TableHeader*)pager_get_page_for_write(pager, 0);
+        void* root_node = pager_get_page_for_write(pager, 1);
         initialize_leaf_node(root_node);
         set_node_root(root_node, true);
-        pager->num_pages = 1;
+        
+        table->header->magic = TABLE_HEADER_MAGIC;
+        table->header->root_page_num = 1;
+        table->header->leaf_pages = 1;
+        table->header->tree_height = 1;
+        table->header->id_summary = TABLE_ID_SUMMARY;
+    } else {
+        table->header = (TableHeader*)pager_get_page(pager, 0);
+        if (table->header->magic != TABLE_HEADER_MAGIC) {
+            table_move_legacy_root(table);
+        } else if (table->header->stats_clean && table->header->id_summary == TABLE_ID_SUMMARY) {
+            // From here on the statistics run ahead of the file until the
+            // next clean close; a crash must find them marked stale
+            table->header->stats_clean = 0;
+            pager_flush(pager, 0);
+            pager_sync_file(pager->file_descriptor);
+        } else {
+            table_stats_recount(table);
+        }
     }
     
-    table->root_page_num = 0;
+    table->root_page_num = table->header->root_page_num;
     return table;
 }
 
 void table_close(Table* table) {
     Pager* pager = table->pager;
     
-    // Checkpoint WAL before closing
-    if (table->wal) {
-        wal_checkpoint(table->wal, pager);
-        wal_close(table->wal);
-    }
+    // Every page is written below, so the statistics match the file
+    table->header->stats_clean = 1;
     
     for (uint32_t i = 0; i < pager->num_pages; i++) {
         if (pager->pages[i] == NULL) {
@@ -79,20 +205,46 @@ void table_close(Table* table) {
         }
     }
     
+    free(pager->dirty_pages);
     free(pager);
     free(table);
 }
 
-Cursor* table_start(Table* table) {
-    Cursor* cursor = table_find(table, 0);
+/*
+ * Move a cursor sitting past the last cell of its leaf onto the first
+ * cell of the next non-empty leaf. Deletes never merge leaves, so a scan
+ * can meet leaves with no cells at all.
+ */
+static void cursor_skip_empty_leaves(Cursor* cursor) {
+    void* node = pager_get_page(cursor->table->pager, cursor->page_num);
+    
+    while (cursor->cell_num >= *leaf_node_num_cells(node)) {
+        uint32_t next_page_num = *leaf_node_next_leaf(node);
+        if (next_page_num == 0) {
+            /* This was rightmost leaf */
+            cursor->end_of_table = true;
+            return;
+        }
+        cursor->page_num = next_page_num;
+        cursor->cell_num = 0;
+        node = pager_get_page(cursor->table->pager, next_page_num);
+    }
+}
+
+// Cursor at the first row whose id is at least key
+Cursor* table_seek(Table* table, uint32_t key) {
+    Cursor* cursor = table_find(table, key);
     
-    void* node = pager_get_page(table->pager, cursor->page_num);
-    uint32_t num_cells = *leaf_node_num_cells(node);
-    cursor->end_of_table = (num_cells == 0);
+    cursor->end_of_table = false;
+    cursor_skip_empty_leaves(cursor);
     
     return cursor;
 }
 
+Cursor* table_start(Table* table) {
+    return table_seek(table, 0);
+}
+
 Cursor* table_end(Table* table) {
     Cursor* cursor = malloc(sizeof(Cursor));
     cursor->table = table;
@@ -113,19 +265,7 @@ void* cursor_value(Cursor* cursor) {
 }
 
 void cursor_advance(Cursor* cursor) {
-    uint32_t page_num = cursor->page_num;
-    void* node = pager_get_page(cursor->table->pager, page_num);
-    
     cursor->cell_num += 1;
-    if (cursor->cell_num >= (*leaf_node_num_cells(node))) {
-        /* Advance to next leaf node */
-        uint32_t next_page_num = *leaf_node_next_leaf(node);
-        if (next_page_num == 0) {
-            /* This was rightmost leaf */
-            cursor->end_of_table = true;
-        } else {
-            cursor->page_num = next_page_num;
-            cursor->cell_num = 0;
-        }
-    }
+    /* Advance to next leaf node */
+    cursor_skip_empty_leaves(cursor);
 }
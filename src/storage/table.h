@@ -23,10 +23,49 @@ typedef struct {
     char email[COLUMN_EMAIL_SIZE];
 } Row;
 
+/*
+ * Table header page (page 0)
+ *
+ * Holds the root page number and the planner's statistics. The B+tree
+ * insert, delete and split paths keep the statistics current in memory,
+ * so planning reads them instead of walking the tree. Updating them does
+ * not dirty the page (that would turn every logged insert into two page
+ * images); checkpoints and close write it back with the other cached
+ * pages.
+ *
+ * A clean close sets stats_clean and opening clears it on disk, so after
+ * a crash, whose WAL replay the header never saw, the statistics are
+ * recounted once at open. Files from before the header had their root
+ * in page 0; opening one moves the root to a new page.
+ *
+ * The id aggregates answer COUNT(*) and SUM/AVG/MIN/MAX(id) without a
+ * scan. Ids never change in place, so only inserts and deletes touch
+ * them. Files from before they were kept have id_summary unset and are
+ * recounted at open.
+ */
+#define TABLE_HEADER_MAGIC 0x4c425454  // "TTBL"
+#define TABLE_ID_SUMMARY 0x4d555349    // "ISUM": the id aggregates are kept
+
+typedef struct {
+    uint32_t magic;
+    uint32_t root_page_num;
+    uint32_t row_count;
+    uint32_t leaf_pages;
+    uint32_t internal_pages;
+    uint32_t tree_height;      // Levels, 1 for a lone root leaf
+    uint32_t stats_clean;      // Written by a clean close
+    uint32_t id_summary;       // TABLE_ID_SUMMARY once the fields below are kept
+    uint32_t id_min;           // Smallest and largest id, meaningless when empty
+    uint32_t id_max;
+    uint64_t id_sum;
+} TableHeader;
+
 typedef struct {
     Pager* pager;
     uint32_t root_page_num;
-    WAL* wal;
+    TableHeader* header;  // Page 0, resident for the table's lifetime
+    WAL* wal;            // Database-wide log, owned by the TableManager
+    uint32_t wal_table_id;
     char name[64];  
 } Table;
 
@@ -42,8 +81,12 @@ void deserialize_row(void* source, Row* destination);
 void* cursor_value(Cursor* cursor);
 Cursor* table_start(Table* table);
 Cursor* table_find(Table* table, uint32_t key);
+Cursor* table_seek(Table* table, uint32_t key);
 void cursor_advance(Cursor* cursor);
 Table* table_open(const char* filename);
 void table_close(Table* table);
+void table_stats_recount(Table* table);
+double table_leaf_fill(Table* table);
+void table_stats_print(Table* table);
 
 #endif // TABLE_H
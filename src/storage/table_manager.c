@@ -7,11 +7,21 @@ TableManager* table_manager_create(const char* base_path) {
     TableManager* manager = malloc(sizeof(TableManager));
     memset(manager, 0, sizeof(TableManager));
     strncpy(manager->base_path, base_path, 255);
+    
+    manager->wal = wal_open(base_path);
+    if (!manager->wal) {
+        printf("Warning: Could not open WAL file.\n");
+    } else if (manager->wal->frame_count > 0) {
+        // Rebuild every table the log touched in one pass
+        wal_recover(manager->wal);
+    }
+    
     return manager;
 }
 
 void table_manager_free(TableManager* manager) {
     table_manager_close_all(manager);
+    wal_close(manager->wal);
     free(manager);
 }
 
@@ -37,6 +47,10 @@ Table* table_manager_open(TableManager* manager, const char* table_name) {
     }
     
     strncpy(table->name, table_name, 63);
+    if (manager->wal) {
+        table->wal = manager->wal;
+        table->wal_table_id = wal_register_table(manager->wal, table_name, table->pager);
+    }
     manager->tables[manager->num_tables] = table;
     strncpy(manager->table_names[manager->num_tables], table_name, 63);
     manager->num_tables++;
@@ -54,6 +68,12 @@ Table* table_manager_get(TableManager* manager, const char* table_name) {
 }
 
 void table_manager_close_all(TableManager* manager) {
+    // One checkpoint writes back every table before they are closed
+    if (manager->wal) {
+        wal_checkpoint(manager->wal);
+        manager->wal->num_tables = 0;
+    }
+    
     for (uint32_t i = 0; i < manager->num_tables; i++) {
         if (manager->tables[i]) {
             table_close(manager->tables[i]);
@@ -11,6 +11,7 @@ typedef struct {
     char table_names[MAX_OPEN_TABLES][64];
     uint32_t num_tables;
     char base_path[256];
+    WAL* wal;  // One log shared by every table, "<base_path>-wal"
 } TableManager;
 
 TableManager* table_manager_create(const char* base_path);
@@ -0,0 +1,161 @@
+#include "checksum.h"
+#include <stdbool.h>
+#include <string.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <nmmintrin.h>
+#define CRC32C_HAVE_SSE42 1
+#endif
+
+#if defined(__aarch64__) && defined(__GNUC__)
+#include <arm_acle.h>
+#if defined(__linux__)
+#include <sys/auxv.h>
+#ifndef HWCAP_CRC32
+#define HWCAP_CRC32 (1 << 7)
+#endif
+#endif
+#define CRC32C_HAVE_ARMV8 1
+#endif
+
+#define CRC32C_POLY 0x82F63B78  // Reflected Castagnoli polynomial
+
+typedef uint32_t (*Crc32cFn)(uint32_t crc, const uint8_t* data, size_t length);
+
+static uint32_t crc32c_table[8][256];
+static Crc32cFn crc32c_impl = NULL;
+static const char* crc32c_impl_name = "uninitialized";
+
+/*
+ * Portable fallback: slicing-by-8, processing 8 bytes per iteration
+ * with eight 256-entry lookup tables.
+ */
+static void crc32c_init_table(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int j = 0; j < 8; j++) {
+            crc = (crc >> 1) ^ ((crc & 1) ? CRC32C_POLY : 0);
+        }
+        crc32c_table[0][i] = crc;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = crc32c_table[0][i];
+        for (int t = 1; t < 8; t++) {
+            crc = crc32c_table[0][crc & 0xFF] ^ (crc >> 8);
+            crc32c_table[t][i] = crc;
+        }
+    }
+}
+
+static uint32_t crc32c_sw(uint32_t crc, const uint8_t* data, size_t length) {
+    while (length >= 8) {
+        uint32_t lo;
+        uint32_t hi;
+        memcpy(&lo, data, 4);
+        memcpy(&hi, data + 4, 4);
+        lo ^= crc;
+        crc = crc32c_table[7][lo & 0xFF] ^
+              crc32c_table[6][(lo >> 8) & 0xFF] ^
+              crc32c_table[5][(lo >> 16) & 0xFF] ^
+              crc32c_table[4][lo >> 24] ^
+              crc32c_table[3][hi & 0xFF] ^
+              crc32c_table[2][(hi >> 8) & 0xFF] ^
+              crc32c_table[1][(hi >> 16) & 0xFF] ^
+              crc32c_table[0][hi >> 24];
+        data += 8;
+        length -= 8;
+    }
+    while (length--) {
+        crc = crc32c_table[0][(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#ifdef CRC32C_HAVE_SSE42
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42(uint32_t crc, const uint8_t* data, size_t length) {
+    uint64_t crc64 = crc;
+    while (length >= 8) {
+        uint64_t word;
+        memcpy(&word, data, 8);
+        crc64 = _mm_crc32_u64(crc64, word);
+        data += 8;
+        length -= 8;
+    }
+    crc = (uint32_t)crc64;
+    while (length--) {
+        crc = _mm_crc32_u8(crc, *data++);
+    }
+    return crc;
+}
+#endif
+
+#ifdef CRC32C_HAVE_ARMV8
+__attribute__((target("+crc")))
+static uint32_t crc32c_armv8(uint32_t crc, const uint8_t* data, size_t length) {
+    while (length >= 8) {
+        uint64_t word;
+        memcpy(&word, data, 8);
+        crc = __crc32cd(crc, word);
+        data += 8;
+        length -= 8;
+    }
+    while (length--) {
+        crc = __crc32cb(crc, *data++);
+    }
+    return crc;
+}
+#endif
+
+static void crc32c_select(void) {
+    crc32c_init_table();
+    crc32c_impl = crc32c_sw;
+    crc32c_impl_name = "portable (slicing-by-8)";
+
+#ifdef CRC32C_HAVE_SSE42
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2")) {
+        crc32c_impl = crc32c_sse42;
+        crc32c_impl_name = "x86-64 SSE4.2";
+    }
+#endif
+
+#ifdef CRC32C_HAVE_ARMV8
+#if defined(__linux__)
+    if (getauxval(AT_HWCAP) & HWCAP_CRC32) {
+        crc32c_impl = crc32c_armv8;
+        crc32c_impl_name = "ARMv8 CRC";
+    }
+#elif defined(__APPLE__)
+    // Every Apple Silicon core implements the CRC extension
+    crc32c_impl = crc32c_armv8;
+    crc32c_impl_name = "ARMv8 CRC";
+#endif
+#endif
+}
+
+uint32_t crc32c(uint32_t crc, const void* data, size_t length) {
+    if (!crc32c_impl) {
+        crc32c_select();
+    }
+    return ~crc32c_impl(~crc, (const uint8_t*)data, length);
+}
+
+const char* crc32c_implementation(void) {
+    if (!crc32c_impl) {
+        crc32c_select();
+    }
+    return crc32c_impl_name;
+}
+
+uint32_t fletcher_checksum(const uint32_t* data, int count, uint32_t s1, uint32_t s2) {
+    uint32_t sum1 = s1;
+    uint32_t sum2 = s2;
+
+    for (int i = 0; i < count; i++) {
+        sum1 += data[i] + sum2;
+        sum2 += data[i] + sum1;
+    }
+
+    return sum1 ^ sum2;
+}
@@ -0,0 +1,23 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Frame checksums used by the WAL.
+ *
+ * crc32c() computes CRC32C (Castagnoli). The implementation is picked
+ * once at runtime: the SSE4.2 crc32 instruction on x86-64, the ARMv8
+ * CRC extension on AArch64, or a portable slicing-by-8 table otherwise.
+ * All three produce identical results, so a log written on one machine
+ * recovers on any other.
+ *
+ * fletcher_checksum() is the original scalar checksum used by version 1
+ * WAL files. It is kept only so that old logs can still be recovered.
+ */
+uint32_t crc32c(uint32_t crc, const void* data, size_t length);
+const char* crc32c_implementation(void);
+uint32_t fletcher_checksum(const uint32_t* data, int count, uint32_t s1, uint32_t s2);
+
+#endif // CHECKSUM_H
@@ -3,16 +3,43 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <sys/types.h>
 #include "../storage/pager.h"
 
 #define WAL_HEADER_SIZE 32
 #define WAL_FRAME_HEADER_SIZE 24
+#define WAL_RECORD_HEADER_SIZE 40
+#define WAL_LEGACY_RECORD_HEADER_SIZE 36
+
+// Tables that can share one log, and the size of a table name record
+#define WAL_MAX_TABLES 64
+#define WAL_TABLE_NAME_SIZE 64
+
+// The log file grows in preallocated segments and is reused after checkpoint
+#define WAL_SEGMENT_SIZE (1024 * 1024)
+#define WAL_MAX_RECYCLED_SEGMENTS 4
+
+/*
+ * WALHeader.version selects the log format:
+ *   1 - full-page frames, scalar Fletcher-style sum (legacy, recovery only)
+ *   2 - full-page frames, CRC32C (legacy, recovery only)
+ *   3 - variable-length records: full-page images plus logical
+ *       insert/update/delete redo records, CRC32C (one log per table)
+ *   4 - version 3 records tagged with a table id, one log per database
+ */
+#define WAL_VERSION_FLETCHER 1
+#define WAL_VERSION_CRC32C 2
+#define WAL_VERSION_RECORDS 3
+#define WAL_VERSION_SHARED 4
+#define WAL_VERSION WAL_VERSION_SHARED
 
 typedef enum {
     WAL_OP_INSERT,
     WAL_OP_UPDATE,
     WAL_OP_DELETE,
-    WAL_OP_CHECKPOINT
+    WAL_OP_CHECKPOINT,
+    WAL_OP_PAGE,
+    WAL_OP_TABLE
 } WALOpType;
 
 typedef struct {
@@ -26,6 +53,7 @@ typedef struct {
     uint32_t checksum2;       // Cumulative checksum
 } WALHeader;
 
+// Version 1/2 frame: header followed by a PAGE_SIZE page image
 typedef struct {
     uint32_t page_number;     // Which page this frame modifies
     uint32_t db_size;         // Database size after this frame
@@ -35,26 +63,109 @@ typedef struct {
     uint32_t checksum2;       // Frame checksum
 } WALFrameHeader;
 
+/*
+ * Version 4 record: header followed by payload_size bytes.
+ *   WAL_OP_PAGE   - payload is a full page image
+ *   WAL_OP_INSERT - payload is the serialized row inserted at cell_num
+ *   WAL_OP_UPDATE - payload is the serialized row replacing cell_num
+ *   WAL_OP_DELETE - no payload; cell_num is removed
+ *   WAL_OP_TABLE  - payload is the name of table_id, written before the
+ *                   table's first record after each checkpoint
+ * Logical records are only written for a leaf that already has a full
+ * image in the log since the last checkpoint, so redo always starts
+ * from a known page state.
+ */
+typedef struct {
+    uint32_t op;              // WALOpType
+    uint32_t table_id;        // Table this record applies to
+    uint32_t page_number;     // Page this record applies to
+    uint32_t cell_num;        // Leaf cell (logical records)
+    uint32_t key;             // Primary key (logical records)
+    uint32_t payload_size;    // Bytes following the header
+    uint32_t db_size;         // Database size after this record
+    uint32_t salt1;           // Copy from header
+    uint32_t salt2;           // Copy from header
+    uint32_t checksum;        // CRC32C of the fields above and the payload
+} WALRecordHeader;
+
+// Version 3 record header: as above without table_id
+typedef struct {
+    uint32_t op;
+    uint32_t page_number;
+    uint32_t cell_num;
+    uint32_t key;
+    uint32_t payload_size;
+    uint32_t db_size;
+    uint32_t salt1;
+    uint32_t salt2;
+    uint32_t checksum;
+} WALLegacyRecordHeader;
+
+// A single-cell change described by the executor
+typedef struct {
+    WALOpType op;
+    uint32_t page_number;
+    uint32_t cell_num;
+    uint32_t key;
+    const void* row;          // Serialized row, NULL for deletes
+} WALLogicalRecord;
+
+/*
+ * A relation (table or index file) writing to the log. Its name is the
+ * suffix of its file name: relation "users" lives in "<db>.users".
+ */
 typedef struct {
-    WALFrameHeader header;
-    void* page_data;          // PAGE_SIZE bytes
-} WALFrame;
+    char name[WAL_TABLE_NAME_SIZE];
+    Pager* pager;
+    bool announced;           // Name record written since the last checkpoint
+} WALTable;
 
 typedef struct {
     int fd;                   // File descriptor for WAL file
+    char base_path[256];      // Database path the relation names extend
     WALHeader header;
     uint32_t frame_count;     // Number of frames in WAL
     bool is_open;
+
+    // Preallocated segments; segment_size 0 disables preallocation
+    uint32_t segment_size;
+    off_t file_size;          // Allocated size of the log file
+    off_t write_offset;       // Where the next record is written
+
+    // Records appended by the current statement, written on wal_sync
+    char* buffer;
+    uint32_t buffer_used;
+    uint32_t buffer_capacity;
+    bool in_transaction;      // Defer wal_sync until commit
+
+    // Tables sharing this log, indexed by table id
+    WALTable tables[WAL_MAX_TABLES];
+    uint32_t num_tables;
 } WAL;
 
+// Log activity since startup, summed over every WAL
+typedef struct {
+    uint64_t bytes_written;   // Record bytes appended to the log
+    uint64_t syncs;           // fsync / fdatasync calls on the log
+    uint64_t checkpoints;
+} WALCounters;
+
 // Function declarations
 WAL* wal_open(const char* filename);
+WAL* wal_open_with_segment_size(const char* filename, uint32_t segment_size);
 void wal_close(WAL* wal);
-bool wal_write_frame(WAL* wal, uint32_t page_num, void* page_data, uint32_t db_size);
-bool wal_checkpoint(WAL* wal, Pager* pager);
-bool wal_recover(WAL* wal, Pager* pager);
+uint32_t wal_register_table(WAL* wal, const char* name, Pager* pager);
+void wal_unregister_table(WAL* wal, uint32_t table_id);
+bool wal_write_frame(WAL* wal, uint32_t table_id, uint32_t page_num, void* page_data, uint32_t db_size);
+bool wal_write_logical(WAL* wal, uint32_t table_id, WALLogicalRecord* record, uint32_t db_size);
+bool wal_append_changes(WAL* wal, uint32_t table_id, Pager* pager, WALLogicalRecord* record);
+bool wal_log_changes(WAL* wal, uint32_t table_id, Pager* pager, WALLogicalRecord* record);
+bool wal_sync(WAL* wal);
+bool wal_checkpoint(WAL* wal);
+bool wal_recover(WAL* wal);
 void wal_begin_transaction(WAL* wal);
 void wal_commit_transaction(WAL* wal);
 void wal_rollback_transaction(WAL* wal);
+WALCounters wal_counters(void);
 
 #endif // WAL_H